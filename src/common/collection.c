@@ -66,6 +66,9 @@ const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
     memcpy(&collection->store, &clone->store, sizeof(dt_collection_params_t));
     collection->where_ext = g_strdup(clone->where_ext);
     collection->query = g_strdup(clone->query);
+    collection->where = g_strdup(clone->where);
+    collection->filter_where = g_strdup(clone->filter_where);
+    collection->base_hash = clone->base_hash;
     collection->clone = 1;
     collection->count = clone->count;
   }
@@ -98,6 +101,8 @@ void dt_collection_free(const dt_collection_t *collection)
 
   g_free(collection->query);
   g_free(collection->where_ext);
+  g_free(collection->where);
+  g_free(collection->filter_where);
   g_free((dt_collection_t *)collection);
 }
 
@@ -109,8 +114,8 @@ const dt_collection_params_t *dt_collection_params(const dt_collection_t *collec
 int dt_collection_update(const dt_collection_t *collection)
 {
   uint32_t result;
-  gchar *wq, *sq, *selq, *query;
-  wq = sq = selq = query = NULL;
+  gchar *wq, *fq, *sq, *selq, *query, *where;
+  wq = fq = sq = selq = query = where = NULL;
 
   /* build where part */
   if(!(collection->params.query_flags & COLLECTION_QUERY_USE_ONLY_WHERE_EXT))
@@ -130,27 +135,30 @@ int dt_collection_update(const dt_collection_t *collection)
                          (need_operator) ? "and" : ((need_operator = 1) ? "" : ""), DT_IMAGE_REMOVE,
                          DT_IMAGE_REMOVE);
 
+    /* add where ext if wanted */
+    if((collection->params.query_flags & COLLECTION_QUERY_USE_WHERE_EXT))
+      wq = dt_util_dstrcat(wq, " %s %s", (need_operator) ? "and" : "", collection->where_ext);
+
+    /* the rating and altered filters are kept apart, so that a change of only them can be applied to the
+     * collected images as a delta. see dt_collection_get_filter_where(). */
+    int need_filter_operator = 0;
     if(collection->params.filter_flags & COLLECTION_FILTER_CUSTOM_COMPARE)
-      wq = dt_util_dstrcat(wq, " %s (flags & 7) %s %d and (flags & 7) != 6",
-                           (need_operator) ? "and" : ((need_operator = 1) ? "" : ""),
+      fq = dt_util_dstrcat(fq, " %s (flags & 7) %s %d and (flags & 7) != 6",
+                           (need_filter_operator) ? "and" : ((need_filter_operator = 1) ? "" : ""),
                            comparators[collection->params.comparator], rating - 1);
     else if(collection->params.filter_flags & COLLECTION_FILTER_ATLEAST_RATING)
-      wq = dt_util_dstrcat(wq, " %s (flags & 7) >= %d and (flags & 7) != 6",
-                           (need_operator) ? "and" : ((need_operator = 1) ? "" : ""), rating - 1);
+      fq = dt_util_dstrcat(fq, " %s (flags & 7) >= %d and (flags & 7) != 6",
+                           (need_filter_operator) ? "and" : ((need_filter_operator = 1) ? "" : ""), rating - 1);
     else if(collection->params.filter_flags & COLLECTION_FILTER_EQUAL_RATING)
-      wq = dt_util_dstrcat(wq, " %s (flags & 7) == %d",
-                           (need_operator) ? "and" : ((need_operator = 1) ? "" : ""), rating - 1);
+      fq = dt_util_dstrcat(fq, " %s (flags & 7) == %d",
+                           (need_filter_operator) ? "and" : ((need_filter_operator = 1) ? "" : ""), rating - 1);
 
     if(collection->params.filter_flags & COLLECTION_FILTER_ALTERED)
-      wq = dt_util_dstrcat(wq, " %s id in (select imgid from history where imgid=id)",
-                           (need_operator) ? "and" : ((need_operator = 1) ? "" : ""));
+      fq = dt_util_dstrcat(fq, " %s exists (select 1 from history where history.imgid = images.id)",
+                           (need_filter_operator) ? "and" : ((need_filter_operator = 1) ? "" : ""));
     else if(collection->params.filter_flags & COLLECTION_FILTER_UNALTERED)
-      wq = dt_util_dstrcat(wq, " %s id not in (select imgid from history where imgid=id)",
-                           (need_operator) ? "and" : ((need_operator = 1) ? "" : ""));
-
-    /* add where ext if wanted */
-    if((collection->params.query_flags & COLLECTION_QUERY_USE_WHERE_EXT))
-      wq = dt_util_dstrcat(wq, " %s %s", (need_operator) ? "and" : "", collection->where_ext);
+      fq = dt_util_dstrcat(fq, " %s not exists (select 1 from history where history.imgid = images.id)",
+                           (need_filter_operator) ? "and" : ((need_filter_operator = 1) ? "" : ""));
   }
   else
     wq = dt_util_dstrcat(wq, "%s", collection->where_ext);
@@ -161,16 +169,19 @@ int dt_collection_update(const dt_collection_t *collection)
     wq = dt_util_dstrcat(wq, " and (group_id = id or group_id = %d)", darktable.gui->expanded_group_id);
   }
 
+  /* the filters go last, everything in front of them is what the base hash covers */
+  where = fq ? g_strdup_printf("%s and (%s)", wq, fq) : g_strdup(wq);
+
   /* build select part includes where */
   if(collection->params.sort == DT_COLLECTION_SORT_COLOR
      && (collection->params.query_flags & COLLECTION_QUERY_USE_SORT))
     selq = dt_util_dstrcat(selq, "select distinct id from (select * from images where %s) as a left outer "
                                  "join color_labels as b on a.id = b.imgid",
-                           wq);
+                           where);
   else if(collection->params.query_flags & COLLECTION_QUERY_USE_ONLY_WHERE_EXT)
-    selq = dt_util_dstrcat(selq, "select distinct images.id from images %s", wq);
+    selq = dt_util_dstrcat(selq, "select distinct images.id from images %s", where);
   else
-    selq = dt_util_dstrcat(selq, "select distinct id from images where %s", wq);
+    selq = dt_util_dstrcat(selq, "select distinct id from images where %s", where);
 
 
 
@@ -187,9 +198,25 @@ int dt_collection_update(const dt_collection_t *collection)
                         (collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT) ? " " LIMIT_QUERY : "");
   result = _dt_collection_store(collection, query);
 
+  /* and what it is made of */
+  {
+    dt_collection_t *c = (dt_collection_t *)collection;
+    gchar *base = g_strdup_printf("%s|%s|%u", wq, sq ? sq : "", collection->params.query_flags);
+    uint64_t hash = 5381;
+    for(const char *str = base; *str; str++) hash = ((hash << 5) + hash) ^ *str;
+    c->base_hash = hash;
+    g_free(base);
+    g_free(c->filter_where);
+    c->filter_where = fq ? g_strdup(fq) : NULL;
+    g_free(c->where);
+    c->where = (collection->params.query_flags & COLLECTION_QUERY_USE_ONLY_WHERE_EXT) ? NULL : g_strdup(where);
+  }
+
   /* free memory used */
   g_free(sq);
   g_free(wq);
+  g_free(fq);
+  g_free(where);
   g_free(selq);
   g_free(query);
 
@@ -229,6 +256,55 @@ const gchar *dt_collection_get_query(const dt_collection_t *collection)
   return collection->query;
 }
 
+const gchar *dt_collection_get_where(const dt_collection_t *collection)
+{
+  if(!collection->query) dt_collection_update(collection);
+
+  return collection->where;
+}
+
+const gchar *dt_collection_get_filter_where(const dt_collection_t *collection)
+{
+  if(!collection->query) dt_collection_update(collection);
+
+  return collection->filter_where;
+}
+
+uint64_t dt_collection_get_base_hash(const dt_collection_t *collection)
+{
+  if(!collection->query) dt_collection_update(collection);
+
+  return collection->base_hash;
+}
+
+void dt_collection_prune_selection(const dt_collection_t *collection)
+{
+  sqlite3_stmt *stmt = NULL;
+  const gchar *cquery = dt_collection_get_query(collection);
+  if(!cquery || cquery[0] == '\0') return;
+
+  gchar *complete_query = NULL;
+  if(collection->where)
+    // one primary key lookup per selected image instead of running the whole (sorted) collection
+    complete_query = dt_util_dstrcat(complete_query, "delete from selected_images where not exists (select 1 "
+                                                     "from images where images.id = selected_images.imgid "
+                                                     "and %s)",
+                                     collection->where);
+  else
+    complete_query
+        = dt_util_dstrcat(complete_query, "delete from selected_images where imgid not in (%s)", cquery);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), complete_query, -1, &stmt, NULL);
+  if(!collection->where)
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
+  }
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  g_free(complete_query);
+}
+
 uint32_t dt_collection_get_filter_flags(const dt_collection_t *collection)
 {
   return collection->params.filter_flags;
@@ -628,13 +704,13 @@ static gchar *get_query_string(const dt_collection_properties_t property, const
     break;
 
     case DT_COLLECTION_PROP_HISTORY: // history
-      query = dt_util_dstrcat(query, "(id %s in (select imgid from history where imgid=images.id)) ",
+      query = dt_util_dstrcat(query, "(%s exists (select 1 from history where history.imgid = images.id)) ",
                               (strcmp(escaped_text, _("altered")) == 0) ? "" : "not");
       break;
 
     case DT_COLLECTION_PROP_GEOTAGGING: // geotagging
-      query = dt_util_dstrcat(query, "(id %s in (select id AS imgid from images where (longitude IS NOT NULL AND "
-                                 "latitude IS NOT NULL))) ",
+      // a plain test of the columns, no need to run through all images a second time
+      query = dt_util_dstrcat(query, "(%s (longitude IS NOT NULL AND latitude IS NOT NULL)) ",
                               (strcmp(escaped_text, _("tagged")) == 0) ? "" : "not");
       break;
 
@@ -883,23 +959,7 @@ void dt_collection_update_query(const dt_collection_t *collection)
   g_free(complete_query);
 
   // remove from selected images where not in this query.
-  sqlite3_stmt *stmt = NULL;
-  const gchar *cquery = dt_collection_get_query(collection);
-  complete_query = NULL;
-  if(cquery && cquery[0] != '\0')
-  {
-    complete_query
-        = dt_util_dstrcat(complete_query, "delete from selected_images where imgid not in (%s)", cquery);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), complete_query, -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-
-    /* free allocated strings */
-    g_free(complete_query);
-  }
-
+  dt_collection_prune_selection(collection);
 
   /* raise signal of collection change, only if this is an original */
   if(!collection->clone) dt_control_signal_raise(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED);
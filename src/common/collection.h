@@ -125,6 +125,9 @@ typedef struct dt_collection_t
   int clone;
   gchar *query;
   gchar *where_ext;
+  gchar *where;        // complete where part of query, NULL when only the extended where is used
+  gchar *filter_where; // the rating and altered filters alone, NULL if there are none
+  uint64_t base_hash;  // hash of everything in query but the filters
   unsigned int count;
   dt_collection_params_t params;
   dt_collection_params_t store;
@@ -141,6 +144,15 @@ const dt_collection_params_t *dt_collection_params(const dt_collection_t *collec
 void dt_collection_get_makermodel(const gchar *filter, GList **sanitized, GList **exif);
 /** get the generated query for collection */
 const gchar *dt_collection_get_query(const dt_collection_t *collection);
+/** get the complete where clause of the query including the filters, or NULL if only the extended where is used */
+const gchar *dt_collection_get_where(const dt_collection_t *collection);
+/** get the part of the where clause made by the rating and altered filters, or NULL */
+const gchar *dt_collection_get_filter_where(const dt_collection_t *collection);
+/** get a hash of the query without its filter part. as long as it doesn't change, a new query only differs
+ * from the last one in its filters */
+uint64_t dt_collection_get_base_hash(const dt_collection_t *collection);
+/** remove all images from the selection which are not in the collection anymore */
+void dt_collection_prune_selection(const dt_collection_t *collection);
 /** updates sql query for a collection. @return 1 if query changed. */
 int dt_collection_update(const dt_collection_t *collection);
 /** reset collection to default dummy selection */
@@ -786,15 +786,6 @@ int dt_init(int argc, char *argv[], const int init_gui, lua_State *L)
   // Initialize the signal system
   darktable.signals = dt_control_signal_init();
 
-  // Make sure that the database and xmp files are in sync before starting the fswatch.
-  // We need conf and db to be up and running for that which is the case here.
-  // FIXME: is this also useful in non-gui mode?
-  GList *changed_xmp_files = NULL;
-  if(init_gui && dt_conf_get_bool("run_crawler_on_start"))
-  {
-    changed_xmp_files = dt_control_crawler_run();
-  }
-
   // Initialize the filesystem watcher
   darktable.fswatch = dt_fswatch_new();
 
@@ -956,13 +947,17 @@ int dt_init(int argc, char *argv[], const int init_gui, lua_State *L)
   dt_lua_init(darktable.lua_state.state, lua_command);
 #endif
 
-  // last but not least construct the popup that asks the user about images whose xmp files are newer than the
-  // db entry
-  if(init_gui && changed_xmp_files)
+  // last but not least look for images whose xmp files are newer than the db entry. this runs in the
+  // background and pops up a dialog asking the user what to do about them when done.
+  // FIXME: is this also useful in non-gui mode?
+  if(init_gui && dt_conf_get_bool("run_crawler_on_start"))
   {
-    dt_control_crawler_show_image_list(changed_xmp_files);
+    dt_control_crawler_run_job();
   }
 
+  // from now on pick up changes in the film roll folders as they happen
+  if(init_gui) dt_fswatch_add_filmrolls(darktable.fswatch);
+
   return 0;
 }
 
@@ -980,6 +975,7 @@ void dt_cleanup()
 
     dt_control_write_config(darktable.control);
     dt_control_shutdown(darktable.control);
+    dt_mipmap_cache_prefetch_shutdown(darktable.mipmap_cache);
 
     dt_lib_cleanup(darktable.lib);
     free(darktable.lib);
@@ -996,6 +992,8 @@ void dt_cleanup()
     dt_gui_gtk_cleanup(darktable.gui);
     free(darktable.gui);
   }
+  // write out what the background sidecar writer didn't get to yet
+  dt_image_synch_xmp_flush();
   dt_image_cache_cleanup(darktable.image_cache);
   free(darktable.image_cache);
   dt_mipmap_cache_cleanup(darktable.mipmap_cache);
@@ -36,7 +36,7 @@
 
 // whenever _create_schema() gets changed you HAVE to bump this version and add an update path to
 // _upgrade_schema_step()!
-#define CURRENT_DATABASE_VERSION 10
+#define CURRENT_DATABASE_VERSION 13
 
 typedef struct dt_database_t
 {
@@ -711,6 +711,56 @@ static int _upgrade_schema_step(dt_database_t *db, int version)
     }
     sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
     new_version = 10;
+  }
+  else if(version == 10)
+  {
+    // 10 -> 11 added xmp_hash column to images
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    if(sqlite3_exec(db->handle, "ALTER TABLE images ADD COLUMN xmp_hash CHAR(32)", NULL, NULL, NULL)
+      != SQLITE_OK)
+    {
+      fprintf(stderr, "[init] can't add `xmp_hash' column to database\n");
+      fprintf(stderr, "[init]   %s\n", sqlite3_errmsg(db->handle));
+      sqlite3_exec(db->handle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+      return version;
+    }
+    sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
+    new_version = 11;
+  }
+  else if(version == 11)
+  {
+    // 11 -> 12 added crawler_mtime column to film_rolls
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    if(sqlite3_exec(db->handle, "ALTER TABLE film_rolls ADD COLUMN crawler_mtime INTEGER", NULL, NULL, NULL)
+      != SQLITE_OK)
+    {
+      fprintf(stderr, "[init] can't add `crawler_mtime' column to database\n");
+      fprintf(stderr, "[init]   %s\n", sqlite3_errmsg(db->handle));
+      sqlite3_exec(db->handle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+      return version;
+    }
+    sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
+    new_version = 12;
+  }
+  else if(version == 12)
+  {
+    // 12 -> 13 added indexes for the columns collections filter and sort on
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    if(sqlite3_exec(db->handle, "CREATE INDEX IF NOT EXISTS color_labels_color_index ON color_labels (color, imgid)",
+                    NULL, NULL, NULL) != SQLITE_OK
+       || sqlite3_exec(db->handle,
+                       "CREATE INDEX IF NOT EXISTS images_datetime_taken_index ON images (datetime_taken)", NULL,
+                       NULL, NULL) != SQLITE_OK
+       || sqlite3_exec(db->handle, "CREATE INDEX IF NOT EXISTS images_maker_model_index ON images (maker, model, lens)",
+                       NULL, NULL, NULL) != SQLITE_OK)
+    {
+      fprintf(stderr, "[init] can't create collection indexes\n");
+      fprintf(stderr, "[init]   %s\n", sqlite3_errmsg(db->handle));
+      sqlite3_exec(db->handle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+      return version;
+    }
+    sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
+    new_version = 13;
   } // maybe in the future, see commented out code elsewhere
     //   else if(version == XXX)
     //   {
@@ -764,7 +814,7 @@ static void _create_schema(dt_database_t *db)
                         //                        "folder VARCHAR(1024), external_drive VARCHAR(1024))", //
                         //                        FIXME: make sure to bump CURRENT_DATABASE_VERSION and add a
                         //                        case to _upgrade_schema_step when adding this!
-                        "folder VARCHAR(1024) NOT NULL)",
+                        "folder VARCHAR(1024) NOT NULL, crawler_mtime INTEGER)",
                         NULL, NULL, NULL);
   DT_DEBUG_SQLITE3_EXEC(db->handle, "CREATE INDEX film_rolls_folder_index ON film_rolls (folder)", NULL, NULL,
                         NULL);
@@ -781,13 +831,17 @@ static void _create_schema(dt_database_t *db)
       "caption VARCHAR, description VARCHAR, license VARCHAR, sha1sum CHAR(40), "
       "orientation INTEGER, histogram BLOB, lightmap BLOB, longitude REAL, "
       "latitude REAL, color_matrix BLOB, colorspace INTEGER, version INTEGER, max_version INTEGER, "
-      "write_timestamp INTEGER, history_end INTEGER)",
+      "write_timestamp INTEGER, history_end INTEGER, xmp_hash CHAR(32))",
       NULL, NULL, NULL);
   DT_DEBUG_SQLITE3_EXEC(db->handle, "CREATE INDEX images_group_id_index ON images (group_id)", NULL, NULL,
                         NULL);
   DT_DEBUG_SQLITE3_EXEC(db->handle, "CREATE INDEX images_film_id_index ON images (film_id)", NULL, NULL, NULL);
   DT_DEBUG_SQLITE3_EXEC(db->handle, "CREATE INDEX images_filename_index ON images (filename)", NULL, NULL,
                         NULL);
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "CREATE INDEX images_datetime_taken_index ON images (datetime_taken)", NULL,
+                        NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "CREATE INDEX images_maker_model_index ON images (maker, model, lens)", NULL,
+                        NULL, NULL);
   ////////////////////////////// selected_images
   DT_DEBUG_SQLITE3_EXEC(db->handle, "CREATE TABLE selected_images (imgid INTEGER PRIMARY KEY)", NULL, NULL,
                         NULL);
@@ -865,6 +919,8 @@ static void _create_schema(dt_database_t *db)
                         NULL);
   DT_DEBUG_SQLITE3_EXEC(db->handle, "CREATE UNIQUE INDEX color_labels_idx ON color_labels (imgid, color)",
                         NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "CREATE INDEX color_labels_color_index ON color_labels (color, imgid)",
+                        NULL, NULL, NULL);
   ////////////////////////////// meta_data
   DT_DEBUG_SQLITE3_EXEC(db->handle, "CREATE TABLE meta_data (id INTEGER, key INTEGER, value VARCHAR)", NULL,
                         NULL, NULL);
@@ -2136,12 +2136,14 @@ int dt_exif_xmp_attach(const int imgid, const char *filename)
 }
 
 // write xmp sidecar file:
-int dt_exif_xmp_write(const int imgid, const char *filename)
+int dt_exif_xmp_write(const int imgid, const char *filename, const char *old_hash, char **new_hash)
 {
   // refuse to write sidecar for non-existent image:
   char imgfname[PATH_MAX] = { 0 };
   gboolean from_cache = TRUE;
 
+  if(new_hash) *new_hash = NULL;
+
   dt_image_full_path(imgid, imgfname, sizeof(imgfname), &from_cache);
   if(!g_file_test(imgfname, G_FILE_TEST_IS_REGULAR)) return 1;
 
@@ -2149,6 +2151,28 @@ int dt_exif_xmp_write(const int imgid, const char *filename)
   {
     Exiv2::XmpData xmpData;
     std::string xmpPacket;
+
+    // hash the part of the sidecar that is owned by us. if it didn't change since the last
+    // write there is no need to read, parse and rewrite the whole file.
+    Exiv2::XmpData dtData;
+    dt_exif_xmp_read_data(dtData, imgid);
+    if(Exiv2::XmpParser::encode(xmpPacket, dtData,
+       Exiv2::XmpParser::useCompactFormat | Exiv2::XmpParser::omitPacketWrapper) != 0)
+    {
+      throw Exiv2::Error(1, "[xmp_write] failed to serialize xmp data");
+    }
+    char *hash = g_compute_checksum_for_string(G_CHECKSUM_MD5, xmpPacket.c_str(), xmpPacket.size());
+    if(old_hash && !strcmp(old_hash, hash))
+    {
+      g_free(hash);
+      return 2;
+    }
+    if(new_hash)
+      *new_hash = hash;
+    else
+      g_free(hash);
+
+    xmpPacket.clear();
     if(g_file_test(filename, G_FILE_TEST_EXISTS))
     {
       Exiv2::DataBuf buf = Exiv2::readFile(filename);
@@ -2180,6 +2204,11 @@ int dt_exif_xmp_write(const int imgid, const char *filename)
   catch(Exiv2::AnyError &e)
   {
     std::cerr << "[xmp_write] caught exiv2 exception '" << e << "'\n";
+    if(new_hash)
+    {
+      g_free(*new_hash);
+      *new_hash = NULL;
+    }
     return -1;
   }
 }
@@ -41,8 +41,9 @@ int dt_exif_read_blob(uint8_t *blob, const char *path, const int imgid, const in
 /** write blob to file exif. merges with existing exif information.*/
 int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path);
 
-/** write xmp sidecar file. */
-int dt_exif_xmp_write(const int imgid, const char *filename);
+/** write xmp sidecar file. if the darktable part of the data still hashes to old_hash nothing is written and 2
+ * is returned. on success the new hash is passed back in new_hash (if given), to be freed with g_free(). */
+int dt_exif_xmp_write(const int imgid, const char *filename, const char *old_hash, char **new_hash);
 
 /** write xmp packet inside an image. */
 int dt_exif_xmp_attach(const int imgid, const char *filename);
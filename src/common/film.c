@@ -22,6 +22,7 @@
 #include "control/jobs.h"
 #include "control/progress.h"
 #include "common/film.h"
+#include "common/fswatch.h"
 #include "common/dtpthread.h"
 #include "common/collection.h"
 #include "common/image_cache.h"
@@ -210,6 +211,8 @@ int dt_film_new(dt_film_t *film, const char *directory)
     if(sqlite3_step(stmt) == SQLITE_ROW) film->id = sqlite3_column_int(stmt, 0);
     sqlite3_finalize(stmt);
     dt_pthread_mutex_unlock(&darktable.db_insert);
+
+    if(film->id > 0) dt_fswatch_add(darktable.fswatch, DT_FSWATCH_FILMROLL, GINT_TO_POINTER(film->id));
   }
 
   if(film->id <= 0) return 0;
@@ -618,6 +621,8 @@ void dt_film_remove(const int id)
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 
+  dt_fswatch_remove(darktable.fswatch, DT_FSWATCH_FILMROLL, GINT_TO_POINTER(id));
+
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "delete from film_rolls where id = ?1", -1,
                               &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
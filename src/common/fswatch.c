@@ -20,18 +20,29 @@
 #endif
 
 #include "common/darktable.h"
+#include "common/collection.h"
+#include "common/debug.h"
 #include "common/dtpthread.h"
+#include "common/history.h"
 #include "common/image.h"
+#include "common/image_cache.h"
+#include "common/mipmap_cache.h"
 #include "common/fswatch.h"
+#include "control/conf.h"
+#include "control/control.h"
+#include "control/jobs.h"
 #include "develop/develop.h"
+#include "views/view.h"
 
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
 #include <glib.h>
 #include <strings.h>
-#if 0 // def  HAVE_INOTIFY
+#ifdef HAVE_INOTIFY
+#include <poll.h>
 #include <sys/inotify.h>
+#include <sys/stat.h>
 #endif
 
 
@@ -41,198 +52,456 @@ typedef struct _watch_t
   dt_fswatch_type_t type; // DT_FSWATCH_* type
   void *data;             // Assigned data
   int events;             // events occurred..
+  int film_id;            // film roll the watched file(s) belong to
+  char *path;             // watched file or folder
 } _watch_t;
 
+// a file that changed, waiting to be looked at
+typedef struct _pending_t
+{
+  int film_id;
+  uint32_t mask;
+} _pending_t;
 
-#if 0 // def  HAVE_INOTIFY
 
-typedef struct inotify_event_t
-{
-  uint32_t wd;       /* Watch descriptor */
-  uint32_t mask;     /* Mask of events */
-  uint32_t cookie;   /* Unique cookie associating related events (for rename(2)) */
-  uint32_t len;      /* Size of 'name' field */
-  char     name[];   /* Optional null-terminated name */
-} inotify_event_t;
+#ifdef HAVE_INOTIFY
+
+// changes are collected for this long (in ms) before being handled, so that a burst of them (copying a
+// card into a watched folder, some other tool rewriting all xmp files, ...) ends up in one pass
+#define DT_FSWATCH_DELAY 2000
 
 // Compare func for GList
-static gint _fswatch_items_by_data(const void* a,const void *b)
+static gint _fswatch_items_by_data(const void *a, const void *b)
 {
-  return (((_watch_t*)a)->data<b)?-1:((((_watch_t*)a)->data==b)?0:1);
+  return (((_watch_t *)a)->data < b) ? -1 : ((((_watch_t *)a)->data == b) ? 0 : 1);
 }
 
 // Compare func for GList
-static gint _fswatch_items_by_descriptor(const void *a,const void *b)
+static gint _fswatch_items_by_descriptor(const void *a, const void *b)
 {
-  gint result=(((_watch_t*)a)->descriptor < *(const int *)b)?-1:((((_watch_t*)a)->descriptor==*(const int *)b)?0:1);
+  gint result = (((_watch_t *)a)->descriptor < *(const int *)b)
+                    ? -1
+                    : ((((_watch_t *)a)->descriptor == *(const int *)b) ? 0 : 1);
   return result;
 }
 
+static void _fswatch_item_free(gpointer data)
+{
+  _watch_t *item = (_watch_t *)data;
+  g_free(item->path);
+  g_free(item);
+}
 
-static void *_fswatch_thread(void *data)
+// an image open in darkroom that changed on disk, to be reloaded from the gui thread
+typedef struct _reload_t
+{
+  int imgid;
+  gchar *xmp; // the changed sidecar, NULL when the image itself changed
+} _reload_t;
+
+static gboolean _fswatch_in_darkroom(const int imgid)
+{
+  dt_view_manager_t *vm = darktable.view_manager;
+  if(!darktable.develop || !vm || vm->current_view < 0) return FALSE;
+  const dt_view_t *cv = dt_view_manager_get_current_view(vm);
+  return cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM && dt_dev_is_current_image(darktable.develop, imgid);
+}
+
+// the develop module is owned by the gui thread, so its image and history can't be swapped from the job
+static gboolean _fswatch_reload_idle(gpointer user_data)
 {
-  dt_fswatch_t *fswatch=(dt_fswatch_t *)data;
-  uint32_t res=0;
-  uint32_t event_hdr_size=sizeof(inotify_event_t);
-  inotify_event_t *event_hdr = g_malloc0(sizeof(inotify_event_t));
-  char *name = g_malloc0(2048);
-  dt_print(DT_DEBUG_FSWATCH,"[fswatch_thread] Starting thread of context %p\n", data);
-  while(1)
+  _reload_t *reload = (_reload_t *)user_data;
+  if(reload->xmp) dt_history_load_and_apply(reload->imgid, reload->xmp, 0);
+  if(_fswatch_in_darkroom(reload->imgid))
   {
-    // Blocking read loop of event fd into event
-    if(read(fswatch->inotify_fd,event_hdr,event_hdr_size) != event_hdr_size)
+    if(reload->xmp)
+      dt_dev_reload_history_items(darktable.develop);
+    else
+      dt_dev_reload_image(darktable.develop, reload->imgid);
+  }
+  g_free(reload->xmp);
+  g_free(reload);
+  return FALSE;
+}
+
+static void _fswatch_reload(const int imgid, const char *xmp)
+{
+  _reload_t *reload = (_reload_t *)g_malloc(sizeof(_reload_t));
+  reload->imgid = imgid;
+  reload->xmp = g_strdup(xmp);
+  g_idle_add(_fswatch_reload_idle, reload);
+}
+
+// look at the file as it is now, the events only tell us that we should. returns TRUE when images got added
+// to or removed from the library.
+static gboolean _fswatch_handle_file(const char *path, const int film_id)
+{
+  gboolean collection_changed = FALSE;
+  sqlite3_stmt *stmt;
+  gchar *name = g_path_get_basename(path);
+  const char *ext = strrchr(name, '.');
+  struct stat statbuf;
+  const gboolean exists = (stat(path, &statbuf) == 0 && S_ISREG(statbuf.st_mode));
+
+  if(ext && !strcasecmp(ext, ".xmp"))
+  {
+    // a deleted xmp will be written again with the next change, nothing to do about that
+    if(!exists) goto end;
+
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT id, version, filename, write_timestamp FROM images WHERE film_id = ?1",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
     {
-      if(errno == EINTR) continue;
-      perror("[fswatch_thread] read inotify fd");
-      break;
+      const char *filename = (const char *)sqlite3_column_text(stmt, 2);
+      if(!filename) continue;
+      gchar xmp_name[PATH_MAX] = { 0 };
+      g_strlcpy(xmp_name, filename, sizeof(xmp_name));
+      dt_image_path_append_version_no_db(sqlite3_column_int(stmt, 1), xmp_name, sizeof(xmp_name));
+      g_strlcat(xmp_name, ".xmp", sizeof(xmp_name));
+      if(strcmp(xmp_name, name)) continue;
+
+      // we get to see our own writes, too. those don't need to be read back.
+      if(sqlite3_column_int64(stmt, 3) >= statbuf.st_mtime) continue;
+
+      const int imgid = sqlite3_column_int(stmt, 0);
+      dt_print(DT_DEBUG_FSWATCH, "[fswatch] reloading `%s' (id: %d)\n", path, imgid);
+      // the history of the image being edited has to be replaced together with the one in darkroom
+      if(darktable.develop && dt_dev_is_current_image(darktable.develop, imgid))
+        _fswatch_reload(imgid, path);
+      else
+        dt_history_load_and_apply(imgid, (gchar *)path, 0);
+    }
+    sqlite3_finalize(stmt);
+  }
+  else if(dt_supported_image(name))
+  {
+    GList *imgs = NULL;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT id FROM images WHERE film_id = ?1 AND filename = ?2", -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, name, -1, SQLITE_STATIC);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+      imgs = g_list_prepend(imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+    sqlite3_finalize(stmt);
+
+    if(exists && !imgs)
+    {
+      dt_print(DT_DEBUG_FSWATCH, "[fswatch] importing new image `%s'\n", path);
+      if(dt_image_import(film_id, path, FALSE)) collection_changed = TRUE;
     }
 
-    // Read name into buffer if any...
-    if( event_hdr->len > 0 )
+    for(GList *iter = imgs; iter; iter = g_list_next(iter))
     {
-      res=read(fswatch->inotify_fd,name,event_hdr_size);
-      name[res]='\0';
+      const int imgid = GPOINTER_TO_INT(iter->data);
+      if(exists)
+      {
+        // the file got replaced, everything we derived from it is stale now
+        dt_print(DT_DEBUG_FSWATCH, "[fswatch] `%s' (id: %d) changed on disk\n", path, imgid);
+        dt_mipmap_cache_remove_all(darktable.mipmap_cache, imgid);
+        if(darktable.develop && dt_dev_is_current_image(darktable.develop, imgid)) _fswatch_reload(imgid, NULL);
+      }
+      else
+      {
+        dt_print(DT_DEBUG_FSWATCH, "[fswatch] `%s' (id: %d) is gone, removing it\n", path, imgid);
+        dt_image_remove(imgid);
+        collection_changed = TRUE;
+      }
     }
+    g_list_free(imgs);
+  }
 
-    dt_pthread_mutex_lock(&fswatch->mutex);
-    GList *gitem=g_list_find_custom(fswatch->items,&event_hdr->wd,&_fswatch_items_by_descriptor);
-    if( gitem )
+end:
+  g_free(name);
+  return collection_changed;
+}
+
+static int32_t _fswatch_job_run(dt_job_t *job)
+{
+  dt_fswatch_t *fswatch = (dt_fswatch_t *)darktable.fswatch;
+
+  dt_pthread_mutex_lock(&fswatch->mutex);
+  GHashTable *pending = fswatch->pending;
+  fswatch->pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  dt_pthread_mutex_unlock(&fswatch->mutex);
+
+  gboolean collection_changed = FALSE;
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, pending);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+    collection_changed |= _fswatch_handle_file((const char *)key, ((_pending_t *)value)->film_id);
+  g_hash_table_destroy(pending);
+
+  if(collection_changed)
+  {
+    dt_collection_update_query(darktable.collection);
+    dt_control_signal_raise(darktable.signals, DT_SIGNAL_FILMROLLS_CHANGED);
+  }
+  dt_control_queue_redraw_center();
+  return 0;
+}
+
+static gboolean _fswatch_timeout(gpointer user_data)
+{
+  dt_fswatch_t *fswatch = (dt_fswatch_t *)user_data;
+  dt_pthread_mutex_lock(&fswatch->mutex);
+  fswatch->pending_timeout = 0;
+  dt_pthread_mutex_unlock(&fswatch->mutex);
+
+  dt_job_t *job = dt_control_job_create(&_fswatch_job_run, "handle changed files");
+  if(job) dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+  return FALSE;
+}
+
+// remember that path changed. has to be called with the mutex held.
+static void _fswatch_queue(dt_fswatch_t *fswatch, const int film_id, const char *path, const uint32_t mask)
+{
+  _pending_t *pending = (_pending_t *)g_hash_table_lookup(fswatch->pending, path);
+  if(!pending)
+  {
+    pending = (_pending_t *)g_malloc0(sizeof(_pending_t));
+    pending->film_id = film_id;
+    g_hash_table_insert(fswatch->pending, g_strdup(path), pending);
+  }
+  pending->mask |= mask;
+
+  // don't restart the countdown for each event, a steady stream of them would never get handled otherwise
+  if(!fswatch->pending_timeout)
+    fswatch->pending_timeout = g_timeout_add(DT_FSWATCH_DELAY, _fswatch_timeout, fswatch);
+}
+
+static void _fswatch_handle_event(dt_fswatch_t *fswatch, const struct inotify_event *event)
+{
+  GList *gitem = g_list_find_custom(fswatch->items, &event->wd, &_fswatch_items_by_descriptor);
+  if(!gitem)
+  {
+    dt_print(DT_DEBUG_FSWATCH, "[fswatch_thread] Failed to found watch item for descriptor %d\n", event->wd);
+    return;
+  }
+
+  _watch_t *item = gitem->data;
+  item->events = item->events | event->mask;
+
+  switch(item->type)
+  {
+    case DT_FSWATCH_IMAGE:
     {
-      _watch_t *item = gitem->data;
-      item->events=item->events|event_hdr->mask;
+      if((event->mask & IN_CLOSE) && (item->events & IN_MODIFY)) // Check if file modified and closed...
+      {
+        //  Something wrote on image externally and closed it
+        _fswatch_queue(fswatch, item->film_id, item->path, item->events);
+        item->events = 0;
+      }
+      else if((event->mask & IN_ATTRIB) && (item->events & IN_DELETE_SELF) && (item->events & IN_IGNORED))
+      {
+        // This pattern showed up when another file is replacing the original...
+        _fswatch_queue(fswatch, item->film_id, item->path, item->events);
+        item->events = 0;
+      }
+    }
+    break;
 
-      switch( item->type )
+    case DT_FSWATCH_FILMROLL:
+    {
+      // we only care about files in the folder, and not about hidden ones (temporary files and such)
+      if(event->len == 0 || (event->mask & IN_ISDIR) || event->name[0] == '.') break;
+      if(event->mask & (IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
       {
-        case DT_FSWATCH_IMAGE:
-        {
-          if( (event_hdr->mask&IN_CLOSE) && (item->events&IN_MODIFY) ) // Check if file modified and closed...
-          {
-            //  Something wrote on image externally and closed it, lets tag item as dirty...
-            dt_image_t *img=(dt_image_t *)item->data;
-            img->force_reimport = 1;
-            if(darktable.develop->image==img)
-              dt_dev_raw_reload(darktable.develop);
-            item->events=0;
-          }
-          else if( (event_hdr->mask&IN_ATTRIB) && (item->events&IN_DELETE_SELF) && (item->events&IN_IGNORED))
-          {
-            // This pattern showed up when another file is replacing the original...
-            dt_image_t *img=(dt_image_t *)item->data;
-            img->force_reimport = 1;
-            if(darktable.develop->image==img)
-              dt_dev_raw_reload(darktable.develop);
-            item->events=0;
-          }
-        }
-        break;
-
-        default:
-          dt_print(DT_DEBUG_FSWATCH,"[fswatch_thread] Unhandled object type %d for event descriptor %ld\n", item->type, event_hdr->wd );
-          break;
+        gchar *path = g_build_filename(item->path, event->name, NULL);
+        _fswatch_queue(fswatch, item->film_id, path, event->mask);
+        g_free(path);
       }
+      item->events = 0;
     }
-    else
-      dt_print(DT_DEBUG_FSWATCH,"[fswatch_thread] Failed to found watch item for descriptor %ld\n", event_hdr->wd );
+    break;
 
-    dt_pthread_mutex_unlock(&fswatch->mutex);
+    default:
+      dt_print(DT_DEBUG_FSWATCH, "[fswatch_thread] Unhandled object type %d for event descriptor %d\n",
+               item->type, event->wd);
+      break;
   }
-  dt_print(DT_DEBUG_FSWATCH,"[fswatch_thread] terminating.\n");
-  g_free(event_hdr);
-  g_free(name);
-  return NULL;
 }
 
+static void *_fswatch_thread(void *data)
+{
+  dt_fswatch_t *fswatch = (dt_fswatch_t *)data;
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct pollfd pfd = { .fd = fswatch->inotify_fd, .events = POLLIN };
+  dt_print(DT_DEBUG_FSWATCH, "[fswatch_thread] Starting thread of context %p\n", data);
+  while(fswatch->running)
+  {
+    // wake up every now and then to see if we are supposed to quit
+    const int ret = poll(&pfd, 1, 500);
+    if(ret == 0) continue;
+    if(ret < 0)
+    {
+      if(errno == EINTR) continue;
+      perror("[fswatch_thread] poll inotify fd");
+      break;
+    }
 
+    // one read gets us as many complete events as fit into the buffer
+    const ssize_t len = read(fswatch->inotify_fd, buf, sizeof(buf));
+    if(len <= 0)
+    {
+      if(len < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+      perror("[fswatch_thread] read inotify fd");
+      break;
+    }
 
+    dt_pthread_mutex_lock(&fswatch->mutex);
+    const struct inotify_event *event;
+    for(char *ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + event->len)
+    {
+      event = (const struct inotify_event *)ptr;
+      _fswatch_handle_event(fswatch, event);
+    }
+    dt_pthread_mutex_unlock(&fswatch->mutex);
+  }
+  dt_print(DT_DEBUG_FSWATCH, "[fswatch_thread] terminating.\n");
+  return NULL;
+}
 
 
-const dt_fswatch_t* dt_fswatch_new()
+const dt_fswatch_t *dt_fswatch_new()
 {
   dt_fswatch_t *fswatch = g_malloc0(sizeof(dt_fswatch_t));
-  if((fswatch->inotify_fd=inotify_init())==-1)
+  const int fd = inotify_init();
+  if(fd == -1)
   {
     g_free(fswatch);
     return NULL;
   }
-  fswatch->items=NULL;
+  fswatch->inotify_fd = fd;
+  fswatch->items = NULL;
+  fswatch->pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  fswatch->pending_timeout = 0;
+  fswatch->running = 1;
   dt_pthread_mutex_init(&fswatch->mutex, NULL);
   pthread_create(&fswatch->thread, NULL, &_fswatch_thread, fswatch);
-  dt_print(DT_DEBUG_FSWATCH,"[fswatch_new] Creating new context %p\n", fswatch);
+  dt_print(DT_DEBUG_FSWATCH, "[fswatch_new] Creating new context %p\n", fswatch);
 
   return fswatch;
 }
 
 void dt_fswatch_destroy(const dt_fswatch_t *fswatch)
 {
-  dt_print(DT_DEBUG_FSWATCH,"[fswatch_destroy] Destroying context %p\n", fswatch);
-  dt_fswatch_t *ctx=(dt_fswatch_t *)fswatch;
+  if(!fswatch) return;
+  dt_print(DT_DEBUG_FSWATCH, "[fswatch_destroy] Destroying context %p\n", fswatch);
+  dt_fswatch_t *ctx = (dt_fswatch_t *)fswatch;
+  ctx->running = 0;
+  pthread_join(ctx->thread, NULL);
+  close(ctx->inotify_fd);
+  if(ctx->pending_timeout) g_source_remove(ctx->pending_timeout);
+  g_hash_table_destroy(ctx->pending);
+  g_list_free_full(ctx->items, _fswatch_item_free);
   dt_pthread_mutex_destroy(&ctx->mutex);
-//FIXME: g_list_free_full maybe?
-  GList *item=g_list_first(fswatch->items);
-  while(item)
-  {
-    g_free( item->data );
-    item=g_list_next(item);
-  }
-  g_list_free(fswatch->items);
   g_free(ctx);
 }
 
-void dt_fswatch_add(const dt_fswatch_t * fswatch,dt_fswatch_type_t type, void *data)
+void dt_fswatch_add(const dt_fswatch_t *fswatch, dt_fswatch_type_t type, void *data)
 {
   char filename[PATH_MAX] = { 0 };
-  uint32_t mask=0;
-  dt_fswatch_t *ctx=(dt_fswatch_t *)fswatch;
+  uint32_t mask = 0;
+  int film_id = -1;
+  dt_fswatch_t *ctx = (dt_fswatch_t *)fswatch;
   filename[0] = '\0';
 
+  if(!fswatch) return;
+
   switch(type)
   {
     case DT_FSWATCH_IMAGE:
-      mask=IN_ALL_EVENTS;
-      dt_image_full_path(((dt_image_t *)data)->id, filename, sizeof(filename));
-      break;
+    {
+      gboolean from_cache = FALSE;
+      mask = IN_ALL_EVENTS;
+      film_id = ((dt_image_t *)data)->film_id;
+      dt_image_full_path(((dt_image_t *)data)->id, filename, sizeof(filename), &from_cache);
+    }
+    break;
     case DT_FSWATCH_CURVE_DIRECTORY:
       break;
+    case DT_FSWATCH_FILMROLL:
+    {
+      // nobody would be there to see the changes without gui
+      if(!darktable.gui || !dt_conf_get_bool("watch_filmroll_folders")) return;
+      mask = IN_ONLYDIR | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+      film_id = GPOINTER_TO_INT(data);
+      sqlite3_stmt *stmt;
+      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT folder FROM film_rolls WHERE id = ?1",
+                                  -1, &stmt, NULL);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
+      if(sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0))
+        g_strlcpy(filename, (const char *)sqlite3_column_text(stmt, 0), sizeof(filename));
+      sqlite3_finalize(stmt);
+    }
+    break;
     default:
-      dt_print(DT_DEBUG_FSWATCH,"[fswatch_add] Unhandled object type %d\n",type);
+      dt_print(DT_DEBUG_FSWATCH, "[fswatch_add] Unhandled object type %d\n", type);
       break;
   }
 
   if(filename[0] != '\0')
   {
     dt_pthread_mutex_lock(&ctx->mutex);
-    _watch_t *item = g_malloc(sizeof(_watch_t));
-    item->type=type;
-    item->data=data;
-    ctx->items=g_list_append(fswatch->items, item);
-    item->descriptor=inotify_add_watch(fswatch->inotify_fd,filename,mask);
+    const int descriptor = inotify_add_watch(fswatch->inotify_fd, filename, mask);
+    if(descriptor == -1)
+    {
+      // most likely /proc/sys/fs/inotify/max_user_watches is exhausted or the folder is gone
+      dt_pthread_mutex_unlock(&ctx->mutex);
+      dt_print(DT_DEBUG_FSWATCH, "[fswatch_add] Failed to watch %s: %s\n", filename, g_strerror(errno));
+      return;
+    }
+    _watch_t *item = g_malloc0(sizeof(_watch_t));
+    item->type = type;
+    item->data = data;
+    item->film_id = film_id;
+    item->path = g_strdup(filename);
+    item->descriptor = descriptor;
+    ctx->items = g_list_append(fswatch->items, item);
     dt_pthread_mutex_unlock(&ctx->mutex);
-    dt_print(DT_DEBUG_FSWATCH,"[fswatch_add] Watch on object %p added on file %s\n", data,filename);
+    dt_print(DT_DEBUG_FSWATCH, "[fswatch_add] Watch on object %p added on file %s\n", data, filename);
   }
   else
-    dt_print(DT_DEBUG_FSWATCH,"[fswatch_add] No watch added, failed to get related filename of object type %d\n",type);
-
+    dt_print(DT_DEBUG_FSWATCH,
+             "[fswatch_add] No watch added, failed to get related filename of object type %d\n", type);
 }
 
-void dt_fswatch_remove(const dt_fswatch_t * fswatch,dt_fswatch_type_t type, void *data)
+void dt_fswatch_remove(const dt_fswatch_t *fswatch, dt_fswatch_type_t type, void *data)
 {
-  dt_fswatch_t *ctx=(dt_fswatch_t *)fswatch;
+  dt_fswatch_t *ctx = (dt_fswatch_t *)fswatch;
+  if(!fswatch) return;
   dt_pthread_mutex_lock(&ctx->mutex);
-  dt_print(DT_DEBUG_FSWATCH,"[fswatch_remove] removing watch on object %p\n", data);
-  GList *gitem=g_list_find_custom(fswatch->items,data,&_fswatch_items_by_data);
-  if( gitem )
+  dt_print(DT_DEBUG_FSWATCH, "[fswatch_remove] removing watch on object %p\n", data);
+  GList *gitem = g_list_find_custom(fswatch->items, data, &_fswatch_items_by_data);
+  while(gitem && ((_watch_t *)gitem->data)->type != type)
+    gitem = g_list_find_custom(g_list_next(gitem), data, &_fswatch_items_by_data);
+  if(gitem)
   {
-    _watch_t *item=gitem->data;
-    ctx->items=g_list_remove(ctx->items,item);
-    inotify_rm_watch(fswatch->inotify_fd,item->descriptor);
-    g_free(item);
+    _watch_t *item = gitem->data;
+    ctx->items = g_list_remove(ctx->items, item);
+    inotify_rm_watch(fswatch->inotify_fd, item->descriptor);
+    _fswatch_item_free(item);
   }
   else
-    dt_print(DT_DEBUG_FSWATCH,"[fswatch_remove] Didn't find watch on object %p type %d\n", data,type);
+    dt_print(DT_DEBUG_FSWATCH, "[fswatch_remove] Didn't find watch on object %p type %d\n", data, type);
 
   dt_pthread_mutex_unlock(&ctx->mutex);
 }
 
+void dt_fswatch_add_filmrolls(const dt_fswatch_t *fswatch)
+{
+  if(!fswatch || !dt_conf_get_bool("watch_filmroll_folders")) return;
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT id FROM film_rolls", -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    dt_fswatch_add(fswatch, DT_FSWATCH_FILMROLL, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+}
+
 #else // HAVE_INOTIFY
 const dt_fswatch_t *dt_fswatch_new()
 {
@@ -248,6 +517,9 @@ void dt_fswatch_add(const dt_fswatch_t *fswatch, dt_fswatch_type_t type, void *d
 void dt_fswatch_remove(const dt_fswatch_t *fswatch, dt_fswatch_type_t type, void *data)
 {
 }
+void dt_fswatch_add_filmrolls(const dt_fswatch_t *fswatch)
+{
+}
 #endif
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
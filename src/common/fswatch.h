@@ -28,7 +28,11 @@ typedef struct dt_fswatch_t
   uint32_t inotify_fd;
   dt_pthread_mutex_t mutex;
   pthread_t thread;
+  int running;
   GList *items;
+  /** changed files waiting to be handled, keyed by their full path. guarded by mutex. */
+  GHashTable *pending;
+  guint pending_timeout;
 } dt_fswatch_t;
 
 /** Types of filesystem watches. */
@@ -38,6 +42,8 @@ typedef enum dt_fswatch_type_t
   DT_FSWATCH_IMAGE = 0,
   /** watch is on directory for curves files << Just an test  */
   DT_FSWATCH_CURVE_DIRECTORY,
+  /** watch is on the folder of a film roll, data is the film id (GINT_TO_POINTER) */
+  DT_FSWATCH_FILMROLL,
 } dt_fswatch_type_t;
 
 /** initializes a new fswatch context. */
@@ -48,6 +54,9 @@ void dt_fswatch_destroy(const dt_fswatch_t *fswatch);
 void dt_fswatch_add(const dt_fswatch_t *fswatch, dt_fswatch_type_t type, void *data);
 /** removes an watch of type and assigned data. */
 void dt_fswatch_remove(const dt_fswatch_t *fswatch, dt_fswatch_type_t type, void *data);
+/** watch the folders of all film rolls in the library, if enabled by the user. changed, new and deleted
+ * images and xmp files are then picked up in the background. */
+void dt_fswatch_add_filmrolls(const dt_fswatch_t *fswatch);
 
 #endif
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
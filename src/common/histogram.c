@@ -42,7 +42,31 @@ static void inline histogram_helper_cs_RAW(const dt_dev_histogram_collection_par
 {
   const dt_histogram_roi_t *roi = histogram_params->roi;
   const float *input = (float *)pixel + roi->width * j + roi->crop_x;
-  for(int i = 0; i < roi->width - roi->crop_width - roi->crop_x; i++, input++)
+  const int width = roi->width - roi->crop_width - roi->crop_x;
+  int i = 0;
+
+  // four samples at a time, raw buffers are single channel so there's no alignment to rely on
+  const __m128 scale = _mm_set1_ps((float)(histogram_params->bins_count));
+  const __m128 val_min = _mm_setzero_ps();
+  const __m128 val_max = _mm_set1_ps(histogram_params->bins_count - 1);
+  for(; i + 4 <= width; i += 4, input += 4)
+  {
+    const __m128 scaled = _mm_mul_ps(_mm_loadu_ps(input), scale);
+    // max first: it returns its second operand for NaN, which sends NaN to bin 0 like the scalar path
+    const __m128 clamped = _mm_min_ps(_mm_max_ps(scaled, val_min), val_max);
+
+    // truncate, like the scalar version does
+    __m128i values __attribute__((aligned(16)));
+    _mm_store_si128(&values, _mm_cvttps_epi32(clamped));
+    const uint32_t *valuesi = (uint32_t *)(&values);
+
+    histogram[4 * valuesi[0]]++;
+    histogram[4 * valuesi[1]]++;
+    histogram[4 * valuesi[2]]++;
+    histogram[4 * valuesi[3]]++;
+  }
+
+  for(; i < width; i++, input++)
   {
     histogram_helper_cs_RAW_helper_process_pixel_float(histogram_params, input, histogram);
   }
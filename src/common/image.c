@@ -42,8 +42,10 @@
 #include <glob.h>
 #endif
 #include <glib/gstdio.h>
+#include <sys/stat.h>
 
 static void _image_local_copy_full_path(const int imgid, char *pathname, size_t pathname_len);
+static void _image_xmp_forget_pending(const int imgid);
 
 int dt_image_is_ldr(const dt_image_t *img)
 {
@@ -542,6 +544,7 @@ void dt_image_remove(const int32_t imgid)
 
   // make sure we remove from the cache first, or else the cache will look for imgid in sql
   dt_image_cache_remove(darktable.image_cache, imgid);
+  _image_xmp_forget_pending(imgid);
 
   int new_group_id = dt_grouping_remove_from_group(imgid);
   if(darktable.gui && darktable.gui->expanded_group_id == old_group_id)
@@ -1430,9 +1433,27 @@ int dt_image_local_copy_reset(const int32_t imgid)
 // xmp stuff
 // *******************************************************
 
+// the hash of what we wrote last time is only trusted as long as nobody touched the file since then
+static gchar *_image_get_xmp_hash(const int imgid, const char *filename)
+{
+  struct stat statbuf;
+  if(stat(filename, &statbuf)) return NULL;
+
+  gchar *hash = NULL;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT write_timestamp, xmp_hash FROM images WHERE id = ?1", -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  if(sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 1) != SQLITE_NULL
+     && sqlite3_column_int64(stmt, 0) >= statbuf.st_mtime)
+    hash = g_strdup((const char *)sqlite3_column_text(stmt, 1));
+  sqlite3_finalize(stmt);
+
+  return hash;
+}
+
 void dt_image_write_sidecar_file(int imgid)
 {
-  // TODO: compute hash and don't write if not needed!
   // write .xmp file
   if(imgid > 0 && dt_conf_get_bool("write_sidecar_files"))
   {
@@ -1441,27 +1462,118 @@ void dt_image_write_sidecar_file(int imgid)
     dt_image_full_path(imgid, filename, sizeof(filename), &from_cache);
     dt_image_path_append_version(imgid, filename, sizeof(filename));
     g_strlcat(filename, ".xmp", sizeof(filename));
-    if(!dt_exif_xmp_write(imgid, filename))
+
+    gchar *old_hash = _image_get_xmp_hash(imgid, filename);
+    char *new_hash = NULL;
+    if(!dt_exif_xmp_write(imgid, filename, old_hash, &new_hash))
     {
       // put the timestamp into db. this can't be done in exif.cc since that code gets called
       // for the copy exporter, too
       sqlite3_stmt *stmt;
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                  "UPDATE images SET write_timestamp = STRFTIME('%s', 'now') WHERE id = ?1",
-                                  -1, &stmt, NULL);
+      DT_DEBUG_SQLITE3_PREPARE_V2(
+          dt_database_get(darktable.db),
+          "UPDATE images SET write_timestamp = STRFTIME('%s', 'now'), xmp_hash = ?2 WHERE id = ?1", -1, &stmt,
+          NULL);
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, new_hash, -1, SQLITE_STATIC);
       sqlite3_step(stmt);
       sqlite3_finalize(stmt);
     }
+    g_free(old_hash);
+    g_free(new_hash);
+  }
+}
+
+// sidecar files waiting to be written by the background writer. rapid edits of the same image
+// only end up in one write after things calmed down for DT_IMAGE_XMP_WRITE_DELAY ms.
+#define DT_IMAGE_XMP_WRITE_DELAY 1000
+
+static GMutex _xmp_pending_lock;
+static GHashTable *_xmp_pending = NULL;
+static guint _xmp_pending_timeout = 0;
+
+static GList *_image_xmp_pending_steal()
+{
+  GList *imgs = NULL;
+  g_mutex_lock(&_xmp_pending_lock);
+  if(_xmp_pending)
+  {
+    imgs = g_hash_table_get_keys(_xmp_pending);
+    g_hash_table_remove_all(_xmp_pending);
   }
+  g_mutex_unlock(&_xmp_pending_lock);
+  return imgs;
 }
 
+static int32_t _image_xmp_write_job_run(dt_job_t *job)
+{
+  GList *imgs = _image_xmp_pending_steal();
+  for(GList *iter = imgs; iter; iter = g_list_next(iter))
+    dt_image_write_sidecar_file(GPOINTER_TO_INT(iter->data));
+  g_list_free(imgs);
+  return 0;
+}
+
+static gboolean _image_xmp_write_timeout(gpointer user_data)
+{
+  g_mutex_lock(&_xmp_pending_lock);
+  // we might have been replaced by a newer timeout in the meantime
+  if(_xmp_pending_timeout == g_source_get_id(g_main_current_source())) _xmp_pending_timeout = 0;
+  g_mutex_unlock(&_xmp_pending_lock);
+
+  dt_job_t *job = dt_control_job_create(&_image_xmp_write_job_run, "write sidecar files");
+  if(job) dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+  return FALSE;
+}
+
+static void _image_xmp_write_deferred(const int imgid)
+{
+  // without gui there is no main loop driving the timeout, so just write it right away
+  if(!darktable.gui)
+  {
+    dt_image_write_sidecar_file(imgid);
+    return;
+  }
+
+  g_mutex_lock(&_xmp_pending_lock);
+  if(!_xmp_pending) _xmp_pending = g_hash_table_new(NULL, NULL);
+  g_hash_table_add(_xmp_pending, GINT_TO_POINTER(imgid));
+  // restart the countdown on every change
+  if(_xmp_pending_timeout) g_source_remove(_xmp_pending_timeout);
+  _xmp_pending_timeout = g_timeout_add(DT_IMAGE_XMP_WRITE_DELAY, _image_xmp_write_timeout, NULL);
+  g_mutex_unlock(&_xmp_pending_lock);
+}
+
+static void _image_xmp_forget_pending(const int imgid)
+{
+  g_mutex_lock(&_xmp_pending_lock);
+  if(_xmp_pending) g_hash_table_remove(_xmp_pending, GINT_TO_POINTER(imgid));
+  g_mutex_unlock(&_xmp_pending_lock);
+}
+
+void dt_image_synch_xmp_flush()
+{
+  g_mutex_lock(&_xmp_pending_lock);
+  if(_xmp_pending_timeout) g_source_remove(_xmp_pending_timeout);
+  _xmp_pending_timeout = 0;
+  g_mutex_unlock(&_xmp_pending_lock);
+
+  GList *imgs = _image_xmp_pending_steal();
+  for(GList *iter = imgs; iter; iter = g_list_next(iter))
+    dt_image_write_sidecar_file(GPOINTER_TO_INT(iter->data));
+  g_list_free(imgs);
+
+  g_mutex_lock(&_xmp_pending_lock);
+  if(_xmp_pending) g_hash_table_destroy(_xmp_pending);
+  _xmp_pending = NULL;
+  g_mutex_unlock(&_xmp_pending_lock);
+}
 
 void dt_image_synch_xmp(const int selected)
 {
   if(selected > 0)
   {
-    dt_image_write_sidecar_file(selected);
+    if(dt_conf_get_bool("write_sidecar_files")) _image_xmp_write_deferred(selected);
   }
   else if(dt_conf_get_bool("write_sidecar_files"))
   {
@@ -1471,7 +1583,7 @@ void dt_image_synch_xmp(const int selected)
     while(sqlite3_step(stmt) == SQLITE_ROW)
     {
       const int imgid = sqlite3_column_int(stmt, 0);
-      dt_image_write_sidecar_file(imgid);
+      _image_xmp_write_deferred(imgid);
     }
     sqlite3_finalize(stmt);
   }
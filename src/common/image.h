@@ -294,6 +294,8 @@ void dt_image_local_copy_synch(void);
 // xmp functions:
 void dt_image_write_sidecar_file(int imgid);
 void dt_image_synch_xmp(const int selected);
+/** write all sidecar files still waiting for the background writer right away */
+void dt_image_synch_xmp_flush();
 void dt_image_synch_all_xmp(const gchar *pathname);
 
 // add an offset to the exif_datetime_taken field
@@ -234,7 +234,7 @@ void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_i
   {
     // rest about sidecars:
     // also synch dttags file:
-    dt_image_write_sidecar_file(img->id);
+    dt_image_synch_xmp(img->id);
   }
   dt_cache_release(&cache->cache, img->cache_entry);
 }
@@ -25,6 +25,7 @@
 #include "common/exif.h"
 #include "common/image_cache.h"
 #include "common/imageio.h"
+#include "common/imageio_convert.h"
 #include "common/imageio_module.h"
 #ifdef HAVE_OPENEXR
 #include "common/imageio_exr.h"
@@ -518,24 +519,90 @@ int dt_imageio_export(const uint32_t imgid, const char *filename, dt_imageio_mod
                                         0, NULL, copy_metadata, storage, storage_params, num, total);
 }
 
-// internal function: to avoid exif blob reading + 8-bit byteorder flag + high-quality override
-int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
-                                 dt_imageio_module_format_t *format, dt_imageio_module_data_t *format_params,
-                                 const int32_t ignore_exif, const int32_t display_byteorder,
-                                 const gboolean high_quality, const gboolean upscale, const int32_t thumbnail_export,
-                                 const char *filter, const gboolean copy_metadata,
-                                 dt_imageio_module_storage_t *storage,
-                                 dt_imageio_module_data_t *storage_params, int num, int total)
+typedef struct dt_imageio_export_context_t
+{
+  // develop and pipe of the previous image. the nodes of the pipe still refer to the modules of the develop.
+  dt_develop_t *dev;
+  dt_dev_pixelpipe_t *pipe;
+  int32_t thumbnail_export;
+  int levels;
+} dt_imageio_export_context_t;
+
+// exports of a job run one after the other in the same thread
+static __thread dt_imageio_export_context_t *_export_context = NULL;
+
+void dt_imageio_export_context_begin()
+{
+  if(_export_context) return;
+  _export_context = (dt_imageio_export_context_t *)calloc(1, sizeof(dt_imageio_export_context_t));
+}
+
+void dt_imageio_export_context_end()
 {
-  dt_develop_t dev;
-  dt_dev_init(&dev, 0);
+  dt_imageio_export_context_t *ctx = _export_context;
+  if(!ctx) return;
+  if(ctx->pipe)
+  {
+    dt_dev_pixelpipe_cleanup(ctx->pipe);
+    free(ctx->pipe);
+  }
+  if(ctx->dev)
+  {
+    dt_dev_cleanup(ctx->dev);
+    free(ctx->dev);
+  }
+  free(ctx);
+  _export_context = NULL;
+}
+
+// throw away dev, and pipe unless it's the one of the context, which still has the nodes of the previous image
+static void _export_drop(dt_imageio_export_context_t *ctx, dt_develop_t *dev, dt_dev_pixelpipe_t *pipe)
+{
+  if(!ctx || ctx->pipe != pipe)
+  {
+    dt_dev_pixelpipe_cleanup(pipe);
+    free(pipe);
+  }
+  dt_dev_cleanup(dev);
+  free(dev);
+}
+
+static double _export_scale(const dt_imageio_module_data_t *const format_params,
+                            const dt_dev_pixelpipe_t *const pipe, const float max_scale)
+{
+  const double scalex = format_params->max_width > 0
+                            ? fminf(format_params->max_width / (double)pipe->processed_width, max_scale)
+                            : 1.0;
+  const double scaley = format_params->max_height > 0
+                            ? fminf(format_params->max_height / (double)pipe->processed_height, max_scale)
+                            : 1.0;
+  return fminf(scalex, scaley);
+}
+
+static int _export_renditions(const uint32_t imgid, const dt_imageio_rendition_t *const renditions,
+                              const int count, const int32_t ignore_exif, const int32_t display_byteorder,
+                              const gboolean high_quality, const gboolean upscale, const int32_t thumbnail_export,
+                              const char *filter, const gboolean copy_metadata,
+                              dt_imageio_module_storage_t *storage, dt_imageio_module_data_t *storage_params,
+                              int num, int total)
+{
+  // style and output levels of the pipe are taken from the first rendition
+  dt_imageio_module_format_t *format = renditions[0].format;
+  dt_imageio_module_data_t *format_params = renditions[0].format_params;
+  // several renditions share one run of the pipe at the size of the largest of them, with the downsampling at
+  // the very end. the others are resampled from its float output.
+  const gboolean shared = count > 1;
+
+  dt_imageio_export_context_t *ctx = _export_context;
+  dt_develop_t *dev = (dt_develop_t *)malloc(sizeof(dt_develop_t));
+  dt_dev_init(dev, 0);
   dt_mipmap_buffer_t buf;
   if(thumbnail_export && dt_conf_get_bool("plugins/lighttable/low_quality_thumbnails"))
     dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_F, DT_MIPMAP_BLOCKING, 'r');
   else
     dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
-  dt_dev_load_image(&dev, imgid);
-  const dt_image_t *img = &dev.image_storage;
+  dt_dev_load_image(dev, imgid);
+  const dt_image_t *img = &dev->image_storage;
   const int wd = img->width;
   const int ht = img->height;
   const float max_scale = upscale ? 100.0 : 1.0;
@@ -544,17 +611,29 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
 
   dt_times_t start;
   dt_get_times(&start);
-  dt_dev_pixelpipe_t pipe;
-  res = thumbnail_export ? dt_dev_pixelpipe_init_thumbnail(&pipe, wd, ht)
-                         : dt_dev_pixelpipe_init_export(&pipe, wd, ht, format->levels(format_params));
-  if(!res)
-  {
-    dt_control_log(
-        _("failed to allocate memory for %s, please lower the threads used for export or buy more memory."),
-        thumbnail_export ? C_("noun", "thumbnail export") : C_("noun", "export"));
-    dt_dev_cleanup(&dev);
-    dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
-    return 1;
+  const int levels = thumbnail_export ? 0 : format->levels(format_params);
+  dt_dev_pixelpipe_t *pipe = NULL;
+  if(ctx && ctx->pipe && ctx->thumbnail_export == thumbnail_export && ctx->levels == levels)
+  {
+    // its buffers only grow, and its nodes are replaced below
+    pipe = ctx->pipe;
+  }
+  else
+  {
+    pipe = (dt_dev_pixelpipe_t *)malloc(sizeof(dt_dev_pixelpipe_t));
+    res = thumbnail_export ? dt_dev_pixelpipe_init_thumbnail(pipe, wd, ht)
+                           : dt_dev_pixelpipe_init_export(pipe, wd, ht, levels);
+    if(!res)
+    {
+      dt_control_log(
+          _("failed to allocate memory for %s, please lower the threads used for export or buy more memory."),
+          thumbnail_export ? C_("noun", "thumbnail export") : C_("noun", "export"));
+      free(pipe);
+      dt_dev_cleanup(dev);
+      free(dev);
+      dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+      return 1;
+    }
   }
 
   if(!buf.buf)
@@ -562,7 +641,7 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
     fprintf(stderr, "allocation failed???\n");
     dt_control_log(_("image `%s' is not available!"), img->filename);
     dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
-    dt_dev_cleanup(&dev);
+    _export_drop(ctx, dev, pipe);
     return 1;
   }
 
@@ -571,13 +650,13 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
   {
     GList *stls;
 
-    GList *modules = dev.iop;
+    GList *modules = dev->iop;
     dt_iop_module_t *m = NULL;
 
     if((stls = dt_styles_get_item_list(format_params->style, TRUE, -1)) == 0)
     {
       dt_control_log(_("cannot find the style '%s' to apply during export."), format_params->style);
-      dt_dev_cleanup(&dev);
+      _export_drop(ctx, dev, pipe);
       dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
       return 1;
     }
@@ -588,7 +667,7 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
       dt_style_item_t *s = (dt_style_item_t *)stls->data;
       gboolean module_found = FALSE;
 
-      modules = dev.iop;
+      modules = dev->iop;
       while(modules)
       {
         m = (dt_iop_module_t *)modules->data;
@@ -626,8 +705,8 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
             h->params = new_params;
           }
 
-          dev.history_end++;
-          dev.history = g_list_append(dev.history, h);
+          dev->history_end++;
+          dev->history = g_list_append(dev->history, h);
           module_found = TRUE;
           g_free(s->name);
           break;
@@ -640,15 +719,24 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
     g_list_free(stls);
   }
 
-  dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf, buf.width, buf.height, 1.0);
-  dt_dev_pixelpipe_create_nodes(&pipe, &dev);
-  dt_dev_pixelpipe_synch_all(&pipe, &dev);
-  dt_dev_pixelpipe_get_dimensions(&pipe, &dev, pipe.iwidth, pipe.iheight, &pipe.processed_width,
-                                  &pipe.processed_height);
+  dt_dev_pixelpipe_set_input(pipe, dev, (float *)buf.buf, buf.width, buf.height, 1.0);
+  if(pipe->nodes)
+  {
+    // taking over what can be reused from the previous image, whose modules can go after that
+    dt_dev_pixelpipe_recreate_nodes(pipe, dev);
+    dt_dev_cleanup(ctx->dev);
+    free(ctx->dev);
+    ctx->dev = NULL;
+  }
+  else
+    dt_dev_pixelpipe_create_nodes(pipe, dev);
+  dt_dev_pixelpipe_synch_all(pipe, dev);
+  dt_dev_pixelpipe_get_dimensions(pipe, dev, pipe->iwidth, pipe->iheight, &pipe->processed_width,
+                                  &pipe->processed_height);
   if(filter)
   {
-    if(!strncmp(filter, "pre:", 4)) dt_dev_pixelpipe_disable_after(&pipe, filter + 4);
-    if(!strncmp(filter, "post:", 5)) dt_dev_pixelpipe_disable_before(&pipe, filter + 5);
+    if(!strncmp(filter, "pre:", 4)) dt_dev_pixelpipe_disable_after(pipe, filter + 4);
+    if(!strncmp(filter, "post:", 5)) dt_dev_pixelpipe_disable_before(pipe, filter + 5);
   }
   dt_show_times(&start, "[export] creating pixelpipe", NULL);
 
@@ -661,7 +749,7 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
   }
   else if(!overprofile || !strcmp(overprofile, "image"))
   {
-    GList *modules = dev.iop;
+    GList *modules = dev->iop;
     dt_iop_module_t *colorout = NULL;
     while(modules)
     {
@@ -685,18 +773,19 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
 
   // get only once at the beginning, in case the user changes it on the way:
   const gboolean high_quality_processing
-      = ((format_params->max_width == 0 || format_params->max_width >= pipe.processed_width)
-         && (format_params->max_height == 0 || format_params->max_height >= pipe.processed_height))
-            ? FALSE
-            : high_quality;
+      = shared ? TRUE
+               : ((format_params->max_width == 0 || format_params->max_width >= pipe->processed_width)
+                  && (format_params->max_height == 0 || format_params->max_height >= pipe->processed_height))
+                      ? FALSE
+                      : high_quality;
   const int width = high_quality_processing ? 0 : format_params->max_width;
   const int height = high_quality_processing ? 0 : format_params->max_height;
-  const double scalex = width > 0 ? fminf(width / (double)pipe.processed_width, max_scale) : 1.0;
-  const double scaley = height > 0 ? fminf(height / (double)pipe.processed_height, max_scale) : 1.0;
+  const double scalex = width > 0 ? fminf(width / (double)pipe->processed_width, max_scale) : 1.0;
+  const double scaley = height > 0 ? fminf(height / (double)pipe->processed_height, max_scale) : 1.0;
   const double scale = fminf(scalex, scaley);
-  int processed_width = scale * pipe.processed_width + .5f;
-  int processed_height = scale * pipe.processed_height + .5f;
-  const int bpp = format->bpp(format_params);
+  int processed_width = scale * pipe->processed_width + .5f;
+  int processed_height = scale * pipe->processed_height + .5f;
+  const int pipe_bpp = format->bpp(format_params);
 
   dt_get_times(&start);
   if(high_quality_processing)
@@ -705,24 +794,20 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
      * if high quality processing was requested, downsampling will be done
      * at the very end of the pipe (just before border and watermark)
      */
-    const double scalex = format_params->max_width > 0
-                              ? fminf(format_params->max_width / (double)pipe.processed_width, max_scale)
-                              : 1.0;
-    const double scaley = format_params->max_height > 0
-                              ? fminf(format_params->max_height / (double)pipe.processed_height, max_scale)
-                              : 1.0;
-    const double scale = fminf(scalex, scaley);
-    processed_width = scale * pipe.processed_width + .5f;
-    processed_height = scale * pipe.processed_height + .5f;
-
-    dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0, processed_width, processed_height, scale);
+    double scale = _export_scale(format_params, pipe, max_scale);
+    for(int r = 1; r < count; r++)
+      scale = fmax(scale, _export_scale(renditions[r].format_params, pipe, max_scale));
+    processed_width = scale * pipe->processed_width + .5f;
+    processed_height = scale * pipe->processed_height + .5f;
+
+    dt_dev_pixelpipe_process_no_gamma(pipe, dev, 0, 0, processed_width, processed_height, scale);
   }
   else
   {
     // else, downsampling will be right after demosaic
 
     // so we need to turn temporarily disable in-pipe late downsampling iop.
-    GList *finalscalep = g_list_last(pipe.nodes);
+    GList *finalscalep = g_list_last(pipe->nodes);
     dt_dev_pixelpipe_iop_t *finalscale = (dt_dev_pixelpipe_iop_t *)finalscalep->data;
     while(strcmp(finalscale->module->op, "finalscale"))
     {
@@ -734,10 +819,10 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
     if(finalscale) finalscale->enabled = 0;
 
     // do the processing (8-bit with special treatment, to make sure we can use openmp further down):
-    if(bpp == 8)
-      dt_dev_pixelpipe_process(&pipe, &dev, 0, 0, processed_width, processed_height, scale);
+    if(pipe_bpp == 8)
+      dt_dev_pixelpipe_process(pipe, dev, 0, 0, processed_width, processed_height, scale);
     else
-      dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0, processed_width, processed_height, scale);
+      dt_dev_pixelpipe_process_no_gamma(pipe, dev, 0, 0, processed_width, processed_height, scale);
 
     if(finalscale) finalscale->enabled = 1;
   }
@@ -745,121 +830,167 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
                                          : "[dev_process_export] pixel pipeline processing",
                 NULL);
 
-  uint8_t *outbuf = pipe.backbuf;
-
-  // downconversion to low-precision formats:
-  if(bpp == 8)
+  const float *const master = (const float *)pipe->backbuf;
+  const int master_width = processed_width, master_height = processed_height;
+  for(int r = 0; r < count; r++)
   {
-    if(display_byteorder)
+    const char *filename = renditions[r].filename;
+    format = renditions[r].format;
+    format_params = renditions[r].format_params;
+    const int bpp = format->bpp(format_params);
+    uint8_t *outbuf = pipe->backbuf;
+    if(shared)
     {
-      if(high_quality_processing)
+      const double scale = _export_scale(format_params, pipe, max_scale);
+      processed_width = scale * pipe->processed_width + .5f;
+      processed_height = scale * pipe->processed_height + .5f;
+      outbuf = (uint8_t *)dt_alloc_align(64, (size_t)4 * sizeof(float) * processed_width * processed_height);
+      if(!outbuf)
       {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff);
-          const uint8_t g = CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff);
-          const uint8_t b = CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff);
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
+        res = 1;
+        break;
+      }
+      if(processed_width == master_width && processed_height == master_height)
+        memcpy(outbuf, master, (size_t)4 * sizeof(float) * processed_width * processed_height);
+      else
+      {
+        const dt_iop_roi_t roi_in = { 0, 0, master_width, master_height, 1.0f };
+        const dt_iop_roi_t roi_out
+            = { 0, 0, processed_width, processed_height, processed_width / (float)master_width };
+        dt_iop_clip_and_zoom((float *)outbuf, master, &roi_out, &roi_in, processed_width, master_width);
       }
-      // else processing output was 8-bit already, and no need to swap order
     }
-    else // need to flip
+
+    // downconversion to low-precision formats:
+    if(bpp == 8)
     {
-      // ldr output: char
+      // the gamma module already did it if we didn't process in high quality, but the byte order may be off
       if(high_quality_processing)
       {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff);
-          const uint8_t g = CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff);
-          const uint8_t b = CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff);
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
-      }
-      else
-      { // !display_byteorder, need to swap:
-        uint8_t *const buf8 = pipe.backbuf;
-#ifdef _OPENMP
-#pragma omp parallel for default(none) shared(processed_width, processed_height) schedule(static)
-#endif
-        // just flip byte order
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          uint8_t tmp = buf8[4 * k + 0];
-          buf8[4 * k + 0] = buf8[4 * k + 2];
-          buf8[4 * k + 2] = tmp;
-        }
+        // breaks up banding in smooth gradients, thumbnails don't need it
+        const int dither = !thumbnail_export && dt_conf_get_bool("plugins/lighttable/export/dither_8bit");
+        dt_imageio_convert_float_u8(outbuf, processed_width, processed_height,
+                                    (display_byteorder ? DT_IMAGEIO_CONVERT_SWAP_RB : DT_IMAGEIO_CONVERT_NONE)
+                                        | (dither ? DT_IMAGEIO_CONVERT_DITHER : DT_IMAGEIO_CONVERT_NONE));
       }
+      else if(!display_byteorder)
+        dt_imageio_convert_u8(outbuf, processed_width, processed_height, DT_IMAGEIO_CONVERT_SWAP_RB);
     }
-  }
-  else if(bpp == 16)
-  {
-    // uint16_t per color channel
-    float *buff = (float *)outbuf;
-    uint16_t *buf16 = (uint16_t *)outbuf;
-    for(int y = 0; y < processed_height; y++)
-      for(int x = 0; x < processed_width; x++)
-      {
-        // convert in place
-        const size_t k = (size_t)processed_width * y + x;
-        for(int i = 0; i < 3; i++) buf16[4 * k + i] = CLAMP(buff[4 * k + i] * 0x10000, 0, 0xffff);
-      }
-  }
-  // else output float, no further harm done to the pixels :)
+    else if(bpp == 16)
+    {
+      // uint16_t per color channel
+      dt_imageio_convert_float_u16(outbuf, processed_width, processed_height, DT_IMAGEIO_CONVERT_NONE);
+    }
+    // else output float, no further harm done to the pixels :)
 
-  format_params->width = processed_width;
-  format_params->height = processed_height;
+    format_params->width = processed_width;
+    format_params->height = processed_height;
 
-  if(!ignore_exif)
-  {
-    int length;
-    uint8_t exif_profile[65535]; // C++ alloc'ed buffer is uncool, so we waste some bits here.
-    char pathname[PATH_MAX] = { 0 };
-    gboolean from_cache = TRUE;
-    dt_image_full_path(imgid, pathname, sizeof(pathname), &from_cache);
-    // last param is dng mode, it's false here
-    length = dt_exif_read_blob(exif_profile, pathname, imgid, sRGB, processed_width, processed_height, 0);
+    if(!ignore_exif)
+    {
+      int length;
+      uint8_t exif_profile[65535]; // C++ alloc'ed buffer is uncool, so we waste some bits here.
+      char pathname[PATH_MAX] = { 0 };
+      gboolean from_cache = TRUE;
+      dt_image_full_path(imgid, pathname, sizeof(pathname), &from_cache);
+      // last param is dng mode, it's false here
+      length = dt_exif_read_blob(exif_profile, pathname, imgid, sRGB, processed_width, processed_height, 0);
+
+      res = format->write_image(format_params, filename, outbuf, exif_profile, length, imgid, num, total);
+    }
+    else
+    {
+      res = format->write_image(format_params, filename, outbuf, NULL, 0, imgid, num, total);
+    }
 
-    res = format->write_image(format_params, filename, outbuf, exif_profile, length, imgid, num, total);
-  }
-  else
-  {
-    res = format->write_image(format_params, filename, outbuf, NULL, 0, imgid, num, total);
+    if(shared) dt_free_align(outbuf);
+
+    /* now write xmp into that container, if possible */
+    if(copy_metadata && (format->flags(format_params) & FORMAT_FLAGS_SUPPORT_XMP))
+    {
+      dt_exif_xmp_attach(imgid, filename);
+      // no need to cancel the export if this fail
+    }
+
+
+    if(!thumbnail_export && strcmp(format->mime(format_params), "memory"))
+    {
+      dt_imageio_module_data_t *format_copy = format->get_params(format);
+      memcpy(format_copy,format_params,format->params_size(format));
+      dt_imageio_module_data_t *storage_copy = storage->get_params(storage);
+      memcpy(storage_copy,storage_params,storage->params_size(storage));
+      dt_control_signal_raise(darktable.signals, DT_SIGNAL_IMAGE_EXPORT_TMPFILE, imgid, filename, format,
+                              format_copy, storage, storage_copy);
+    }
+    if(res) break;
   }
 
-  dt_dev_pixelpipe_cleanup(&pipe);
-  dt_dev_cleanup(&dev);
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
-
-  /* now write xmp into that container, if possible */
-  if(copy_metadata && (format->flags(format_params) & FORMAT_FLAGS_SUPPORT_XMP))
+  if(ctx)
   {
-    dt_exif_xmp_attach(imgid, filename);
-    // no need to cancel the export if this fail
+    // keep all of it for the next image
+    if(ctx->pipe && ctx->pipe != pipe)
+    {
+      dt_dev_pixelpipe_cleanup(ctx->pipe);
+      free(ctx->pipe);
+      dt_dev_cleanup(ctx->dev);
+      free(ctx->dev);
+    }
+    ctx->pipe = pipe;
+    ctx->dev = dev;
+    ctx->thumbnail_export = thumbnail_export;
+    ctx->levels = levels;
+    pipe->input = NULL;
   }
-
-
-  if(!thumbnail_export && strcmp(format->mime(format_params), "memory"))
+  else
   {
-    dt_imageio_module_data_t *format_copy = format->get_params(format);
-    memcpy(format_copy,format_params,format->params_size(format));
-    dt_imageio_module_data_t *storage_copy = storage->get_params(storage);
-    memcpy(storage_copy,storage_params,storage->params_size(storage));
-    dt_control_signal_raise(darktable.signals, DT_SIGNAL_IMAGE_EXPORT_TMPFILE, imgid, filename, format,
-                            format_copy, storage, storage_copy);
+    dt_dev_pixelpipe_cleanup(pipe);
+    free(pipe);
+    dt_dev_cleanup(dev);
+    free(dev);
   }
+
   return res;
 }
 
+// internal function: to avoid exif blob reading + 8-bit byteorder flag + high-quality override
+int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
+                                 dt_imageio_module_format_t *format, dt_imageio_module_data_t *format_params,
+                                 const int32_t ignore_exif, const int32_t display_byteorder,
+                                 const gboolean high_quality, const gboolean upscale, const int32_t thumbnail_export,
+                                 const char *filter, const gboolean copy_metadata,
+                                 dt_imageio_module_storage_t *storage,
+                                 dt_imageio_module_data_t *storage_params, int num, int total)
+{
+  const dt_imageio_rendition_t rendition = { filename, format, format_params };
+  return _export_renditions(imgid, &rendition, 1, ignore_exif, display_byteorder, high_quality, upscale,
+                            thumbnail_export, filter, copy_metadata, storage, storage_params, num, total);
+}
+
+int dt_imageio_export_renditions(const uint32_t imgid, const dt_imageio_rendition_t *const renditions,
+                                 const int count, const gboolean high_quality, const gboolean upscale,
+                                 const gboolean copy_metadata, dt_imageio_module_storage_t *storage,
+                                 dt_imageio_module_data_t *storage_params, int num, int total)
+{
+  if(count == 1)
+    return dt_imageio_export(imgid, renditions[0].filename, renditions[0].format, renditions[0].format_params,
+                             high_quality, upscale, copy_metadata, storage, storage_params, num, total);
+
+  // plain copies don't go through the pipe at all
+  for(int k = 0; k < count; k++)
+    if(strcmp(renditions[k].format->mime(renditions[k].format_params), "x-copy") == 0)
+    {
+      int res = 0;
+      for(int i = 0; i < count && !res; i++)
+        res = dt_imageio_export(imgid, renditions[i].filename, renditions[i].format, renditions[i].format_params,
+                                high_quality, upscale, copy_metadata, storage, storage_params, num, total);
+      return res;
+    }
+
+  return _export_renditions(imgid, renditions, count, 0, 0, high_quality, upscale, 0, NULL, copy_metadata,
+                            storage, storage_params, num, total);
+}
+
 
 // fallback read method in case file could not be opened yet.
 // use GraphicsMagick (if supported) to read exotic LDRs
@@ -67,6 +67,29 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
                                  const gboolean copy_metadata, dt_imageio_module_storage_t *storage,
                                  dt_imageio_module_data_t *storage_params, int num, int total);
 
+/** one output of an export: the file name and the format to write it in. the size comes from the max_width
+ * and max_height of the format params. */
+typedef struct dt_imageio_rendition_t
+{
+  const char *filename;
+  struct dt_imageio_module_format_t *format;
+  struct dt_imageio_module_data_t *format_params;
+} dt_imageio_rendition_t;
+
+/** export several renditions of the same image with a single run of the pixelpipe, at the size of the largest
+ * one. the smaller ones are resampled from its output. style and output levels are taken from the first
+ * rendition, so they should all share these. */
+int dt_imageio_export_renditions(const uint32_t imgid, const dt_imageio_rendition_t *const renditions,
+                                 const int count, const gboolean high_quality, const gboolean upscale,
+                                 const gboolean copy_metadata, dt_imageio_module_storage_t *storage,
+                                 dt_imageio_module_data_t *storage_params, int num, int total);
+
+/** keep the develop, the pixelpipe with its buffers and the committed data of image independent modules of
+ * one export for the next one, until dt_imageio_export_context_end(). for a batch of exports run one after
+ * the other in the calling thread, the exports pick it up by themselves. */
+void dt_imageio_export_context_begin();
+void dt_imageio_export_context_end();
+
 size_t dt_imageio_write_pos(int i, int j, int wd, int ht, float fwd, float fht,
                             dt_image_orientation_t orientation);
 
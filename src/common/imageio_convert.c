@@ -0,0 +1,246 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2016 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "common/imageio_convert.h"
+#include "common/darktable.h"
+
+#include <emmintrin.h>
+#include <string.h>
+
+typedef enum _convert_kind_t
+{
+  CONVERT_FLOAT_U8,
+  CONVERT_FLOAT_U16,
+  CONVERT_U8
+} _convert_kind_t;
+
+// 4x4 bayer matrix for the ordered dither
+static const uint8_t _bayer[4][4] = { { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 } };
+
+static inline int _channel(const dt_imageio_convert_flags_t flags, const int c)
+{
+  return ((flags & DT_IMAGEIO_CONVERT_SWAP_RB) && c < 3) ? 2 - c : c;
+}
+
+void dt_imageio_convert_row_float_u8(const float *in, uint8_t *out, const int width, const int y,
+                                     const dt_imageio_convert_flags_t flags)
+{
+  const int swap = flags & DT_IMAGEIO_CONVERT_SWAP_RB;
+  const int ch = (flags & DT_IMAGEIO_CONVERT_RGB) ? 3 : 4;
+  const int dither = flags & DT_IMAGEIO_CONVERT_DITHER;
+
+  // values are truncated, so the dither offset is in [0, 1) to keep the mean. alpha isn't dithered.
+  float t[4];
+  __m128 offset[4];
+  for(int j = 0; j < 4; j++)
+  {
+    t[j] = dither ? (_bayer[y & 3][j] + 0.5f) / 16.0f : 0.0f;
+    offset[j] = _mm_set_ps(0.0f, t[j], t[j], t[j]);
+  }
+
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 val_min = _mm_setzero_ps();
+  const __m128 val_max = _mm_set1_ps(255.0f);
+
+  // four pixels at a time. all input is loaded before the output is stored, so this works in place, too.
+  int x = 0;
+  for(; x + 4 <= width; x += 4)
+  {
+    __m128i i[4];
+    for(int j = 0; j < 4; j++)
+    {
+      __m128 v = _mm_loadu_ps(in + 4 * (x + j));
+      if(swap) v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+      v = _mm_add_ps(_mm_mul_ps(v, scale), offset[j]);
+      i[j] = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, val_min), val_max));
+    }
+    const __m128i px = _mm_packus_epi16(_mm_packs_epi32(i[0], i[1]), _mm_packs_epi32(i[2], i[3]));
+    if(ch == 3)
+    {
+      uint8_t tmp[16] __attribute__((aligned(16)));
+      _mm_store_si128((__m128i *)tmp, px);
+      for(int j = 0; j < 4; j++) memcpy(out + 3 * (x + j), tmp + 4 * j, 3);
+    }
+    else
+      _mm_storeu_si128((__m128i *)(out + 4 * x), px);
+  }
+  for(; x < width; x++)
+  {
+    const float *p = in + 4 * x;
+    uint8_t px[4];
+    for(int c = 0; c < 4; c++)
+      px[c] = CLAMP(p[_channel(flags, c)] * 0xff + (c < 3 ? t[x & 3] : 0.0f), 0, 0xff);
+    memcpy(out + ch * x, px, ch);
+  }
+}
+
+// the pipe delivers 16 bit to all writers that want it, so this is only needed for the whole-image conversion
+static void _convert_row_float_u16(const float *in, uint16_t *out, const int width,
+                                   const dt_imageio_convert_flags_t flags)
+{
+  const int swap = flags & DT_IMAGEIO_CONVERT_SWAP_RB;
+  const int ch = (flags & DT_IMAGEIO_CONVERT_RGB) ? 3 : 4;
+  const int byteswap = flags & DT_IMAGEIO_CONVERT_BYTESWAP;
+
+  const __m128 scale = _mm_set1_ps(0x10000);
+  const __m128 val_min = _mm_setzero_ps();
+  const __m128 val_max = _mm_set1_ps(0xffff);
+  // sse2 can only pack with signed saturation, so move the range to signed and back
+  const __m128i bias = _mm_set1_epi32(0x8000);
+  const __m128i sign = _mm_set1_epi16((short)0x8000);
+
+  int x = 0;
+  for(; x + 2 <= width; x += 2)
+  {
+    __m128i i[2];
+    for(int j = 0; j < 2; j++)
+    {
+      __m128 v = _mm_loadu_ps(in + 4 * (x + j));
+      if(swap) v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+      v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, scale), val_min), val_max);
+      i[j] = _mm_sub_epi32(_mm_cvttps_epi32(v), bias);
+    }
+    __m128i px = _mm_xor_si128(_mm_packs_epi32(i[0], i[1]), sign);
+    if(byteswap) px = _mm_or_si128(_mm_slli_epi16(px, 8), _mm_srli_epi16(px, 8));
+    if(ch == 3)
+    {
+      uint16_t tmp[8] __attribute__((aligned(16)));
+      _mm_store_si128((__m128i *)tmp, px);
+      memcpy(out + 3 * x, tmp, 3 * sizeof(uint16_t));
+      memcpy(out + 3 * (x + 1), tmp + 4, 3 * sizeof(uint16_t));
+    }
+    else
+      _mm_storeu_si128((__m128i *)(out + 4 * x), px);
+  }
+  for(; x < width; x++)
+  {
+    const float *p = in + 4 * x;
+    uint16_t px[4];
+    for(int c = 0; c < 4; c++)
+    {
+      px[c] = CLAMP(p[_channel(flags, c)] * 0x10000, 0, 0xffff);
+      if(byteswap) px[c] = (px[c] << 8) | (px[c] >> 8);
+    }
+    memcpy(out + ch * x, px, ch * sizeof(uint16_t));
+  }
+}
+
+void dt_imageio_convert_row_float(const float *in, float *out, const int width,
+                                  const dt_imageio_convert_flags_t flags)
+{
+  const int ch = (flags & DT_IMAGEIO_CONVERT_RGB) ? 3 : 4;
+  for(int x = 0; x < width; x++)
+  {
+    float px[4];
+    for(int c = 0; c < 4; c++) px[c] = in[4 * x + _channel(flags, c)];
+    memcpy(out + ch * x, px, ch * sizeof(float));
+  }
+}
+
+void dt_imageio_convert_row_u8(const uint8_t *in, uint8_t *out, const int width,
+                               const dt_imageio_convert_flags_t flags)
+{
+  const int ch = (flags & DT_IMAGEIO_CONVERT_RGB) ? 3 : 4;
+  for(int x = 0; x < width; x++)
+  {
+    uint8_t px[4];
+    for(int c = 0; c < 4; c++) px[c] = in[4 * x + _channel(flags, c)];
+    memcpy(out + ch * x, px, ch);
+  }
+}
+
+void dt_imageio_convert_row_u16(const uint16_t *in, uint16_t *out, const int width,
+                                const dt_imageio_convert_flags_t flags)
+{
+  const int ch = (flags & DT_IMAGEIO_CONVERT_RGB) ? 3 : 4;
+  const int byteswap = flags & DT_IMAGEIO_CONVERT_BYTESWAP;
+  for(int x = 0; x < width; x++)
+  {
+    uint16_t px[4];
+    for(int c = 0; c < 4; c++)
+    {
+      px[c] = in[4 * x + _channel(flags, c)];
+      if(byteswap) px[c] = (px[c] << 8) | (px[c] >> 8);
+    }
+    memcpy(out + ch * x, px, ch * sizeof(uint16_t));
+  }
+}
+
+static void _convert_row(uint8_t *buf, const int width, const int y, const size_t in_bpp, const size_t out_bpp,
+                         const _convert_kind_t kind, const dt_imageio_convert_flags_t flags)
+{
+  const uint8_t *in = buf + in_bpp * width * y;
+  uint8_t *out = buf + out_bpp * width * y;
+  switch(kind)
+  {
+    case CONVERT_FLOAT_U8:
+      dt_imageio_convert_row_float_u8((const float *)in, out, width, y, flags);
+      break;
+    case CONVERT_FLOAT_U16:
+      _convert_row_float_u16((const float *)in, (uint16_t *)out, width, flags);
+      break;
+    case CONVERT_U8:
+      dt_imageio_convert_row_u8(in, out, width, flags);
+      break;
+  }
+}
+
+// the output shrinks, so rows can't be converted in any order: the output of row y must not overwrite the
+// input of rows which haven't been read yet. it ends before the input of row a starts as long as
+// y < a * in_bpp / out_bpp, so rows are converted in rounds [a, a * in_bpp / out_bpp), each one in parallel.
+static void _convert_in_place(uint8_t *buf, const int width, const int height, const size_t in_bpp,
+                              const size_t out_bpp, const _convert_kind_t kind,
+                              const dt_imageio_convert_flags_t flags)
+{
+  if(height <= 0) return;
+  _convert_row(buf, width, 0, in_bpp, out_bpp, kind, flags);
+
+  int a = 1;
+  while(a < height)
+  {
+    const int b = (in_bpp == out_bpp) ? height : MIN(height, MAX(a + 1, (int)(a * in_bpp / out_bpp)));
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for(int y = a; y < b; y++) _convert_row(buf, width, y, in_bpp, out_bpp, kind, flags);
+    a = b;
+  }
+}
+
+void dt_imageio_convert_float_u8(void *buf, const int width, const int height,
+                                 const dt_imageio_convert_flags_t flags)
+{
+  const size_t out_bpp = (flags & DT_IMAGEIO_CONVERT_RGB) ? 3 : 4;
+  _convert_in_place(buf, width, height, 4 * sizeof(float), out_bpp, CONVERT_FLOAT_U8, flags);
+}
+
+void dt_imageio_convert_float_u16(void *buf, const int width, const int height,
+                                  const dt_imageio_convert_flags_t flags)
+{
+  const size_t out_bpp = ((flags & DT_IMAGEIO_CONVERT_RGB) ? 3 : 4) * sizeof(uint16_t);
+  _convert_in_place(buf, width, height, 4 * sizeof(float), out_bpp, CONVERT_FLOAT_U16, flags);
+}
+
+void dt_imageio_convert_u8(void *buf, const int width, const int height, const dt_imageio_convert_flags_t flags)
+{
+  const size_t out_bpp = (flags & DT_IMAGEIO_CONVERT_RGB) ? 3 : 4;
+  _convert_in_place(buf, width, height, 4, out_bpp, CONVERT_U8, flags);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
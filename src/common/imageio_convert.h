@@ -0,0 +1,54 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2016 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DT_IMAGEIO_CONVERT_H
+#define DT_IMAGEIO_CONVERT_H
+
+#include <inttypes.h>
+
+/** conversions of the 4 channel pipe output to what the format modules write. */
+typedef enum dt_imageio_convert_flags_t
+{
+  DT_IMAGEIO_CONVERT_NONE = 0,
+  DT_IMAGEIO_CONVERT_SWAP_RB = 1 << 0,  // exchange the first and the third channel
+  DT_IMAGEIO_CONVERT_RGB = 1 << 1,      // drop the fourth channel, write packed rgb
+  DT_IMAGEIO_CONVERT_BYTESWAP = 1 << 2, // 16-bit samples with the most significant byte first
+  DT_IMAGEIO_CONVERT_DITHER = 1 << 3    // ordered dithering when going from float to 8 bit
+} dt_imageio_convert_flags_t;
+
+/** convert one row of width pixels. floats are clamped to [0, 1] and scaled to 0xff (truncated,
+ * like the rest of the export), y is only needed for the dither pattern. in and out may be the same buffer. */
+void dt_imageio_convert_row_float_u8(const float *in, uint8_t *out, const int width, const int y,
+                                     const dt_imageio_convert_flags_t flags);
+void dt_imageio_convert_row_float(const float *in, float *out, const int width,
+                                  const dt_imageio_convert_flags_t flags);
+void dt_imageio_convert_row_u8(const uint8_t *in, uint8_t *out, const int width,
+                               const dt_imageio_convert_flags_t flags);
+void dt_imageio_convert_row_u16(const uint16_t *in, uint16_t *out, const int width,
+                                const dt_imageio_convert_flags_t flags);
+
+/** convert a whole 4 channel image in place, on all threads. */
+void dt_imageio_convert_float_u8(void *buf, const int width, const int height,
+                                 const dt_imageio_convert_flags_t flags);
+void dt_imageio_convert_float_u16(void *buf, const int width, const int height,
+                                  const dt_imageio_convert_flags_t flags);
+void dt_imageio_convert_u8(void *buf, const int width, const int height, const dt_imageio_convert_flags_t flags);
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
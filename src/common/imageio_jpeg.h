@@ -43,6 +43,9 @@ typedef struct dt_imageio_jpeg_t
 
 /** reads the header and fills width/height in jpg struct. */
 int dt_imageio_jpeg_decompress_header(const void *in, size_t length, dt_imageio_jpeg_t *jpg);
+/** let the decoder downscale by 1/2, 1/4 or 1/8 in the dct domain, as far as possible without getting smaller
+ * than the image fitted into width x height. updates width/height in jpg struct, call before decompressing. */
+void dt_imageio_jpeg_scale_to_fit(dt_imageio_jpeg_t *jpg, const int width, const int height);
 /** reads the whole image to the out buffer, which has to be large enough. */
 int dt_imageio_jpeg_decompress(dt_imageio_jpeg_t *jpg, uint8_t *out);
 /** compresses in to out buffer with given quality (0..100). out buffer must be large enough. returns actual
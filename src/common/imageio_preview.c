@@ -0,0 +1,295 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2016 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "common/imageio_preview.h"
+#include "common/imageio_jpeg.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// don't get caught in broken or malicious files
+#define DT_PREVIEW_MAX_IFDS 32
+#define DT_PREVIEW_MAX_ENTRIES 1024
+#define DT_PREVIEW_MAX_SUBIFDS 8
+#define DT_PREVIEW_MAX_MARKERS 64
+
+typedef struct _tiff_t
+{
+  FILE *f;
+  int64_t size;
+  int big_endian;
+  int ifds; // number of ifds visited so far
+} _tiff_t;
+
+typedef struct _preview_t
+{
+  uint32_t offset, length;
+  int width, height;
+} _preview_t;
+
+static inline uint16_t _get16(const _tiff_t *t, const uint8_t *p)
+{
+  return t->big_endian ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0];
+}
+
+static inline uint32_t _get32(const _tiff_t *t, const uint8_t *p)
+{
+  return t->big_endian ? ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]
+                       : ((uint32_t)p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+static int _read(_tiff_t *t, const int64_t offset, void *buf, const size_t len)
+{
+  if(offset < 0 || offset + (int64_t)len > t->size) return 1;
+  if(fseek(t->f, offset, SEEK_SET)) return 1;
+  return fread(buf, 1, len, t->f) != len;
+}
+
+// read the frame header of the jpeg at offset. only baseline, extended and progressive
+// huffman coded frames are previews, the raw data itself is stored as lossless jpeg in cr2 and dng.
+static int _jpeg_dimensions(_tiff_t *t, const uint32_t offset, const uint32_t length, int *width, int *height)
+{
+  uint8_t m[10];
+  const int64_t end = (int64_t)offset + length;
+  int64_t pos = offset;
+  if(_read(t, pos, m, 2) || m[0] != 0xff || m[1] != 0xd8) return 1;
+  pos += 2;
+
+  // skip app segments (exif, icc, ..) until we hit the frame header
+  for(int k = 0; k < DT_PREVIEW_MAX_MARKERS && pos + 4 <= end; k++)
+  {
+    if(_read(t, pos, m, 4) || m[0] != 0xff) return 1;
+    const uint8_t marker = m[1];
+    if(marker == 0xff)
+    {
+      // fill byte
+      pos++;
+      continue;
+    }
+    if(marker == 0xd9 || marker == 0xda) return 1;
+    if(marker == 0xc0 || marker == 0xc1 || marker == 0xc2)
+    {
+      if(_read(t, pos + 4, m, 6)) return 1;
+      *height = (m[1] << 8) | m[2];
+      *width = (m[3] << 8) | m[4];
+      return *width <= 0 || *height <= 0 || m[5] != 3;
+    }
+    if(marker >= 0xc3 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) return 1;
+    pos += 2 + ((m[2] << 8) | m[3]);
+  }
+  return 1;
+}
+
+static void _add_preview(_tiff_t *t, const uint32_t offset, const uint32_t length, GArray *previews)
+{
+  if(length < 4 || (int64_t)offset + length > t->size) return;
+  _preview_t p = { offset, length, 0, 0 };
+  if(_jpeg_dimensions(t, offset, length, &p.width, &p.height)) return;
+  g_array_append_val(previews, p);
+}
+
+static void _scan_ifd(_tiff_t *t, uint32_t offset, const int depth, GArray *previews)
+{
+  while(offset && t->ifds++ < DT_PREVIEW_MAX_IFDS)
+  {
+    uint8_t c[2];
+    if(_read(t, offset, c, 2)) return;
+    const int count = _get16(t, c);
+    if(count == 0 || count > DT_PREVIEW_MAX_ENTRIES) return;
+
+    // all entries plus the offset of the next ifd
+    uint8_t *entries = (uint8_t *)malloc((size_t)12 * count + 4);
+    if(!entries) return;
+    if(_read(t, (int64_t)offset + 2, entries, (size_t)12 * count + 4))
+    {
+      free(entries);
+      return;
+    }
+
+    uint32_t compression = 0, strips = 0, strip_offset = 0, strip_length = 0, jpeg_offset = 0, jpeg_length = 0;
+    uint32_t subifds[DT_PREVIEW_MAX_SUBIFDS];
+    int num_subifds = 0;
+    for(int i = 0; i < count; i++)
+    {
+      const uint8_t *e = entries + 12 * i;
+      const uint16_t tag = _get16(t, e);
+      const uint16_t type = _get16(t, e + 2);
+      const uint32_t n = _get32(t, e + 4);
+      // short values are left aligned in the value field for both byte orders
+      const uint32_t value = (type == 3) ? _get16(t, e + 8) : _get32(t, e + 8);
+      switch(tag)
+      {
+        case 0x103: // Compression
+          compression = value;
+          break;
+        case 0x111: // StripOffsets
+          strips = n;
+          strip_offset = value;
+          break;
+        case 0x117: // StripByteCounts
+          strip_length = value;
+          break;
+        case 0x201: // JPEGInterchangeFormat
+          jpeg_offset = value;
+          break;
+        case 0x202: // JPEGInterchangeFormatLength
+          jpeg_length = value;
+          break;
+        case 0x14a: // SubIFDs, stored inline if there is only one
+          if(depth >= 2 || num_subifds > 0 || (type != 4 && type != 13)) break;
+          if(n == 1)
+            subifds[num_subifds++] = value;
+          else
+          {
+            uint8_t buf[4 * DT_PREVIEW_MAX_SUBIFDS];
+            const int m = MIN(n, DT_PREVIEW_MAX_SUBIFDS);
+            if(!_read(t, value, buf, 4 * m))
+              for(int k = 0; k < m; k++) subifds[num_subifds++] = _get32(t, buf + 4 * k);
+          }
+          break;
+        default:
+          break;
+      }
+    }
+    const uint32_t next = _get32(t, entries + 12 * count);
+    free(entries);
+
+    if(jpeg_offset && jpeg_length) _add_preview(t, jpeg_offset, jpeg_length, previews);
+    // old style jpeg (6) and jpeg (7) compressed ifds with a single strip
+    if(strips == 1 && (compression == 6 || compression == 7) && strip_offset && strip_length)
+      _add_preview(t, strip_offset, strip_length, previews);
+
+    for(int k = 0; k < num_subifds; k++) _scan_ifd(t, subifds[k], depth + 1, previews);
+
+    // only the main chain is followed
+    if(depth > 0 || next == offset) return;
+    offset = next;
+  }
+}
+
+int dt_imageio_preview_read(const char *filename, const int width, const int height, uint8_t **buffer,
+                            size_t *size)
+{
+  _tiff_t t = { 0 };
+  t.f = g_fopen(filename, "rb");
+  if(!t.f) return 1;
+
+  int res = 1;
+  GArray *previews = g_array_new(FALSE, FALSE, sizeof(_preview_t));
+
+  uint8_t h[8];
+  if(fseek(t.f, 0, SEEK_END)) goto end;
+  t.size = ftell(t.f);
+  if(t.size < 8) goto end;
+  if(fseek(t.f, 0, SEEK_SET) || fread(h, 1, 8, t.f) != 8) goto end;
+  if(h[0] == 'I' && h[1] == 'I')
+    t.big_endian = 0;
+  else if(h[0] == 'M' && h[1] == 'M')
+    t.big_endian = 1;
+  else
+    goto end;
+  // plain tiff, and the olympus flavours of it
+  const uint16_t magic = _get16(&t, h + 2);
+  if(magic != 42 && magic != 0x4f52 && magic != 0x5352) goto end;
+
+  _scan_ifd(&t, _get32(&t, h + 4), 0, previews);
+  if(previews->len == 0) goto end;
+
+  // the smallest one that's large enough, or the largest we have
+  int best = -1, best_large = -1;
+  int64_t best_area = 0, best_large_area = 0;
+  for(int k = 0; k < (int)previews->len; k++)
+  {
+    const _preview_t *p = &g_array_index(previews, _preview_t, k);
+    const int64_t area = (int64_t)p->width * p->height;
+    if((p->width >= width || p->height >= height) && (best_large < 0 || area < best_large_area))
+    {
+      best_large = k;
+      best_large_area = area;
+    }
+    if(best < 0 || area > best_area)
+    {
+      best = k;
+      best_area = area;
+    }
+  }
+  if(best_large >= 0) best = best_large;
+
+  const _preview_t *p = &g_array_index(previews, _preview_t, best);
+  *buffer = (uint8_t *)malloc(p->length);
+  if(!*buffer) goto end;
+  if(_read(&t, p->offset, *buffer, p->length))
+  {
+    free(*buffer);
+    *buffer = NULL;
+    goto end;
+  }
+  *size = p->length;
+  res = 0;
+
+end:
+  g_array_free(previews, TRUE);
+  fclose(t.f);
+  return res;
+}
+
+int dt_imageio_preview_load(const char *filename, const int width, const int height, uint8_t **buffer,
+                            int32_t *out_width, int32_t *out_height)
+{
+  uint8_t *data = NULL;
+  size_t length = 0;
+  if(dt_imageio_preview_read(filename, width, height, &data, &length)) return 1;
+
+  int res = 1;
+  dt_imageio_jpeg_t jpg;
+  if(dt_imageio_jpeg_decompress_header(data, length, &jpg)) goto end;
+  dt_imageio_jpeg_scale_to_fit(&jpg, width, height);
+
+  *buffer = (uint8_t *)malloc((size_t)sizeof(uint8_t) * jpg.width * jpg.height * 4);
+  if(!*buffer)
+  {
+    jpeg_destroy_decompress(&(jpg.dinfo));
+    goto end;
+  }
+  if(dt_imageio_jpeg_decompress(&jpg, *buffer))
+  {
+    free(*buffer);
+    *buffer = NULL;
+    goto end;
+  }
+  *out_width = jpg.width;
+  *out_height = jpg.height;
+  res = 0;
+
+end:
+  free(data);
+  return res;
+}
+
+#undef DT_PREVIEW_MAX_IFDS
+#undef DT_PREVIEW_MAX_ENTRIES
+#undef DT_PREVIEW_MAX_SUBIFDS
+#undef DT_PREVIEW_MAX_MARKERS
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
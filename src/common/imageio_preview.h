@@ -0,0 +1,39 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2016 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DT_IMAGEIO_PREVIEW_H
+#define DT_IMAGEIO_PREVIEW_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/** find the jpeg previews embedded in a tiff based raw (cr2, nef, arw, dng, pef, ..) by walking the ifds only,
+ * without parsing the rest of the metadata. picks the smallest preview which doesn't need upscaling to fit
+ * into width x height (or the largest one, if none does) and returns its bytes in buffer, to be freed by the
+ * caller. width and height are in the orientation of the stored preview. returns 0 on success. */
+int dt_imageio_preview_read(const char *filename, const int width, const int height, uint8_t **buffer,
+                            size_t *size);
+
+/** same, but also decode the preview to 8-bit rgba, using the jpeg decoder's dct scaling to get as close to
+ * width x height as possible. the result still has to be fitted (and flipped) by the caller. */
+int dt_imageio_preview_load(const char *filename, const int width, const int height, uint8_t **buffer,
+                            int32_t *out_width, int32_t *out_height);
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
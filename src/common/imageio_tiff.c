@@ -29,6 +29,7 @@
 #include <tiffio.h>
 #include <inttypes.h>
 #include <strings.h>
+#include <zlib.h>
 
 typedef struct tiff_t
 {
@@ -249,6 +250,98 @@ int dt_imageio_tiff_read_profile(const char *filename, uint8_t **out)
   return profile_len;
 }
 
+// the same as libtiff's horizontal differencing (predictor 2) and floating point predictor (3), applied to one
+// row of samples in host byte order. tmp has to hold one row.
+static void _predict_row(uint8_t *row, const size_t rowsize, const int bps, const int spp, const int predictor,
+                         uint8_t *tmp)
+{
+  if(predictor == 2)
+  {
+    if(bps == 32)
+    {
+      uint32_t *p = (uint32_t *)row;
+      for(size_t k = rowsize / 4 - 1; k >= (size_t)spp; k--) p[k] -= p[k - spp];
+    }
+    else if(bps == 16)
+    {
+      uint16_t *p = (uint16_t *)row;
+      for(size_t k = rowsize / 2 - 1; k >= (size_t)spp; k--) p[k] -= p[k - spp];
+    }
+    else
+    {
+      for(size_t k = rowsize - 1; k >= (size_t)spp; k--) row[k] -= row[k - spp];
+    }
+  }
+  else if(predictor == 3)
+  {
+    // split the samples into byte planes, most significant first, then difference the bytes
+    const size_t bytes = bps / 8, wc = rowsize / bytes;
+    memcpy(tmp, row, rowsize);
+    for(size_t c = 0; c < wc; c++)
+      for(size_t b = 0; b < bytes; b++)
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+        row[(bytes - 1 - b) * wc + c] = tmp[bytes * c + b];
+#else
+        row[b * wc + c] = tmp[bytes * c + b];
+#endif
+    for(size_t k = rowsize - 1; k >= (size_t)spp; k--) row[k] -= row[k - spp];
+  }
+}
+
+int dt_imageio_tiff_write_chunks(TIFF *tif, const int tiled, const int nchunks, const size_t rowsize,
+                                 const int rows, const int bps, const int spp, const int predictor,
+                                 const int deflate, dt_imageio_tiff_fill_t fill, void *data)
+{
+  const size_t chunksize = rowsize * rows;
+  const size_t bound = deflate ? compressBound(chunksize) : 0;
+  // one chunk per thread at a time, that's all the memory we need
+  const int batch = MAX(1, MIN(dt_get_num_threads(), nchunks));
+
+  uint8_t *raw = dt_alloc_align(64, chunksize * batch);
+  uint8_t *packed = deflate ? dt_alloc_align(64, bound * batch) : NULL;
+  uint8_t *tmp = predictor == 3 ? malloc(rowsize * batch) : NULL;
+  size_t *length = malloc(sizeof(size_t) * batch);
+
+  int err = !raw || !length || (deflate && !packed) || (predictor == 3 && !tmp);
+
+  for(int c0 = 0; c0 < nchunks && !err; c0 += batch)
+  {
+    const int n = MIN(batch, nchunks - c0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for(int k = 0; k < n; k++)
+    {
+      uint8_t *chunk = raw + k * chunksize;
+      const int filled = fill(data, c0 + k, chunk);
+      if(predictor > 1)
+        for(int y = 0; y < filled; y++)
+          _predict_row(chunk + y * rowsize, rowsize, bps, spp, predictor, tmp + k * rowsize);
+      length[k] = filled * rowsize;
+      if(deflate)
+      {
+        uLongf len = bound;
+        if(compress2(packed + k * bound, &len, chunk, length[k], Z_BEST_COMPRESSION) != Z_OK) len = 0;
+        length[k] = len;
+      }
+    }
+
+    for(int k = 0; k < n && !err; k++)
+    {
+      uint8_t *buf = deflate ? packed + k * bound : raw + k * chunksize;
+      const tmsize_t written = tiled ? TIFFWriteRawTile(tif, c0 + k, buf, length[k])
+                                     : TIFFWriteRawStrip(tif, c0 + k, buf, length[k]);
+      if(length[k] == 0 || written == -1) err = 1;
+    }
+  }
+
+  free(length);
+  free(tmp);
+  dt_free_align(packed);
+  dt_free_align(raw);
+  return err;
+}
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
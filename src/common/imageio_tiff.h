@@ -21,10 +21,24 @@
 #include "common/image.h"
 #include "common/mipmap_cache.h"
 
+#include <tiffio.h>
+
 dt_imageio_retval_t dt_imageio_open_tiff(dt_image_t *img, const char *filename, dt_mipmap_buffer_t *buf);
 
 int dt_imageio_tiff_read_profile(const char *filename, uint8_t **out);
 
+/** fills strip or tile number chunk of a tiff which is being written, as rows of uncompressed samples in host
+ * byte order. returns the number of rows, which is less than the full size only for the last strip. */
+typedef int (*dt_imageio_tiff_fill_t)(void *data, const int chunk, uint8_t *buf);
+
+/** fill, predict (1: none, 2: horizontal differencing, 3: floating point) and optionally deflate the nchunks
+ * strips or tiles of tif on all threads, and write them in order as raw data. chunks have rows rows of
+ * rowsize bytes each, with spp samples of bps bits per pixel. the file has to be in host byte order, and its
+ * compression and predictor tags have to match. returns 0 on success. */
+int dt_imageio_tiff_write_chunks(TIFF *tif, const int tiled, const int nchunks, const size_t rowsize,
+                                 const int rows, const int bps, const int spp, const int predictor,
+                                 const int deflate, dt_imageio_tiff_fill_t fill, void *data);
+
 #endif
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
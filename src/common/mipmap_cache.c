@@ -23,6 +23,7 @@
 #include "common/imageio.h"
 #include "common/imageio_module.h"
 #include "common/imageio_jpeg.h"
+#include "common/imageio_preview.h"
 #include "common/mipmap_cache.h"
 #include "control/conf.h"
 #include "control/jobs.h"
@@ -380,6 +381,112 @@ static uint32_t nearest_power_of_two(const uint32_t value)
   return rc;
 }
 
+// as many as the job queue would keep around
+#define DT_MIPMAP_PREFETCH_MAX_PENDING 30
+
+typedef struct _prefetch_t
+{
+  uint32_t imgid;
+  dt_mipmap_size_t mip;
+  uint32_t seq;
+  int ahead;    // speculative, see DT_MIPMAP_PREFETCH_AHEAD
+  uint32_t gen; // prefetch_ahead_gen at the time of the request
+} _prefetch_t;
+
+static gint _prefetch_sort(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const _prefetch_t *pa = (const _prefetch_t *)a;
+  const _prefetch_t *pb = (const _prefetch_t *)b;
+  // speculative ones only when nothing else is waiting, and in the order they were asked for, nearest first.
+  if(pa->ahead != pb->ahead) return pa->ahead - pb->ahead;
+  if(pa->ahead) return (pa->seq > pb->seq) - (pa->seq < pb->seq);
+  // newest first, that's what's on screen right now
+  return (pa->seq < pb->seq) - (pa->seq > pb->seq);
+}
+
+static void _prefetch_run(gpointer data, gpointer user_data)
+{
+  dt_mipmap_cache_t *cache = (dt_mipmap_cache_t *)user_data;
+  _prefetch_t *p = (_prefetch_t *)data;
+  const uint32_t key = get_key(p->imgid, p->mip);
+
+  // only serve the latest request for a buffer, and drop the ones which got pushed out by newer requests
+  // in the meantime, like the job queue does.
+  // speculative requests aren't tracked there, they are only dropped as a whole when they went stale.
+  g_mutex_lock(&cache->prefetch_mutex);
+  int run = !cache->prefetch_stop;
+  if(p->ahead)
+    run = run && p->gen == cache->prefetch_ahead_gen;
+  else
+  {
+    const uint32_t latest
+        = GPOINTER_TO_UINT(g_hash_table_lookup(cache->prefetch_pending, GUINT_TO_POINTER(key)));
+    run = run && latest == p->seq && cache->prefetch_seq - p->seq < DT_MIPMAP_PREFETCH_MAX_PENDING;
+    if(latest == p->seq) g_hash_table_remove(cache->prefetch_pending, GUINT_TO_POINTER(key));
+  }
+  g_mutex_unlock(&cache->prefetch_mutex);
+
+  if(run)
+  {
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_get(cache, &buf, p->imgid, p->mip, DT_MIPMAP_BLOCKING, 'r');
+    // drop read lock, as this is only speculative async loading.
+    dt_mipmap_cache_release(cache, &buf);
+  }
+  free(p);
+}
+
+static void _prefetch(dt_mipmap_cache_t *cache, const uint32_t imgid, const dt_mipmap_size_t mip, const int ahead)
+{
+  if(mip >= DT_MIPMAP_F)
+  {
+    // full buffers are far too expensive to be loaded on speculation
+    if(!ahead)
+      dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
+    return;
+  }
+
+  _prefetch_t *p = (_prefetch_t *)malloc(sizeof(_prefetch_t));
+  if(!p) return;
+  p->imgid = imgid;
+  p->mip = mip;
+  p->ahead = ahead;
+
+  g_mutex_lock(&cache->prefetch_mutex);
+  if(!cache->prefetch_pool || cache->prefetch_stop)
+  {
+    g_mutex_unlock(&cache->prefetch_mutex);
+    free(p);
+    return;
+  }
+  p->seq = ++cache->prefetch_seq;
+  p->gen = cache->prefetch_ahead_gen;
+  // a speculative request must not take over a regular one for the same buffer, which would drop the latter
+  if(!ahead)
+    g_hash_table_insert(cache->prefetch_pending, GUINT_TO_POINTER(get_key(imgid, mip)), GUINT_TO_POINTER(p->seq));
+  g_thread_pool_push(cache->prefetch_pool, p, NULL);
+  g_mutex_unlock(&cache->prefetch_mutex);
+}
+
+void dt_mipmap_cache_prefetch_cancel_ahead(dt_mipmap_cache_t *cache)
+{
+  g_mutex_lock(&cache->prefetch_mutex);
+  cache->prefetch_ahead_gen++;
+  g_mutex_unlock(&cache->prefetch_mutex);
+}
+
+void dt_mipmap_cache_prefetch_shutdown(dt_mipmap_cache_t *cache)
+{
+  g_mutex_lock(&cache->prefetch_mutex);
+  GThreadPool *pool = cache->prefetch_pool;
+  cache->prefetch_pool = NULL;
+  cache->prefetch_stop = 1;
+  g_mutex_unlock(&cache->prefetch_mutex);
+
+  // queued requests see the stop flag and only free themselves
+  if(pool) g_thread_pool_free(pool, FALSE, TRUE);
+}
+
 void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
 {
   dt_mipmap_cache_get_filename(cache->cachedir, sizeof(cache->cachedir));
@@ -457,10 +564,21 @@ void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
   cache->buffer_size[DT_MIPMAP_F] = sizeof(struct dt_mipmap_buffer_dsc)
                                         + 4 * sizeof(float) * cache->max_width[DT_MIPMAP_F]
                                           * cache->max_height[DT_MIPMAP_F];
+
+  g_mutex_init(&cache->prefetch_mutex);
+  cache->prefetch_pending = g_hash_table_new(NULL, NULL);
+  cache->prefetch_seq = 0;
+  cache->prefetch_stop = 0;
+  cache->prefetch_ahead_gen = 0;
+  cache->prefetch_pool = g_thread_pool_new(_prefetch_run, cache, parallel, FALSE, NULL);
+  if(cache->prefetch_pool) g_thread_pool_set_sort_function(cache->prefetch_pool, _prefetch_sort, NULL);
 }
 
 void dt_mipmap_cache_cleanup(dt_mipmap_cache_t *cache)
 {
+  dt_mipmap_cache_prefetch_shutdown(cache);
+  g_hash_table_destroy(cache->prefetch_pending);
+  g_mutex_clear(&cache->prefetch_mutex);
   dt_cache_cleanup(&cache->mip_thumbs.cache);
   dt_cache_cleanup(&cache->mip_full.cache);
   dt_cache_cleanup(&cache->mip_f.cache);
@@ -572,7 +690,7 @@ void dt_mipmap_cache_get_with_caller(
     // and opposite: prefetch without locking
     if(mip > DT_MIPMAP_FULL || (int)mip < DT_MIPMAP_0)
       return; // remove the (int) once we no longer have to support gcc < 4.8 :/
-    dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
+    _prefetch(cache, imgid, mip, 0);
   }
   else if(flags == DT_MIPMAP_PREFETCH_DISK)
   {
@@ -584,7 +702,12 @@ void dt_mipmap_cache_get_with_caller(
     if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return;
     if(mip > DT_MIPMAP_FULL || (int)mip < DT_MIPMAP_0)
       return; // remove the (int) once we no longer have to support gcc < 4.8 :/
-    dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
+    _prefetch(cache, imgid, mip, 0);
+  }
+  else if(flags == DT_MIPMAP_PREFETCH_AHEAD)
+  {
+    if(mip > DT_MIPMAP_FULL || (int)mip < DT_MIPMAP_0) return;
+    _prefetch(cache, imgid, mip, 1);
   }
   else if(flags == DT_MIPMAP_BLOCKING)
   {
@@ -792,6 +915,15 @@ void dt_mipmap_cache_remove(dt_mipmap_cache_t *cache, const uint32_t imgid)
   }
 }
 
+void dt_mipmap_cache_remove_all(dt_mipmap_cache_t *cache, const uint32_t imgid)
+{
+  dt_mipmap_cache_remove(cache, imgid);
+
+  // the float and full buffers are never written to disk, just drop them:
+  dt_cache_remove(&_get_cache(cache, DT_MIPMAP_F)->cache, get_key(imgid, DT_MIPMAP_F));
+  dt_cache_remove(&_get_cache(cache, DT_MIPMAP_FULL)->cache, get_key(imgid, DT_MIPMAP_FULL));
+}
+
 static void _init_f(float *out, uint32_t *width, uint32_t *height, const uint32_t imgid)
 {
   const uint32_t wd = *width, ht = *height;
@@ -946,6 +1078,11 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, const uint3
       dt_imageio_jpeg_t jpg;
       if(!dt_imageio_jpeg_read_header(filename, &jpg))
       {
+        // let libjpeg do most of the downscaling
+        if(orientation & ORIENTATION_SWAP_XY)
+          dt_imageio_jpeg_scale_to_fit(&jpg, ht, wd);
+        else
+          dt_imageio_jpeg_scale_to_fit(&jpg, wd, ht);
         uint8_t *tmp = (uint8_t *)malloc(sizeof(uint8_t) * jpg.width * jpg.height * 4);
         if(!dt_imageio_jpeg_read(&jpg, tmp))
         {
@@ -960,7 +1097,13 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, const uint3
     {
       uint8_t *tmp = 0;
       int32_t thumb_width, thumb_height;
-      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height);
+      // walk the tiff structure for a preview of about the right size, and decode it already scaled down.
+      // only if that fails go through exiv2, which parses all the metadata first.
+      if(orientation & ORIENTATION_SWAP_XY)
+        res = dt_imageio_preview_load(filename, ht, wd, &tmp, &thumb_width, &thumb_height);
+      else
+        res = dt_imageio_preview_load(filename, wd, ht, &tmp, &thumb_width, &thumb_height);
+      if(res) res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height);
       if(!res)
       {
         // scale to fit
@@ -56,7 +56,11 @@ typedef enum dt_mipmap_get_flags_t
   DT_MIPMAP_BLOCKING = 3,
   // don't actually acquire the lock if it is not
   // in cache (i.e. would have to be loaded first)
-  DT_MIPMAP_TESTLOCK = 4
+  DT_MIPMAP_TESTLOCK = 4,
+  // speculative prefetch: only runs when no other prefetch
+  // is waiting, and is dropped again by
+  // dt_mipmap_cache_prefetch_cancel_ahead()
+  DT_MIPMAP_PREFETCH_AHEAD = 5
 } dt_mipmap_get_flags_t;
 
 // struct to be alloc'ed by the client, filled by dt_mipmap_cache_get()
@@ -97,6 +101,14 @@ typedef struct dt_mipmap_cache_t
   dt_mipmap_cache_one_t mip_f;
   dt_mipmap_cache_one_t mip_full;
   char cachedir[PATH_MAX]; // cached sha1sum filename for faster access
+
+  // thumbnails are prefetched on their own threads, so they don't compete with the job queues
+  GThreadPool *prefetch_pool;
+  GHashTable *prefetch_pending; // key -> sequence number of the latest request for it
+  GMutex prefetch_mutex;
+  uint32_t prefetch_seq;
+  uint32_t prefetch_ahead_gen; // bumped to drop all queued DT_MIPMAP_PREFETCH_AHEAD requests
+  int prefetch_stop;
 } dt_mipmap_cache_t;
 
 // dynamic memory allocation interface for imageio backend: a write locked
@@ -106,6 +118,10 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img);
 
 void dt_mipmap_cache_init(dt_mipmap_cache_t *cache);
 void dt_mipmap_cache_cleanup(dt_mipmap_cache_t *cache);
+// wait for the prefetch threads and drop what's still queued. has to happen while the image cache is still around.
+void dt_mipmap_cache_prefetch_shutdown(dt_mipmap_cache_t *cache);
+// drop the DT_MIPMAP_PREFETCH_AHEAD requests which didn't start yet, the view is going elsewhere.
+void dt_mipmap_cache_prefetch_cancel_ahead(dt_mipmap_cache_t *cache);
 void dt_mipmap_cache_print(dt_mipmap_cache_t *cache);
 
 // get a buffer and lock according to mode ('r' or 'w').
@@ -137,6 +153,8 @@ void dt_mipmap_cache_release(dt_mipmap_cache_t *cache, dt_mipmap_buffer_t *buf);
 
 // remove thumbnails, so they will be regenerated:
 void dt_mipmap_cache_remove(dt_mipmap_cache_t *cache, const uint32_t imgid);
+// also drop the float and full buffers, for when the image file itself changed:
+void dt_mipmap_cache_remove_all(dt_mipmap_cache_t *cache, const uint32_t imgid);
 
 // return the closest mipmap size
 // for the given window you wish to draw.
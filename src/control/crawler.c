@@ -21,13 +21,16 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <sqlite3.h>
+#include <sys/stat.h>
 
 #include "crawler.h"
 #include "common/darktable.h"
 #include "common/database.h"
 #include "common/history.h"
 #include "common/image.h"
+#include "common/image_cache.h"
 #include "control/conf.h"
+#include "control/jobs.h"
 #include "gui/gtk.h"
 
 
@@ -51,132 +54,259 @@ typedef struct dt_control_crawler_result_t
 } dt_control_crawler_result_t;
 
 
-GList *dt_control_crawler_run()
+typedef struct dt_control_crawler_image_t
 {
-  sqlite3_stmt *stmt, *inner_stmt;
-  GList *result = NULL;
-  gboolean look_for_xmp = dt_conf_get_bool("write_sidecar_files");
+  int id, version, flags, new_flags;
+  time_t timestamp_db, timestamp_xmp;
+  char *filename;
+} dt_control_crawler_image_t;
+
+// all images of one film roll, crawled in one go
+typedef struct dt_control_crawler_folder_t
+{
+  int film_id;
+  char *folder;
+  time_t crawler_mtime, mtime;
+  gboolean changed;
+  GArray *images;
+} dt_control_crawler_folder_t;
+
+static void _crawler_folder_free(gpointer data)
+{
+  dt_control_crawler_folder_t *f = (dt_control_crawler_folder_t *)data;
+  for(guint i = 0; i < f->images->len; i++)
+    g_free(g_array_index(f->images, dt_control_crawler_image_t, i).filename);
+  g_array_free(f->images, TRUE);
+  g_free(f->folder);
+  free(f);
+}
+
+// get all images grouped by their film roll. this is the only place the db is read.
+static GPtrArray *_crawler_get_folders()
+{
+  sqlite3_stmt *stmt;
+  GPtrArray *folders = g_ptr_array_new_with_free_func(_crawler_folder_free);
+  dt_control_crawler_folder_t *f = NULL;
 
   sqlite3_prepare_v2(dt_database_get(darktable.db),
-                     "SELECT images.id, write_timestamp, version, folder || '/' || filename, flags "
-                     "FROM images, film_rolls WHERE images.film_id = film_rolls.id "
+                     "SELECT film_rolls.id, folder, crawler_mtime, images.id, write_timestamp, version, "
+                     "filename, flags FROM images, film_rolls WHERE images.film_id = film_rolls.id "
                      "ORDER BY film_rolls.id, filename",
                      -1, &stmt, NULL);
-  sqlite3_prepare_v2(dt_database_get(darktable.db), "UPDATE images SET flags = ?1 WHERE id = ?2", -1,
-                     &inner_stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int film_id = sqlite3_column_int(stmt, 0);
+    if(!f || f->film_id != film_id)
+    {
+      f = (dt_control_crawler_folder_t *)calloc(1, sizeof(dt_control_crawler_folder_t));
+      f->film_id = film_id;
+      f->folder = g_strdup((const char *)sqlite3_column_text(stmt, 1));
+      f->crawler_mtime = sqlite3_column_int64(stmt, 2);
+      f->images = g_array_new(FALSE, TRUE, sizeof(dt_control_crawler_image_t));
+      g_ptr_array_add(folders, f);
+    }
 
-  // let's wrap this into a transaction, it might make it a little faster.
-  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+    dt_control_crawler_image_t image = { 0 };
+    image.id = sqlite3_column_int(stmt, 3);
+    image.timestamp_db = sqlite3_column_int(stmt, 4);
+    image.version = sqlite3_column_int(stmt, 5);
+    image.filename = g_strdup((const char *)sqlite3_column_text(stmt, 6));
+    image.flags = image.new_flags = sqlite3_column_int(stmt, 7);
+    g_array_append_val(f->images, image);
+  }
+  sqlite3_finalize(stmt);
 
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  return folders;
+}
+
+// look at one folder. this only touches the filesystem, so it's safe to run for many folders at once.
+static void _crawler_crawl_folder(dt_control_crawler_folder_t *f, const gboolean look_for_xmp)
+{
+  struct stat statbuf;
+  if(!f->folder || stat(f->folder, &statbuf) == -1) return; // TODO: shall we report missing folders?
+  f->mtime = statbuf.st_mtime;
+
+  // the folder's mtime only changes when files get added or removed. so if it's the same as last time we
+  // already know which .txt and .wav files are there and only have to check the xmp timestamps, since those
+  // files are often rewritten in place.
+  f->changed = (f->mtime != f->crawler_mtime);
+
+  GHashTable *entries = NULL;
+  if(f->changed)
   {
-    const int id = sqlite3_column_int(stmt, 0);
-    const time_t timestamp = sqlite3_column_int(stmt, 1);
-    const int version = sqlite3_column_int(stmt, 2);
-    gchar *image_path = (gchar *)sqlite3_column_text(stmt, 3);
-    int flags = sqlite3_column_int(stmt, 4);
+    GDir *dir = g_dir_open(f->folder, 0, NULL);
+    if(!dir)
+    {
+      f->changed = FALSE;
+      return;
+    }
+    entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    const gchar *name;
+    while((name = g_dir_read_name(dir)) != NULL) g_hash_table_add(entries, g_strdup(name));
+    g_dir_close(dir);
+  }
+
+  for(guint i = 0; i < f->images->len; i++)
+  {
+    dt_control_crawler_image_t *image = &g_array_index(f->images, dt_control_crawler_image_t, i);
+    if(!image->filename) continue;
 
     // no need to look for xmp files if none get written anyway.
     if(look_for_xmp)
     {
       // construct the xmp filename for this image
-      gchar xmp_path[PATH_MAX] = { 0 };
-      g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
-      dt_image_path_append_version_no_db(version, xmp_path, sizeof(xmp_path));
-      size_t len = strlen(xmp_path);
-      if(len + 4 >= PATH_MAX) continue;
-      xmp_path[len++] = '.';
-      xmp_path[len++] = 'x';
-      xmp_path[len++] = 'm';
-      xmp_path[len++] = 'p';
-      xmp_path[len] = '\0';
-
-      struct stat statbuf;
-      if(stat(xmp_path, &statbuf) == -1) continue; // TODO: shall we report these?
-
-      // step 1: check if the xmp is newer than our db entry
-      // FIXME: allow for a few seconds difference?
-      if(timestamp < statbuf.st_mtime)
+      gchar xmp_name[PATH_MAX] = { 0 };
+      g_strlcpy(xmp_name, image->filename, sizeof(xmp_name));
+      dt_image_path_append_version_no_db(image->version, xmp_name, sizeof(xmp_name));
+      g_strlcat(xmp_name, ".xmp", sizeof(xmp_name));
+
+      // when we listed the folder anyway there is no need to stat files that aren't there
+      if(!entries || g_hash_table_contains(entries, xmp_name))
       {
-        dt_control_crawler_result_t *item
-            = (dt_control_crawler_result_t *)malloc(sizeof(dt_control_crawler_result_t));
-        item->id = id;
-        item->timestamp_xmp = statbuf.st_mtime;
-        item->timestamp_db = timestamp;
-        item->image_path = g_strdup(image_path);
-        item->xmp_path = g_strdup(xmp_path);
-
-        result = g_list_append(result, item);
-        dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a newer xmp file.\n", xmp_path, id);
+        gchar *xmp_path = g_build_filename(f->folder, xmp_name, NULL);
+        // check if the xmp is newer than our db entry
+        // FIXME: allow for a few seconds difference?
+        if(stat(xmp_path, &statbuf) == 0 && image->timestamp_db < statbuf.st_mtime)
+          image->timestamp_xmp = statbuf.st_mtime;
+        // older timestamps are the case for all images after the db upgrade. better not report these
+        g_free(xmp_path);
       }
-      // older timestamps are the case for all images after the db upgrade. better not report these
-      //       else if(timestamp > statbuf.st_mtime)
-      //         printf("`%s' (%d) has an older xmp file.\n", image_path, id);
     }
 
-    // step 2: check if the image has associated files (.txt, .wav)
-    size_t len = strlen(image_path);
-    char *c = image_path + len;
-    while((c > image_path) && (*c != '.')) *c-- = '\0';
-    len = c - image_path + 1;
+    // check if the image has associated files (.txt, .wav)
+    if(entries)
+    {
+      const char *c = strrchr(image->filename, '.');
+      const size_t len = c ? c - image->filename + 1 : strlen(image->filename);
+      gchar *extra_name = g_strdup_printf("%.*s%s", (int)len, image->filename, c ? "txt" : ".txt");
+      const size_t ext = strlen(extra_name) - 3;
 
-    char *extra_path = g_strndup(image_path, len + 3);
+      gboolean has_txt = g_hash_table_contains(entries, extra_name);
+      if(!has_txt)
+      {
+        memcpy(extra_name + ext, "TXT", 3);
+        has_txt = g_hash_table_contains(entries, extra_name);
+      }
 
-    extra_path[len] = 't';
-    extra_path[len + 1] = 'x';
-    extra_path[len + 2] = 't';
-    gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      memcpy(extra_name + ext, "wav", 3);
+      gboolean has_wav = g_hash_table_contains(entries, extra_name);
+      if(!has_wav)
+      {
+        memcpy(extra_name + ext, "WAV", 3);
+        has_wav = g_hash_table_contains(entries, extra_name);
+      }
 
-    if(!has_txt)
-    {
-      extra_path[len] = 'T';
-      extra_path[len + 1] = 'X';
-      extra_path[len + 2] = 'T';
-      has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      // TODO: decide if we want to remove the flag for images that lost their extra file. currently we do
+      // (the else cases)
+      if(has_txt)
+        image->new_flags |= DT_IMAGE_HAS_TXT;
+      else
+        image->new_flags &= ~DT_IMAGE_HAS_TXT;
+      if(has_wav)
+        image->new_flags |= DT_IMAGE_HAS_WAV;
+      else
+        image->new_flags &= ~DT_IMAGE_HAS_WAV;
+
+      g_free(extra_name);
     }
+  }
+
+  if(entries) g_hash_table_destroy(entries);
+}
+
+GList *dt_control_crawler_run()
+{
+  sqlite3_stmt *stmt;
+  GList *result = NULL;
+  gboolean look_for_xmp = dt_conf_get_bool("write_sidecar_files");
+
+  GPtrArray *folders = _crawler_get_folders();
+  dt_control_crawler_folder_t **folder = (dt_control_crawler_folder_t **)folders->pdata;
+  int nb_folders = folders->len;
 
-    extra_path[len] = 'w';
-    extra_path[len + 1] = 'a';
-    extra_path[len + 2] = 'v';
-    gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+  // on network storage this is bound by latency, so look at several folders at once
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) default(none) shared(folder, look_for_xmp, nb_folders)
+#endif
+  for(int k = 0; k < nb_folders; k++) _crawler_crawl_folder(folder[k], look_for_xmp);
 
-    if(!has_wav)
+  sqlite3_prepare_v2(dt_database_get(darktable.db), "UPDATE film_rolls SET crawler_mtime = ?1 WHERE id = ?2",
+                     -1, &stmt, NULL);
+
+  for(int k = 0; k < nb_folders; k++)
+  {
+    dt_control_crawler_folder_t *f = folder[k];
+
+    for(guint i = 0; i < f->images->len; i++)
     {
-      extra_path[len] = 'W';
-      extra_path[len + 1] = 'A';
-      extra_path[len + 2] = 'V';
-      has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      dt_control_crawler_image_t *image = &g_array_index(f->images, dt_control_crawler_image_t, i);
+
+      if(image->timestamp_xmp)
+      {
+        gchar xmp_name[PATH_MAX] = { 0 };
+        g_strlcpy(xmp_name, image->filename, sizeof(xmp_name));
+        dt_image_path_append_version_no_db(image->version, xmp_name, sizeof(xmp_name));
+        g_strlcat(xmp_name, ".xmp", sizeof(xmp_name));
+
+        dt_control_crawler_result_t *item
+            = (dt_control_crawler_result_t *)malloc(sizeof(dt_control_crawler_result_t));
+        item->id = image->id;
+        item->timestamp_xmp = image->timestamp_xmp;
+        item->timestamp_db = image->timestamp_db;
+        item->image_path = g_build_filename(f->folder, image->filename, NULL);
+        item->xmp_path = g_build_filename(f->folder, xmp_name, NULL);
+
+        result = g_list_prepend(result, item);
+        dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a newer xmp file.\n", item->xmp_path, item->id);
+      }
+
+      // we are running in the background, so go through the cache to not lose the change
+      if(image->flags != image->new_flags)
+      {
+        dt_image_t *img = dt_image_cache_get(darktable.image_cache, image->id, 'w');
+        if(img)
+        {
+          img->flags = (img->flags & ~(DT_IMAGE_HAS_TXT | DT_IMAGE_HAS_WAV))
+                       | (image->new_flags & (DT_IMAGE_HAS_TXT | DT_IMAGE_HAS_WAV));
+          dt_image_cache_write_release(darktable.image_cache, img, DT_IMAGE_CACHE_RELAXED);
+        }
+      }
     }
 
-    // TODO: decide if we want to remove the flag for images that lost their extra file. currently we do (the
-    // else cases)
-    int new_flags = flags;
-    if(has_txt)
-      new_flags |= DT_IMAGE_HAS_TXT;
-    else
-      new_flags &= ~DT_IMAGE_HAS_TXT;
-    if(has_wav)
-      new_flags |= DT_IMAGE_HAS_WAV;
-    else
-      new_flags &= ~DT_IMAGE_HAS_WAV;
-    if(flags != new_flags)
+    if(f->changed)
     {
-      sqlite3_bind_int(inner_stmt, 1, new_flags);
-      sqlite3_bind_int(inner_stmt, 2, id);
-      sqlite3_step(inner_stmt);
-      sqlite3_reset(inner_stmt);
-      sqlite3_clear_bindings(inner_stmt);
+      sqlite3_bind_int64(stmt, 1, f->mtime);
+      sqlite3_bind_int(stmt, 2, f->film_id);
+      sqlite3_step(stmt);
+      sqlite3_reset(stmt);
+      sqlite3_clear_bindings(stmt);
     }
-
-    g_free(extra_path);
   }
 
-  sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
-
   sqlite3_finalize(stmt);
-  sqlite3_finalize(inner_stmt);
+  g_ptr_array_free(folders, TRUE);
 
-  return result;
+  return g_list_reverse(result);
+}
+
+static gboolean _crawler_show_image_list_idle(gpointer user_data)
+{
+  dt_control_crawler_show_image_list((GList *)user_data);
+  return FALSE;
+}
+
+static int32_t _crawler_job_run(dt_job_t *job)
+{
+  GList *changed_xmp_files = dt_control_crawler_run();
+  // the popup has to be built from the gui thread
+  if(changed_xmp_files) g_idle_add(_crawler_show_image_list_idle, changed_xmp_files);
+  return 0;
+}
+
+void dt_control_crawler_run_job()
+{
+  dt_job_t *job = dt_control_job_create(&_crawler_job_run, "crawl xmp files");
+  if(job) dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
 }
 
 
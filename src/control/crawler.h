@@ -21,10 +21,11 @@
 
 #include <glib.h>
 
-/** this isn't a background job on purpose. it has to be really fast so it shouldn't
- *  require locking from image cache or anything like that.
- *  should we find out that we want to have a background job that crawls over all images
- *  we can maybe refactor this, but for now it's good the way it is.
+/** the crawler looks at one folder after the other (several of them in parallel) and lists each of them
+ *  only once instead of probing for every single file. the mtime of each folder is remembered in the db so
+ *  that unchanged folders don't have to be listed again on the next run.
+ *  it only reads the db at the start and changes image flags through the image cache, so it can be run
+ *  in the background.
  */
 
 // this function iterates over ALL images from the database and checks whether
@@ -34,6 +35,9 @@
 // it returns the list of images with a (supposedly) updated xmp file to let the user decide
 GList *dt_control_crawler_run();
 
+// run the crawler as a background job and show the popup once it's done
+void dt_control_crawler_run_job();
+
 // show a popup with the images, let the user decide what to do and free the list afterwards
 void dt_control_crawler_show_image_list(GList *images);
 
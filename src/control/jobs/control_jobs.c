@@ -187,8 +187,8 @@ static int32_t dt_control_write_sidecar_files_job_run(dt_job_t *job)
   GList *t = params->index;
   sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "UPDATE images SET write_timestamp = STRFTIME('%s', 'now') WHERE id = ?1", -1,
-                              &stmt, NULL);
+                              "UPDATE images SET write_timestamp = STRFTIME('%s', 'now'), xmp_hash = ?2 WHERE id = ?1",
+                              -1, &stmt, NULL);
   while(t)
   {
     gboolean from_cache = FALSE;
@@ -198,15 +198,19 @@ static int32_t dt_control_write_sidecar_files_job_run(dt_job_t *job)
     dt_image_full_path(img->id, dtfilename, sizeof(dtfilename), &from_cache);
     dt_image_path_append_version(img->id, dtfilename, sizeof(dtfilename));
     g_strlcat(dtfilename, ".xmp", sizeof(dtfilename));
-    if(!dt_exif_xmp_write(imgid, dtfilename))
+    // no old hash: this is an explicit request, always write
+    char *new_hash = NULL;
+    if(!dt_exif_xmp_write(imgid, dtfilename, NULL, &new_hash))
     {
-      // put the timestamp into db. this can't be done in exif.cc since that code gets called
-      // for the copy exporter, too
+      // put the timestamp and the hash of what we wrote into db. this can't be done in exif.cc since that code
+      // gets called for the copy exporter, too
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, new_hash, -1, SQLITE_STATIC);
       sqlite3_step(stmt);
       sqlite3_reset(stmt);
       sqlite3_clear_bindings(stmt);
     }
+    g_free(new_hash);
     dt_image_cache_read_release(darktable.image_cache, img);
     t = g_list_delete_link(t, t);
   }
@@ -233,27 +237,6 @@ typedef struct dt_control_merge_hdr_t
   gboolean abort;
 } dt_control_merge_hdr_t;
 
-typedef struct dt_control_merge_hdr_format_t
-{
-  dt_imageio_module_data_t parent;
-  dt_control_merge_hdr_t *d;
-} dt_control_merge_hdr_format_t;
-
-static int dt_control_merge_hdr_bpp(dt_imageio_module_data_t *data)
-{
-  return 32;
-}
-
-static int dt_control_merge_hdr_levels(dt_imageio_module_data_t *data)
-{
-  return IMAGEIO_RGB | IMAGEIO_FLOAT;
-}
-
-static const char *dt_control_merge_hdr_mime(dt_imageio_module_data_t *data)
-{
-  return "memory";
-}
-
 static float envelope(const float xx)
 {
   const float x = CLAMPS(xx, 0.0f, 1.0f);
@@ -274,39 +257,55 @@ static float envelope(const float xx)
   }
 }
 
-static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai, const char *filename,
-                                        const void *const ivoid, void *exif, int exif_len, int imgid, int num,
-                                        int total)
+// merge one frame of the bracket into d->pixels and d->weight. this reads the raw mosaic straight from the
+// full mipmap and does what rawprepare's defaults would do (crop, black and white point) on the fly, so no
+// pipe and no float copy of the frame are needed.
+static int dt_control_merge_hdr_process(dt_control_merge_hdr_t *d, const uint32_t imgid)
 {
-  dt_control_merge_hdr_format_t *data = (dt_control_merge_hdr_format_t *)datai;
-  dt_control_merge_hdr_t *d = data->d;
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
 
   // just take a copy. also do it after blocking read, so filters will make sense.
   const dt_image_t *img = dt_image_cache_get(darktable.image_cache, imgid, 'r');
   const dt_image_t image = *img;
   dt_image_cache_read_release(darktable.image_cache, img);
 
-  if(!d->pixels)
+  if(!buf.buf)
   {
-    d->first_imgid = imgid;
-    d->first_filter = dt_image_filter(&image);
-    d->pixels = calloc(datai->width * datai->height, sizeof(float));
-    d->weight = calloc(datai->width * datai->height, sizeof(float));
-    d->wd = datai->width;
-    d->ht = datai->height;
-    d->orientation = image.orientation;
+    dt_control_log(_("image `%s' is not available!"), image.filename);
+    dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+    d->abort = TRUE;
+    return 1;
   }
 
   if(image.filters == 0u || image.filters == 9u || image.bpp != sizeof(uint16_t))
   {
     dt_control_log(_("exposure bracketing only works on Bayer raw images."));
+    dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
     d->abort = TRUE;
     return 1;
   }
-  else if(datai->width != d->wd || datai->height != d->ht || d->first_filter != dt_image_filter(&image)
-          || d->orientation != image.orientation)
+
+  const int cx = image.crop_x, cy = image.crop_y;
+  const int wd = buf.width - image.crop_x - image.crop_width;
+  const int ht = buf.height - image.crop_y - image.crop_height;
+
+  if(!d->pixels)
+  {
+    d->first_imgid = imgid;
+    d->first_filter = dt_image_filter(&image);
+    d->pixels = calloc((size_t)wd * ht, sizeof(float));
+    d->weight = calloc((size_t)wd * ht, sizeof(float));
+    d->wd = wd;
+    d->ht = ht;
+    d->orientation = image.orientation;
+  }
+
+  if(wd != d->wd || ht != d->ht || d->first_filter != dt_image_filter(&image)
+     || d->orientation != image.orientation)
   {
     dt_control_log(_("images have to be of same size and orientation!"));
+    dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
     d->abort = TRUE;
     return 1;
   }
@@ -322,72 +321,100 @@ static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai, const c
   const float cal = 100.0f / (aperture * exp * iso);
   // about proportional to how many photons we can expect from this shot:
   const float photoncnt = 100.0f * aperture * exp / iso;
-  // once we get unscaled raw data in this uint16_t buffer, we need to rescale (and subtract black before
-  // using the values):
-  float saturation = 1.0f; // image.raw_white_point - image.raw_black_level;
+  // the raw data gets black subtracted and scaled to white here, so it saturates at 1:
+  const float saturation = 1.0f;
   d->whitelevel = fmaxf(d->whitelevel, saturation * cal);
+
+  // black level per position in the 2x2 block of the uncropped sensor
+  float sub[4], div[4];
+  for(int k = 0; k < 4; k++)
+  {
+    sub[k] = image.raw_black_level_separate[k];
+    div[k] = image.raw_white_point - sub[k];
+  }
+
+  // need some safety margin due to upsampling and 16-bit quantization + dithering?
+  const float offset = 3000.0f / (float)UINT16_MAX;
+
+  const uint16_t *const raw = (const uint16_t *)buf.buf;
+  const size_t stride = buf.width;
+  float *const pixels = d->pixels, *const weight = d->weight;
+  const float whitelevel = d->whitelevel, epsw = d->epsw;
+
+  // go through the frame in bands of bayer block rows, each band is only touched by one thread.
 #ifdef _OPENMP
-#pragma omp parallel for schedule(static) default(none) shared(d, saturation)
+#pragma omp parallel for schedule(static)
 #endif
-  for(int y = 0; y < d->ht; y++)
-    for(int x = 0; x < d->wd; x++)
+  for(int yy = 0; yy < ht; yy += 2)
+  {
+    const int bh = MIN(2, ht - yy);
+    for(int xx = 0; xx < wd; xx += 2)
     {
-      const float in = ((float *)ivoid)[x + d->wd * y];
+      const int bw = MIN(2, wd - xx);
+      float in[4] = { 0.0f };
+      for(int j = 0; j < bh; j++)
+        for(int i = 0; i < bw; i++)
+        {
+          const int row = yy + j + cy, col = xx + i + cx;
+          const int id = ((row & 1) << 1) + (col & 1);
+          in[2 * j + i] = MAX(0.0f, raw[stride * row + col] - sub[id]) / div[id];
+        }
+
       // weights based on siggraph 12 poster
       // zijian zhu, zhengguo li, susanto rahardja, pasi fraenti
       // 2d denoising factor for high dynamic range imaging
       float w = photoncnt;
 
-      // need some safety margin due to upsampling and 16-bit quantization + dithering?
-      float offset = 3000.0f / (float)UINT16_MAX;
-
       // cannot do an envelope based on single pixel values here, need to get
-      // maximum value of all color channels. do find that, go through the bayer
-      // pattern block:
-      int xx = x & ~1, yy = y & ~1;
+      // maximum value of all color channels. to find that, go through the bayer
+      // pattern block, once for all four pixels in it:
       float M = 0.0f, m = FLT_MAX;
-      if(xx < d->wd - 1 && yy < d->ht - 1)
+      if(bh == 2 && bw == 2)
       {
-        for(int i = 0; i < 2; i++)
-          for(int j = 0; j < 2; j++)
-          {
-            M = MAX(M, ((float *)ivoid)[xx + i + d->wd * (yy + j)]);
-            m = MIN(m, ((float *)ivoid)[xx + i + d->wd * (yy + j)]);
-          }
+        M = fmaxf(fmaxf(in[0], in[1]), fmaxf(in[2], in[3]));
+        m = fminf(fminf(in[0], in[1]), fminf(in[2], in[3]));
         // move envelope a little to allow non-zero weight even for clipped regions.
         // this is because even if the 2x2 block is clipped somewhere, the other channels
         // might still prove useful. we'll check for individual channel saturation below.
-        w *= d->epsw + envelope((M + offset) / saturation);
+        w *= epsw + envelope((M + offset) / saturation);
       }
 
-      if(M + offset >= saturation)
-      {
-        if(d->weight[x + d->wd * y] <= 0.0f)
-        { // only consider saturated pixels in case we have nothing better:
-          if(d->weight[x + d->wd * y] == 0 || m < -d->weight[x + d->wd * y])
+      for(int j = 0; j < bh; j++)
+        for(int i = 0; i < bw; i++)
+        {
+          const size_t k = (size_t)wd * (yy + j) + xx + i;
+          const float v = in[2 * j + i];
+          if(M + offset >= saturation)
           {
-            if(m + offset >= saturation)
-              d->pixels[x + d->wd * y] = 1.0f; // let's admit we were completely clipped, too
-            else
-              d->pixels[x + d->wd * y] = in * cal / d->whitelevel;
-            d->weight[x + d->wd * y]
-                = -m; // could use -cal here, but m is per pixel and safer for varying illumination conditions
+            if(weight[k] <= 0.0f)
+            { // only consider saturated pixels in case we have nothing better:
+              if(weight[k] == 0 || m < -weight[k])
+              {
+                if(m + offset >= saturation)
+                  pixels[k] = 1.0f; // let's admit we were completely clipped, too
+                else
+                  pixels[k] = v * cal / whitelevel;
+                weight[k] = -m; // could use -cal here, but m is per pixel and safer for varying illumination
+                                // conditions
+              }
+            }
+            // else silently ignore, others have filled in a better color here already
+          }
+          else
+          {
+            if(weight[k] <= 0.0)
+            { // cleanup potentially blown highlights from earlier images
+              pixels[k] = 0.0f;
+              weight[k] = 0.0f;
+            }
+            pixels[k] += w * v * cal;
+            weight[k] += w;
           }
         }
-        // else silently ignore, others have filled in a better color here already
-      }
-      else
-      {
-        if(d->weight[x + d->wd * y] <= 0.0)
-        { // cleanup potentially blown highlights from earlier images
-          d->pixels[x + d->wd * y] = 0.0f;
-          d->weight[x + d->wd * y] = 0.0f;
-        }
-        d->pixels[x + d->wd * y] += w * in * cal;
-        d->weight[x + d->wd * y] += w;
-      }
     }
+  }
 
+  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
   return 0;
 }
 
@@ -405,29 +432,24 @@ static int32_t dt_control_merge_hdr_job_run(dt_job_t *job)
 
   dt_control_merge_hdr_t d = (dt_control_merge_hdr_t){.epsw = 1e-8f, .abort = FALSE };
 
-  dt_imageio_module_format_t buf = (dt_imageio_module_format_t){.mime = dt_control_merge_hdr_mime,
-                                                                .levels = dt_control_merge_hdr_levels,
-                                                                .bpp = dt_control_merge_hdr_bpp,
-                                                                .write_image = dt_control_merge_hdr_process };
-
-  dt_control_merge_hdr_format_t dat = (dt_control_merge_hdr_format_t){.parent = { 0 }, .d = &d };
-
-  int num = 1;
   while(t)
   {
     if(d.abort) goto end;
 
     const uint32_t imgid = GPOINTER_TO_INT(t->data);
 
-    dt_imageio_export_with_flags(imgid, "unused", &buf, (dt_imageio_module_data_t *)&dat, 1, 0, 0, 1, 0,
-                                 "pre:rawprepare", 0, 0, 0, num, total);
+    // let a worker decode the next frame while this one is merged
+    if(t->next)
+      dt_mipmap_cache_get(darktable.mipmap_cache, NULL, GPOINTER_TO_INT(t->next->data), DT_MIPMAP_FULL,
+                          DT_MIPMAP_PREFETCH, 'r');
+
+    dt_control_merge_hdr_process(&d, imgid);
 
     t = g_list_delete_link(t, t);
 
     /* update the progress bar */
     fraction += 1.0 / (total + 1);
     dt_control_progress_set_progress(darktable.control, progress, fraction);
-    num++;
   }
 
   if(d.abort) goto end;
@@ -1019,6 +1041,8 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   dt_tag_new("darktable|changed", &tagid);
   dt_tag_new("darktable|exported", &etagid);
 
+  // images of the same shoot usually share most of their history
+  dt_imageio_export_context_begin();
   while(t && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED)
   {
     if(!t)
@@ -1060,6 +1084,7 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
     if(fraction > 1.0) fraction = 1.0;
     dt_control_progress_set_progress(control, progress, fraction);
   }
+  dt_imageio_export_context_end();
 
   dt_control_progress_destroy(control, progress);
   if(mstorage->finalize_store) mstorage->finalize_store(mstorage, sdata);
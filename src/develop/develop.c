@@ -44,6 +44,9 @@
 #define DT_DEV_AVERAGE_DELAY_START 250
 #define DT_DEV_PREVIEW_AVERAGE_DELAY_START 50
 #define DT_DEV_AVERAGE_DELAY_COUNT 5
+// progressive refinement: first pass at a quarter of the size, unless the full one is quick anyways
+#define DT_DEV_PROGRESSIVE_DOWNSCALE 4
+#define DT_DEV_PROGRESSIVE_MIN_DELAY 50
 
 const gchar *dt_dev_histogram_type_names[DT_DEV_HISTOGRAM_N] = { "logarithmic", "linear", "waveform" };
 
@@ -70,7 +73,6 @@ void dt_dev_init(dt_develop_t *dev, int32_t gui_attached)
   dev->image_status = dev->preview_status = DT_DEV_PIXELPIPE_DIRTY;
   dev->image_loading = dev->preview_loading = 0;
   dev->image_force_reload = 0;
-  dev->preview_input_changed = 0;
 
   dev->pipe = dev->preview_pipe = NULL;
   dt_pthread_mutex_init(&dev->pipe_mutex, NULL);
@@ -189,26 +191,22 @@ void dt_dev_invalidate_all(dt_develop_t *dev)
 void dt_dev_process_preview_job(dt_develop_t *dev)
 {
   dt_mipmap_buffer_t buf;
-  if(dev->image_loading)
-  {
-    // raw is already loading, no use starting another file access, we wait.
-    return;
-  }
-
+  // the raw is decoded before the image is opened and mip f is started from it right away (see
+  // _dt_dev_load_raw()), so there is no need to wait for the full pipe's first run here.
   dt_pthread_mutex_lock(&dev->preview_pipe_mutex);
   dt_control_log_busy_enter();
   dev->preview_pipe->input_timestamp = dev->timestamp;
   dev->preview_status = DT_DEV_PIXELPIPE_RUNNING;
 
-  // lock if there, issue a background load, if not (best-effort for mip f).
-  dt_mipmap_cache_get(darktable.mipmap_cache, &buf, dev->image_storage.id, DT_MIPMAP_F, 0, 'r');
+  // the full buffer is in memory already, so this only waits for the downsampling to mip f.
+  dt_mipmap_cache_get(darktable.mipmap_cache, &buf, dev->image_storage.id, DT_MIPMAP_F, DT_MIPMAP_BLOCKING,
+                      'r');
   if(!buf.buf)
   {
     dt_control_log_busy_leave();
     dev->preview_status = DT_DEV_PIXELPIPE_DIRTY;
     dt_pthread_mutex_unlock(&dev->preview_pipe_mutex);
-    return; // not loaded yet. load will issue a gtk redraw on completion, which in turn will trigger us again
-            // later.
+    return; // failed to load
   }
   // init pixel pipeline for preview.
   dt_dev_pixelpipe_set_input(dev->preview_pipe, dev, (float *)buf.buf, buf.width, buf.height,
@@ -219,16 +217,10 @@ void dt_dev_process_preview_job(dt_develop_t *dev)
     dt_dev_pixelpipe_cleanup_nodes(dev->preview_pipe);
     dt_dev_pixelpipe_create_nodes(dev->preview_pipe, dev);
     dt_dev_pixelpipe_flush_caches(dev->preview_pipe);
+    dev->preview_pipe->changed |= DT_DEV_PIPE_SYNCH;
     dev->preview_loading = 0;
   }
 
-  // if raw loaded, get new mipf
-  if(dev->preview_input_changed)
-  {
-    dt_dev_pixelpipe_flush_caches(dev->preview_pipe);
-    dev->preview_input_changed = 0;
-  }
-
 // always process the whole downsampled mipf buffer, to allow for fast scrolling and mip4 write-through.
 restart:
   if(dev->gui_leaving)
@@ -248,7 +240,7 @@ restart:
          dev->preview_pipe, dev, 0, 0, dev->preview_pipe->processed_width * dev->preview_downsampling,
          dev->preview_pipe->processed_height * dev->preview_downsampling, dev->preview_downsampling))
   {
-    if(dev->preview_loading || dev->preview_input_changed)
+    if(dev->preview_loading)
     {
       dt_control_log_busy_leave();
       dev->preview_status = DT_DEV_PIXELPIPE_INVALID;
@@ -304,14 +296,9 @@ void dt_dev_process_image_job(dt_develop_t *dev)
     dt_dev_pixelpipe_create_nodes(dev->pipe, dev);
     if(dev->image_force_reload) dt_dev_pixelpipe_flush_caches(dev->pipe);
     dev->image_force_reload = 0;
-    if(dev->gui_attached)
-    {
-      // during load, a mipf update could have been issued.
-      dev->preview_input_changed = 1;
-      dev->preview_status = DT_DEV_PIXELPIPE_DIRTY;
-      dev->gui_synch = 1; // notify gui thread we want to synch (call gui_update in the modules)
-      dev->preview_pipe->changed |= DT_DEV_PIPE_SYNCH;
-    }
+    // notify gui thread we want to synch (call gui_update in the modules). the preview pipe sets itself up
+    // in parallel, with dev->preview_loading.
+    if(dev->gui_attached) dev->gui_synch = 1;
     dev->pipe->changed |= DT_DEV_PIPE_SYNCH;
   }
 
@@ -363,6 +350,32 @@ restart:
   x = MAX(0, scale * dev->pipe->processed_width  * (.5 + zoom_x) - wd / 2);
   y = MAX(0, scale * dev->pipe->processed_height * (.5 + zoom_y) - ht / 2);
 
+  // after an edit, get something on screen quickly before doing the real thing. a new edit arriving meanwhile
+  // makes the full size pass hit dt_iop_breakpoint(), and we start over here. local edits which only need a
+  // small part of the image rendered again are quick anyways.
+  if(dev->gui_attached && !dev->image_loading
+     && (pipe_changed & (DT_DEV_PIPE_TOP_CHANGED | DT_DEV_PIPE_REMOVE | DT_DEV_PIPE_SYNCH))
+     && dev->average_delay > DT_DEV_PROGRESSIVE_MIN_DELAY && wd >= 16 * DT_DEV_PROGRESSIVE_DOWNSCALE
+     && ht >= 16 * DT_DEV_PROGRESSIVE_DOWNSCALE && dt_conf_get_bool("plugins/darkroom/progressive")
+     && !dt_dev_pixelpipe_can_patch(dev->pipe, dev, x, y, wd, ht, scale))
+  {
+    if(dt_dev_pixelpipe_process_coarse(dev->pipe, dev, x, y, wd, ht, scale, DT_DEV_PROGRESSIVE_DOWNSCALE))
+    {
+      if(dev->image_force_reload)
+      {
+        dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+        dt_control_log_busy_leave();
+        dev->image_status = DT_DEV_PIXELPIPE_INVALID;
+        dt_pthread_mutex_unlock(&dev->pipe_mutex);
+        return;
+      }
+      goto restart;
+    }
+    // the pipe is in synch with the latest history, so this is what the user asked for, only coarser
+    dev->image_status = DT_DEV_PIXELPIPE_VALID;
+    dt_control_queue_redraw_center();
+  }
+
   dt_get_times(&start);
   if(dt_dev_pixelpipe_process(dev->pipe, dev, x, y, wd, ht, scale))
   {
@@ -407,6 +420,10 @@ static inline void _dt_dev_load_raw(dt_develop_t *dev, const uint32_t imgid)
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
   dt_show_times(&start, "[dev]", "to load the image.");
 
+  // downsample for the preview pipe on a worker, while we go on loading modules and history
+  // and the full pipe gets set up.
+  dt_mipmap_cache_get(darktable.mipmap_cache, NULL, imgid, DT_MIPMAP_F, DT_MIPMAP_PREFETCH, 'r');
+
   const dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'r');
   dev->image_storage = *image;
   dt_image_cache_read_release(darktable.image_cache, image);
@@ -1667,6 +1684,28 @@ int dt_dev_distort_backtransform_plus(dt_develop_t *dev, dt_dev_pixelpipe_t *pip
   return 1;
 }
 
+uint64_t dt_dev_hash_distort_plus(dt_develop_t *dev, dt_dev_pixelpipe_t *pipe, int pmin, int pmax)
+{
+  uint64_t hash = 5381;
+  dt_pthread_mutex_lock(&dev->history_mutex);
+  GList *modules = g_list_first(dev->iop);
+  GList *pieces = g_list_first(pipe->nodes);
+  while(modules && pieces)
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)(modules->data);
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)(pieces->data);
+    if(piece->enabled && module->priority <= pmax && module->priority >= pmin
+       && (module->operation_tags() & IOP_TAG_DISTORT))
+    {
+      hash = ((hash << 5) + hash) ^ piece->hash;
+    }
+    modules = g_list_next(modules);
+    pieces = g_list_next(pieces);
+  }
+  dt_pthread_mutex_unlock(&dev->history_mutex);
+  return hash;
+}
+
 dt_dev_pixelpipe_iop_t *dt_dev_distort_get_iop_pipe(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe,
                                                     struct dt_iop_module_t *module)
 {
@@ -85,7 +85,7 @@ typedef struct dt_develop_t
   int32_t gui_synch;    // set by the render threads if gui_update should be called in the modules.
   int32_t focus_hash;   // determines whether to start a new history item or to merge down.
   int32_t image_loading, first_load, image_force_reload;
-  int32_t preview_loading, preview_input_changed;
+  int32_t preview_loading;
   dt_dev_pixelpipe_status_t image_status, preview_status;
   uint32_t timestamp;
   uint32_t average_delay;
@@ -310,6 +310,9 @@ int dt_dev_distort_transform_plus(dt_develop_t *dev, struct dt_dev_pixelpipe_t *
                                   float *points, size_t points_count);
 int dt_dev_distort_backtransform_plus(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, int pmin, int pmax,
                                       float *points, size_t points_count);
+/** hash of the parameters of all distorting modules between pmin and pmax. everything transformed with
+ * dt_dev_distort_transform_plus() in that range stays valid as long as this does not change. */
+uint64_t dt_dev_hash_distort_plus(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, int pmin, int pmax);
 /** get the iop_pixelpipe instance corresponding to the iop in the given pipe */
 struct dt_dev_pixelpipe_iop_t *dt_dev_distort_get_iop_pipe(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe,
                                                            struct dt_iop_module_t *module);
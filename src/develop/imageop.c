@@ -286,6 +286,10 @@ int dt_iop_load_module_so(dt_iop_module_so_t *module, const char *libname, const
     module->modify_roi_in = dt_iop_modify_roi_in;
   if(!g_module_symbol(module->module, "modify_roi_out", (gpointer) & (module->modify_roi_out)))
     module->modify_roi_out = dt_iop_modify_roi_out;
+  if(!g_module_symbol(module->module, "invert_roi_in", (gpointer) & (module->invert_roi_in)))
+    module->invert_roi_in = NULL;
+  if(!g_module_symbol(module->module, "dirty_rect", (gpointer) & (module->dirty_rect)))
+    module->dirty_rect = NULL;
   if(!g_module_symbol(module->module, "legacy_params", (gpointer) & (module->legacy_params)))
     module->legacy_params = NULL;
 
@@ -389,6 +393,8 @@ static int dt_iop_load_module_by_so(dt_iop_module_t *module, dt_iop_module_so_t
   module->distort_backtransform = so->distort_backtransform;
   module->modify_roi_in = so->modify_roi_in;
   module->modify_roi_out = so->modify_roi_out;
+  module->invert_roi_in = so->invert_roi_in;
+  module->dirty_rect = so->dirty_rect;
   module->legacy_params = so->legacy_params;
 
   module->connect_key_accels = so->connect_key_accels;
@@ -1355,9 +1361,20 @@ void dt_iop_commit_params(dt_iop_module_t *module, dt_iop_params_t *params,
     /* and we add masks */
     dt_masks_group_get_hash_buffer(grp, str + pos);
 
-    // assume process_cl is ready, commit_params can overwrite this.
-    if(module->process_cl) piece->process_cl_ready = 1;
-    module->commit_params(module, params, pipe, piece);
+    // what is actually committed: the params passed in, instead of the ones of the module
+    uint64_t commit_hash = 5381;
+    for(int i = 0; i < module->params_size; i++)
+      commit_hash = ((commit_hash << 5) + commit_hash) ^ ((const char *)params)[i];
+    for(int i = module->params_size; i < length; i++) commit_hash = ((commit_hash << 5) + commit_hash) ^ str[i];
+
+    // data taken over from the previous image of an export is good as it is for the same params
+    if(!piece->adopted || piece->commit_hash != commit_hash)
+    {
+      // assume process_cl is ready, commit_params can overwrite this.
+      if(module->process_cl) piece->process_cl_ready = 1;
+      module->commit_params(module, params, pipe, piece);
+      piece->commit_hash = commit_hash;
+    }
     for(int i = 0; i < length; i++) hash = ((hash << 5) + hash) ^ str[i];
     piece->hash = hash;
 
@@ -84,7 +84,15 @@ typedef enum dt_iop_flags_t
   IOP_FLAGS_PREVIEW_NON_OPENCL
   = 1 << 8, // Preview pixelpipe of this module must not run on GPU but always on CPU
   IOP_FLAGS_NO_HISTORY_STACK = 1 << 9, // This iop will never show up in the history stack
-  IOP_FLAGS_NO_MASKS = 1 << 10         // The module doesn't support masks (used with SUPPORT_BLENDING)
+  IOP_FLAGS_NO_MASKS = 1 << 10,        // The module doesn't support masks (used with SUPPORT_BLENDING)
+  IOP_FLAGS_TILING_PARALLEL = 1 << 11, // process() may run on several tiles at once. it must not write to piece
+                                       // or pipe and must not rely on dt_get_thread_num() across calls
+  IOP_FLAGS_ALLOW_PATCHING = 1 << 12,  // output in a region only depends on the input in modify_roi_in() of it,
+                                       // even without tiling support. see dt_dev_pixelpipe_process()
+  IOP_FLAGS_IMAGE_INDEPENDENT = 1 << 13, // piece data after commit_params() only depends on the params and the
+                                         // pipe type, not on the image. see dt_dev_pixelpipe_recreate_nodes()
+  IOP_FLAGS_PREVIEW_SIDE_EFFECTS = 1 << 14 // process() in the preview pipe stores results others rely on (gui data,
+                                           // data for the full pipe), so it can't be taken over. see _preview_only()
 } dt_iop_flags_t;
 
 /** status of a module*/
@@ -186,6 +194,10 @@ typedef struct dt_iop_module_so_t
                         const struct dt_iop_roi_t *roi_out, struct dt_iop_roi_t *roi_in);
   void (*modify_roi_out)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                          struct dt_iop_roi_t *roi_out, const struct dt_iop_roi_t *roi_in);
+  void (*invert_roi_in)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                        const struct dt_iop_roi_t *roi_in, struct dt_iop_roi_t *roi_out);
+  int (*dirty_rect)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                    struct dt_iop_roi_t *rect);
   int (*legacy_params)(struct dt_iop_module_t *self, const void *const old_params, const int old_version,
                        void *new_params, const int new_version);
 
@@ -365,6 +377,15 @@ typedef struct dt_iop_module_t
                         const struct dt_iop_roi_t *roi_out, struct dt_iop_roi_t *roi_in);
   void (*modify_roi_out)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                          struct dt_iop_roi_t *roi_out, const struct dt_iop_roi_t *roi_in);
+  /** optional inverse of modify_roi_in: the output region a given input region maps to. only a hint for the
+   * tiling code, which still checks the result. roi_out->scale is set by the caller. */
+  void (*invert_roi_in)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                        const struct dt_iop_roi_t *roi_in, struct dt_iop_roi_t *roi_out);
+  /** optional: the part of the output that changed since the last call, in pipe coordinates at scale 1
+   * (rect->scale is ignored). returns 0 if that's not known, the pipe renders everything in that case.
+   * an empty rect means the output didn't change. */
+  int (*dirty_rect)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                    struct dt_iop_roi_t *rect);
   int (*legacy_params)(struct dt_iop_module_t *self, const void *const old_params, const int old_version,
                        void *new_params, const int new_version);
 
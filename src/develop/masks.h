@@ -237,6 +237,14 @@ int dt_masks_group_render(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece
 int dt_masks_group_render_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                               const dt_iop_roi_t *roi, float *buffer);
 
+/** cache of rasterised forms, one per pipe. dt_masks_get_mask_roi() looks up every form (and group) there
+ * first, keyed by the form's shape, the roi, the image and the distortions in front of the module. max_size is
+ * in bytes, 0 disables the cache. */
+struct dt_masks_cache_t *dt_masks_cache_new(size_t max_size);
+/** drop all cached rasters, e.g. when a pipe moves on to the next image. */
+void dt_masks_cache_flush(struct dt_masks_cache_t *cache);
+void dt_masks_cache_free(struct dt_masks_cache_t *cache);
+
 // returns current masks version
 int dt_masks_version(void);
 
@@ -299,6 +307,8 @@ void dt_masks_iop_combo_populate(struct dt_iop_module_t **m);
 void dt_masks_iop_use_same_as(struct dt_iop_module_t *module, struct dt_iop_module_t *src);
 int dt_masks_group_get_hash_buffer_length(dt_masks_form_t *form);
 char *dt_masks_group_get_hash_buffer(dt_masks_form_t *form, char *str);
+/** hash of the shape of a form, including the members of groups. */
+uint64_t dt_masks_form_get_hash(dt_develop_t *dev, const dt_masks_form_t *form);
 
 void dt_masks_form_remove(struct dt_iop_module_t *module, dt_masks_form_t *grp, dt_masks_form_t *form);
 void dt_masks_form_change_opacity(dt_masks_form_t *form, int parentid, int up);
@@ -2614,9 +2614,10 @@ static int dt_brush_get_mask(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *pi
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static inline void _brush_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh, float hardness,
-                                      float density)
+/** we write a falloff segment respecting limits of buffer. only rows y0 <= y < y1 are touched, so that
+    several threads can draw the same segments into different bands of the buffer */
+static inline void _brush_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int bh, float hardness,
+                                      float density, int y0, int y1)
 {
   // segment length (increase by 1 to avoid division-by-zero special case handling)
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
@@ -2649,10 +2650,13 @@ static inline void _brush_falloff_roi(float *buffer, int *p0, int *p1, int bw, i
 
     float *buf = buffer + (size_t)y * bw + x;
 
-    *buf = fmaxf(*buf, op);
-    if(x + dx >= 0 && x + dx < bw)
-      buf[dpx] = fmaxf(buf[dpx], op); // this one is to avoid gaps due to int rounding
-    if(y + dy >= 0 && y + dy < bh)
+    if(y >= y0 && y < y1)
+    {
+      *buf = fmaxf(*buf, op);
+      if(x + dx >= 0 && x + dx < bw)
+        buf[dpx] = fmaxf(buf[dpx], op); // this one is to avoid gaps due to int rounding
+    }
+    if(y + dy >= y0 && y + dy < y1)
       buf[dpy] = fmaxf(buf[dpy], op); // this one is to avoid gaps due to int rounding
   }
 }
@@ -2749,20 +2753,36 @@ static int dt_brush_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
     return 1;
   }
 
-  // now we fill the falloff
-  int p0[2], p1[2];
-  for(int i = nb_corner * 3; i < border_count; i++)
+  // now we fill the falloff, each thread into its own horizontal bands of the buffer. strokes crossing
+  // several bands are walked by each of them, but every pixel is written by one thread only.
+  const int first = nb_corner * 3;
+  const int bands = MAX(1, MIN(height / 16, 4 * dt_get_num_threads()));
+  const int band_height = (height + bands - 1) / bands;
+#ifdef _OPENMP
+#if !defined(__SUNOS__) && !defined(__NetBSD__)
+#pragma omp parallel for schedule(dynamic) default(none) shared(buffer, points, border, payload, border_count)
+#else
+#pragma omp parallel for schedule(dynamic) shared(buffer, points, border, payload, border_count)
+#endif
+#endif
+  for(int b = 0; b < bands; b++)
   {
-    p0[0] = points[i * 2];
-    p0[1] = points[i * 2 + 1];
-    p1[0] = border[i * 2];
-    p1[1] = border[i * 2 + 1];
+    const int y0 = b * band_height;
+    const int y1 = MIN(y0 + band_height, height);
+    int p0[2], p1[2];
+    for(int i = first; i < border_count; i++)
+    {
+      p0[0] = points[i * 2];
+      p0[1] = points[i * 2 + 1];
+      p1[0] = border[i * 2];
+      p1[1] = border[i * 2 + 1];
 
-    if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < 0
-       || MIN(p0[1], p1[1]) >= height)
-      continue;
+      if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < y0 - 1
+         || MIN(p0[1], p1[1]) > y1)
+        continue;
 
-    _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1]);
+      _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1], y0, y1);
+    }
   }
 
   free(points);
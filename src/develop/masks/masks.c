@@ -470,8 +470,8 @@ int dt_masks_get_mask(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt
   return 0;
 }
 
-int dt_masks_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
-                          const dt_iop_roi_t *roi, float *buffer)
+static int _masks_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
+                               const dt_iop_roi_t *roi, float *buffer)
 {
   if(form->type & DT_MASKS_CIRCLE)
   {
@@ -500,6 +500,201 @@ int dt_masks_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece
   return 0;
 }
 
+typedef struct dt_masks_cache_key_t
+{
+  uint64_t form_hash;    // shape of the form, and of all its children for groups
+  uint64_t distort_hash; // distortions in front of the module, params only
+  int imgid;             // exif driven distortions (flip) differ between images with the same params
+  dt_iop_roi_t roi;
+  int iwidth, iheight; // pipe input
+  float iscale;
+  int formid;
+} dt_masks_cache_key_t;
+
+typedef struct dt_masks_cache_entry_t
+{
+  dt_masks_cache_key_t key;
+  float *buffer;
+  size_t size; // in bytes
+} dt_masks_cache_entry_t;
+
+typedef struct dt_masks_cache_t
+{
+  dt_pthread_mutex_t lock;
+  GList *entries; // most recently used first
+  size_t used, max_size;
+} dt_masks_cache_t;
+
+dt_masks_cache_t *dt_masks_cache_new(size_t max_size)
+{
+  dt_masks_cache_t *cache = (dt_masks_cache_t *)calloc(1, sizeof(dt_masks_cache_t));
+  if(!cache) return NULL;
+  dt_pthread_mutex_init(&cache->lock, NULL);
+  cache->max_size = max_size;
+  return cache;
+}
+
+static void _masks_cache_entry_free(gpointer data)
+{
+  dt_masks_cache_entry_t *e = (dt_masks_cache_entry_t *)data;
+  dt_free_align(e->buffer);
+  free(e);
+}
+
+void dt_masks_cache_flush(dt_masks_cache_t *cache)
+{
+  if(!cache) return;
+  dt_pthread_mutex_lock(&cache->lock);
+  g_list_free_full(cache->entries, _masks_cache_entry_free);
+  cache->entries = NULL;
+  cache->used = 0;
+  dt_pthread_mutex_unlock(&cache->lock);
+}
+
+void dt_masks_cache_free(dt_masks_cache_t *cache)
+{
+  if(!cache) return;
+  g_list_free_full(cache->entries, _masks_cache_entry_free);
+  dt_pthread_mutex_destroy(&cache->lock);
+  free(cache);
+}
+
+static size_t _masks_point_size(const dt_masks_form_t *form)
+{
+  if(form->type & DT_MASKS_CIRCLE) return sizeof(dt_masks_point_circle_t);
+  if(form->type & DT_MASKS_PATH) return sizeof(dt_masks_point_path_t);
+  if(form->type & DT_MASKS_GRADIENT) return sizeof(dt_masks_point_gradient_t);
+  if(form->type & DT_MASKS_ELLIPSE) return sizeof(dt_masks_point_ellipse_t);
+  if(form->type & DT_MASKS_BRUSH) return sizeof(dt_masks_point_brush_t);
+  return 0;
+}
+
+static uint64_t _masks_hash_bytes(uint64_t hash, const void *data, const size_t size)
+{
+  const char *str = (const char *)data;
+  for(size_t i = 0; i < size; i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash;
+}
+
+// like dt_masks_group_get_hash_buffer(), but resolving group members in the form's own develop
+static uint64_t _masks_form_hash(dt_develop_t *dev, const dt_masks_form_t *form, uint64_t hash)
+{
+  hash = _masks_hash_bytes(hash, &form->type, sizeof(dt_masks_type_t));
+  hash = _masks_hash_bytes(hash, &form->formid, sizeof(int));
+  hash = _masks_hash_bytes(hash, &form->version, sizeof(int));
+  hash = _masks_hash_bytes(hash, form->source, 2 * sizeof(float));
+
+  const size_t point_size = _masks_point_size(form);
+  for(GList *l = g_list_first(form->points); l; l = g_list_next(l))
+  {
+    if(form->type & DT_MASKS_GROUP)
+    {
+      const dt_masks_point_group_t *grpt = (dt_masks_point_group_t *)l->data;
+      const dt_masks_form_t *f = dt_masks_get_from_id(dev, grpt->formid);
+      if(!f) continue;
+      hash = _masks_hash_bytes(hash, &grpt->state, sizeof(int));
+      hash = _masks_hash_bytes(hash, &grpt->opacity, sizeof(float));
+      hash = _masks_form_hash(dev, f, hash);
+    }
+    else
+      hash = _masks_hash_bytes(hash, l->data, point_size);
+  }
+  return hash;
+}
+
+uint64_t dt_masks_form_get_hash(dt_develop_t *dev, const dt_masks_form_t *form)
+{
+  return _masks_form_hash(dev, form, 5381);
+}
+
+static void _masks_cache_key_init(dt_masks_cache_key_t *key, dt_iop_module_t *module,
+                                  dt_dev_pixelpipe_iop_t *piece, const dt_masks_form_t *form,
+                                  const dt_iop_roi_t *roi)
+{
+  // keys are compared bytewise, don't leave garbage in the padding
+  memset(key, 0, sizeof(dt_masks_cache_key_t));
+  key->form_hash = _masks_form_hash(module->dev, form, 5381);
+  key->distort_hash = dt_dev_hash_distort_plus(module->dev, piece->pipe, 0, module->priority);
+  key->imgid = piece->pipe->image.id;
+  key->roi = *roi;
+  key->iwidth = piece->pipe->iwidth;
+  key->iheight = piece->pipe->iheight;
+  key->iscale = piece->pipe->iscale;
+  key->formid = form->formid;
+}
+
+static int _masks_cache_get(dt_masks_cache_t *cache, const dt_masks_cache_key_t *key, float *buffer)
+{
+  int found = 0;
+  dt_pthread_mutex_lock(&cache->lock);
+  for(GList *l = cache->entries; l; l = g_list_next(l))
+  {
+    dt_masks_cache_entry_t *e = (dt_masks_cache_entry_t *)l->data;
+    if(memcmp(&e->key, key, sizeof(dt_masks_cache_key_t))) continue;
+    memcpy(buffer, e->buffer, e->size);
+    cache->entries = g_list_delete_link(cache->entries, l);
+    cache->entries = g_list_prepend(cache->entries, e);
+    found = 1;
+    break;
+  }
+  dt_pthread_mutex_unlock(&cache->lock);
+  return found;
+}
+
+static void _masks_cache_put(dt_masks_cache_t *cache, const dt_masks_cache_key_t *key, const float *buffer)
+{
+  const size_t size = (size_t)key->roi.width * key->roi.height * sizeof(float);
+  // a single mask shouldn't push out everything else
+  if(size > cache->max_size / 4) return;
+
+  dt_masks_cache_entry_t *e = (dt_masks_cache_entry_t *)malloc(sizeof(dt_masks_cache_entry_t));
+  if(!e) return;
+  e->buffer = dt_alloc_align(64, size);
+  if(!e->buffer)
+  {
+    free(e);
+    return;
+  }
+  e->key = *key;
+  e->size = size;
+  memcpy(e->buffer, buffer, size);
+
+  dt_pthread_mutex_lock(&cache->lock);
+  // stale versions of the form age out from the tail, like everything else
+  while(cache->entries && cache->used + size > cache->max_size)
+  {
+    GList *last = g_list_last(cache->entries);
+    dt_masks_cache_entry_t *old = (dt_masks_cache_entry_t *)last->data;
+    cache->used -= old->size;
+    _masks_cache_entry_free(old);
+    cache->entries = g_list_delete_link(cache->entries, last);
+  }
+  cache->entries = g_list_prepend(cache->entries, e);
+  cache->used += size;
+  dt_pthread_mutex_unlock(&cache->lock);
+}
+
+int dt_masks_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
+                          const dt_iop_roi_t *roi, float *buffer)
+{
+  dt_masks_cache_t *cache = piece->pipe->masks_cache;
+  if(!cache || cache->max_size == 0) return _masks_get_mask_roi(module, piece, form, roi, buffer);
+
+  // forms which did not change since the last run are just copied. when editing a mask, only the
+  // edited form (and the groups containing it) miss here.
+  dt_masks_cache_key_t key;
+  _masks_cache_key_init(&key, module, piece, form, roi);
+  if(_masks_cache_get(cache, &key, buffer))
+  {
+    dt_print(DT_DEBUG_MASKS, "[masks] form %d taken from cache\n", form->formid);
+    return 1;
+  }
+
+  const int ok = _masks_get_mask_roi(module, piece, form, roi, buffer);
+  if(ok) _masks_cache_put(cache, &key, buffer);
+  return ok;
+}
+
 int dt_masks_version(void)
 {
   return DEVELOP_MASKS_VERSION;
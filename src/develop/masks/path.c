@@ -2373,8 +2373,9 @@ static int _path_crop_to_roi(float *path, const int point_count, float xmin, flo
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static void _path_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh)
+/** we write a falloff segment respecting limits of buffer. only rows y0 <= y < y1 are touched, so that
+    several threads can draw the same segments into different bands of the buffer */
+static void _path_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int y0, int y1)
 {
   // segment length
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
@@ -2393,14 +2394,138 @@ static void _path_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh)
     const int y = (int)((float)i * ly / (float)l) + p0[1];
     const float op = 1.0 - (float)i / (float)l;
     float *buf = buffer + (size_t)y * bw + x;
-    if(x >= 0 && x < bw && y >= 0 && y < bh) buf[0] = fmaxf(buf[0], op);
-    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
+    if(x >= 0 && x < bw && y >= y0 && y < y1) buf[0] = fmaxf(buf[0], op);
+    if(x + dx >= 0 && x + dx < bw && y >= y0 && y < y1)
       buf[dx] = fmaxf(buf[dx], op); // this one is to avoid gap due to int rounding
-    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
+    if(x >= 0 && x < bw && y + dy >= y0 && y + dy < y1)
       buf[dpy] = fmaxf(buf[dpy], op); // this one is to avoid gap due to int rounding
   }
 }
 
+/** fill the inside of the path (already cropped to the roi) with an edge list: the crossings of all edges
+    with the pixel rows are collected first, then each row is filled span by span, rows in parallel. a pixel
+    crossed an even number of times doesn't toggle, just like in an edge-flag fill. */
+static int _path_fill_scanline(float *buffer, const float *path, const int count, const int width,
+                               const int height, const int xmin, const int xmax, const int ymin, const int ymax)
+{
+  const int rows = ymax - ymin + 1;
+  if(rows <= 0 || xmax < xmin) return 1;
+
+  int *offsets = calloc(rows + 1, sizeof(int));
+  int *fill = malloc(rows * sizeof(int));
+  int *crossings = NULL;
+  if(offsets == NULL || fill == NULL)
+  {
+    free(offsets);
+    free(fill);
+    return 0;
+  }
+
+  // first pass counts the crossings of every row, second pass stores them
+  for(int pass = 0; pass < 2; pass++)
+  {
+    float xlast = path[(count - 1) * 2];
+    float ylast = path[(count - 1) * 2 + 1];
+
+    for(int i = 0; i < count; i++)
+    {
+      float xstart = xlast;
+      float ystart = ylast;
+
+      float xend = xlast = path[i * 2];
+      float yend = ylast = path[i * 2 + 1];
+
+      if(ystart > yend)
+      {
+        float tmp;
+        tmp = ystart, ystart = yend, yend = tmp;
+        tmp = xstart, xstart = xend, xend = tmp;
+      }
+
+      const float m = (xstart - xend) / (ystart - yend); // horizontal edges never enter the loop
+
+      for(int yy = (int)ceilf(ystart); (float)yy < yend; yy++)
+      {
+        const float xcross = xstart + m * (yy - ystart);
+
+        int xx = floorf(xcross);
+        if((float)xx + 0.5f <= xcross) xx++;
+
+        if(xx < 0 || xx >= width || yy < ymin || yy > ymax) continue;
+
+        if(pass == 0)
+          offsets[yy - ymin + 1]++;
+        else
+          crossings[fill[yy - ymin]++] = xx;
+      }
+    }
+
+    if(pass == 0)
+    {
+      for(int r = 0; r < rows; r++) offsets[r + 1] += offsets[r];
+      memcpy(fill, offsets, rows * sizeof(int));
+      crossings = malloc(MAX(offsets[rows], 1) * sizeof(int));
+      if(crossings == NULL)
+      {
+        free(offsets);
+        free(fill);
+        return 0;
+      }
+    }
+  }
+  free(fill);
+
+#ifdef _OPENMP
+#if !defined(__SUNOS__) && !defined(__NetBSD__)
+#pragma omp parallel for schedule(static) default(none) shared(buffer, offsets, crossings)
+#else
+#pragma omp parallel for schedule(static) shared(buffer, offsets, crossings)
+#endif
+#endif
+  for(int r = 0; r < rows; r++)
+  {
+    int *c = crossings + offsets[r];
+    const int n = offsets[r + 1] - offsets[r];
+    float *row = buffer + (size_t)(r + ymin) * width;
+
+    // rows only have a handful of crossings
+    for(int k = 1; k < n; k++)
+    {
+      const int v = c[k];
+      int j = k - 1;
+      for(; j >= 0 && c[j] > v; j--) c[j + 1] = c[j];
+      c[j + 1] = v;
+    }
+
+    int inside = 0, start = 0;
+    for(int k = 0; k < n;)
+    {
+      const int x = c[k];
+      int same = 0;
+      while(k < n && c[k] == x)
+      {
+        same++;
+        k++;
+      }
+      if(!(same & 1)) continue;
+
+      // the crossing pixel itself is always part of the path
+      row[x] = 1.0f;
+      if(!inside)
+        start = x;
+      else
+        for(int xx = MAX(start, xmin); xx < MIN(x, xmax + 1); xx++) row[xx] = 1.0f;
+      inside = !inside;
+    }
+    if(inside)
+      for(int xx = MAX(start, xmin); xx <= xmax; xx++) row[xx] = 1.0f;
+  }
+
+  free(crossings);
+  free(offsets);
+  return 1;
+}
+
 static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                                 const dt_iop_roi_t *roi, float *buffer)
 {
@@ -2594,73 +2719,24 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
     }
     else
     {
-      // all other cases
-
-      // edge-flag polygon fill: we write all the point around the path into the buffer
-      float xlast = cpoints[(points_count - 1) * 2];
-      float ylast = cpoints[(points_count - 1) * 2 + 1];
-
-      for(int i = nb_corner * 3; i < points_count; i++)
-      {
-        float xstart = xlast;
-        float ystart = ylast;
-
-        float xend = xlast = cpoints[i * 2];
-        float yend = ylast = cpoints[i * 2 + 1];
-
-        if(ystart > yend)
-        {
-          float tmp;
-          tmp = ystart, ystart = yend, yend = tmp;
-          tmp = xstart, xstart = xend, xend = tmp;
-        }
-
-        const float m = (xstart - xend) / (ystart - yend); // we don't need special handling of ystart==yend
-                                                           // as following loop will take care
-
-        for(int yy = (int)ceilf(ystart); (float)yy < yend;
-            yy++) // this would normally never touch the last roi line => see comment further above
-        {
-          const float xcross = xstart + m * (yy - ystart);
-
-          int xx = floorf(xcross);
-          if((float)xx + 0.5f <= xcross) xx++;
-
-          if(xx < 0 || xx >= width || yy < 0 || yy >= height)
-            continue; // sanity check just to be on the safe side
-
-          size_t index = (size_t)yy * width + xx;
-
-          buffer[index] = 1.0f - buffer[index];
-        }
-      }
-
-      if(darktable.unmuted & DT_DEBUG_PERF)
-        dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill draw path took %0.04f sec\n", form->name,
-                 dt_get_wtime() - start2);
-      start2 = dt_get_wtime();
-
-      // we fill the inside plain
+      // all other cases: fill the inside plain
       // we don't need to deal with parts of shape outside of roi
-      xmin = fmaxf(xmin, 0);
-      xmax = fminf(xmax, width - 1);
-      ymin = fmaxf(ymin, 0);
-      ymax = fminf(ymax, height - 1);
+      const int fxmin = fmaxf(xmin, 0);
+      const int fxmax = fminf(xmax, width - 1);
+      const int fymin = fmaxf(ymin, 0);
+      const int fymax = fminf(ymax, height - 1);
 
-      for(int yy = ymin; yy <= ymax; yy++)
+      if(!_path_fill_scanline(buffer, cpoints + 2 * (nb_corner * 3), points_count - nb_corner * 3, width,
+                              height, fxmin, fxmax, fymin, fymax))
       {
-        int state = 0;
-        for(int xx = xmin; xx <= xmax; xx++)
-        {
-          size_t index = (size_t)yy * width + xx;
-          float v = buffer[index];
-          if(v > 0.5f) state = !state;
-          if(state) buffer[index] = 1.0f;
-        }
+        free(cpoints);
+        free(points);
+        free(border);
+        return 0;
       }
 
       if(darktable.unmuted & DT_DEBUG_PERF)
-        dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill fill plain took %0.04f sec\n", form->name,
+        dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill scanline fill took %0.04f sec\n", form->name,
                  dt_get_wtime() - start2);
       start2 = dt_get_wtime();
     }
@@ -2670,6 +2746,15 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
   // deal with feather if it does not lie outside of roi
   if(!path_encircles_roi)
   {
+    // collect the falloff segments first
+    int *segs = malloc(4 * sizeof(int) * MAX(border_count - (int)nb_corner * 3, 1));
+    if(segs == NULL)
+    {
+      free(points);
+      free(border);
+      return 0;
+    }
+    int nsegs = 0;
     int p0[2], p1[2];
     int last0[2] = { -100, -100 };
     int last1[2] = { -100, -100 };
@@ -2701,16 +2786,47 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
         p1[1] = border[next * 2 + 1];
       }
 
-      // and we draw the falloff
-      if(last0[0] != p0[0] || last0[1] != p0[1] || last1[0] != p1[0] || last1[1] != p1[1])
+      if(last0[0] == p0[0] && last0[1] == p0[1] && last1[0] == p1[0] && last1[1] == p1[1]) continue;
+      last0[0] = p0[0];
+      last0[1] = p0[1];
+      last1[0] = p1[0];
+      last1[1] = p1[1];
+
+      // the falloff writes one pixel next to the segment, everything farther out can't reach the roi
+      if(MAX(p0[0], p1[0]) < -1 || MIN(p0[0], p1[0]) > width || MAX(p0[1], p1[1]) < -1
+         || MIN(p0[1], p1[1]) > height)
+        continue;
+
+      segs[4 * nsegs] = p0[0];
+      segs[4 * nsegs + 1] = p0[1];
+      segs[4 * nsegs + 2] = p1[0];
+      segs[4 * nsegs + 3] = p1[1];
+      nsegs++;
+    }
+
+    // and we draw the falloff, each thread into its own horizontal bands. segments crossing several bands
+    // are walked by each of them, but every pixel is written by one thread only.
+    const int bands = MAX(1, MIN(height / 16, 4 * dt_get_num_threads()));
+    const int band_height = (height + bands - 1) / bands;
+#ifdef _OPENMP
+#if !defined(__SUNOS__) && !defined(__NetBSD__)
+#pragma omp parallel for schedule(dynamic) default(none) shared(buffer, segs, nsegs)
+#else
+#pragma omp parallel for schedule(dynamic) shared(buffer, segs, nsegs)
+#endif
+#endif
+    for(int b = 0; b < bands; b++)
+    {
+      const int y0 = b * band_height;
+      const int y1 = MIN(y0 + band_height, height);
+      for(int k = 0; k < nsegs; k++)
       {
-        _path_falloff_roi(buffer, p0, p1, width, height);
-        last0[0] = p0[0];
-        last0[1] = p0[1];
-        last1[0] = p1[0];
-        last1[1] = p1[1];
+        const int *seg = segs + 4 * k;
+        if(MAX(seg[1], seg[3]) < y0 - 1 || MIN(seg[1], seg[3]) > y1) continue;
+        _path_falloff_roi(buffer, seg, seg + 2, width, y0, y1);
       }
     }
+    free(segs);
 
     if(darktable.unmuted & DT_DEBUG_PERF)
       dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill fill falloff took %0.04f sec\n", form->name,
@@ -122,6 +122,13 @@ int dt_dev_pixelpipe_cache_available(dt_dev_pixelpipe_cache_t *cache, const uint
   return 0;
 }
 
+void *dt_dev_pixelpipe_cache_peek(dt_dev_pixelpipe_cache_t *cache, const uint64_t hash)
+{
+  for(int32_t k = 0; k < cache->entries; k++)
+    if(cache->hash[k] == hash) return cache->data[k];
+  return NULL;
+}
+
 int dt_dev_pixelpipe_cache_get_important(dt_dev_pixelpipe_cache_t *cache, const uint64_t hash,
                                          const size_t size, void **data)
 {
@@ -18,6 +18,7 @@
 */
 #include "develop/pixelpipe.h"
 #include "develop/blend.h"
+#include "develop/masks.h"
 #include "develop/tiling.h"
 #include "gui/gtk.h"
 #include "control/control.h"
@@ -115,6 +116,12 @@ int dt_dev_pixelpipe_init(dt_dev_pixelpipe_t *pipe)
   int res = dt_dev_pixelpipe_init_cached(
       pipe, 0, 5);
   pipe->type = DT_DEV_PIXELPIPE_FULL;
+  // only the darkroom center view refines progressively
+  if(res)
+  {
+    dt_dev_pixelpipe_cache_cleanup(&(pipe->coarse_cache));
+    res = dt_dev_pixelpipe_cache_init(&(pipe->coarse_cache), 4, 0);
+  }
   return res;
 }
 
@@ -126,7 +133,13 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
   pipe->processed_height = pipe->backbuf_height = pipe->iheight = 0;
   pipe->nodes = NULL;
   pipe->backbuf_size = size;
+  pipe->masks_cache = NULL;
+  pipe->coarse = 0;
+  pipe->backbuf_downscale = 1;
+  pipe->patch_valid = 0;
+  if(!dt_dev_pixelpipe_cache_init(&(pipe->coarse_cache), 0, 0)) return 0;
   if(!dt_dev_pixelpipe_cache_init(&(pipe->cache), entries, pipe->backbuf_size)) return 0;
+  pipe->masks_cache = dt_masks_cache_new((size_t)dt_conf_get_int("masks_cache_memory") * 1024 * 1024);
   pipe->cache_obsolete = 0;
   pipe->backbuf = NULL;
   pipe->processing = 0;
@@ -149,6 +162,7 @@ void dt_dev_pixelpipe_set_input(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, flo
   pipe->iscale = iscale;
   pipe->input = input;
   pipe->image = dev->image_storage;
+  pipe->patch_valid = 0;
 }
 
 void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
@@ -159,11 +173,27 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   dt_dev_pixelpipe_cleanup_nodes(pipe);
   // so now it's safe to clean up cache:
   dt_dev_pixelpipe_cache_cleanup(&(pipe->cache));
+  dt_dev_pixelpipe_cache_cleanup(&(pipe->coarse_cache));
+  dt_masks_cache_free(pipe->masks_cache);
+  pipe->masks_cache = NULL;
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
   dt_pthread_mutex_destroy(&(pipe->backbuf_mutex));
   dt_pthread_mutex_destroy(&(pipe->busy_mutex));
 }
 
+// cleanup is 0 if the data was handed over to another piece
+static void _free_piece(dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece, const int cleanup)
+{
+  // printf("cleanup module `%s'\n", piece->module->name());
+  if(cleanup) piece->module->cleanup_pipe(piece->module, pipe, piece);
+  free(piece->blendop_data);
+  piece->blendop_data = NULL;
+  free(piece->histogram);
+  piece->histogram = NULL;
+  if(piece->roi_cache) g_hash_table_destroy(piece->roi_cache);
+  free(piece);
+}
+
 void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
 {
   // FIXME: either this or all process() -> gdk mutices have to be changed!
@@ -174,26 +204,30 @@ void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
   GList *nodes = pipe->nodes;
   while(nodes)
   {
-    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
-    // printf("cleanup module `%s'\n", piece->module->name());
-    piece->module->cleanup_pipe(piece->module, pipe, piece);
-    free(piece->blendop_data);
-    piece->blendop_data = NULL;
-    free(piece->histogram);
-    piece->histogram = NULL;
-    free(piece);
+    _free_piece(pipe, (dt_dev_pixelpipe_iop_t *)nodes->data, 1);
     nodes = g_list_next(nodes);
   }
   g_list_free(pipe->nodes);
   pipe->nodes = NULL;
+  pipe->patch_valid = 0;
   dt_pthread_mutex_unlock(&pipe->busy_mutex);
 }
 
-void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
+// the piece of the same module instance in the nodes of the previous image, if its data can be taken over
+static GList *_find_donor(GList *nodes, const dt_iop_module_t *module)
+{
+  if(!(module->flags() & IOP_FLAGS_IMAGE_INDEPENDENT)) return NULL;
+  for(; nodes; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    if(piece->module->multi_priority == module->multi_priority && !strcmp(piece->module->op, module->op))
+      return nodes;
+  }
+  return NULL;
+}
+
+static void _create_nodes(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, GList **donors)
 {
-  dt_pthread_mutex_lock(&pipe->busy_mutex);
-  pipe->shutdown = 0;
-  g_assert(pipe->nodes == NULL);
   // for all modules in dev:
   GList *modules = dev->iop;
   while(modules)
@@ -221,11 +255,52 @@ void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
       piece->data = NULL;
       piece->hash = 0;
       piece->process_cl_ready = 0;
-      dt_iop_init_pipe(piece->module, pipe, piece);
+      GList *donor = donors ? _find_donor(*donors, module) : NULL;
+      if(donor)
+      {
+        // no init_pipe() and the commits of the defaults it does, and no commit at all if the params are
+        // the same as for the previous image
+        dt_dev_pixelpipe_iop_t *old = (dt_dev_pixelpipe_iop_t *)donor->data;
+        piece->data = old->data;
+        piece->blendop_data = old->blendop_data;
+        piece->commit_hash = old->commit_hash;
+        piece->process_cl_ready = old->process_cl_ready;
+        piece->adopted = 1;
+        old->blendop_data = NULL;
+        _free_piece(pipe, old, 0);
+        *donors = g_list_delete_link(*donors, donor);
+      }
+      else
+        dt_iop_init_pipe(piece->module, pipe, piece);
       pipe->nodes = g_list_append(pipe->nodes, piece);
     }
     modules = g_list_next(modules);
   }
+}
+
+void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
+{
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  pipe->shutdown = 0;
+  g_assert(pipe->nodes == NULL);
+  _create_nodes(pipe, dev, NULL);
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+}
+
+void dt_dev_pixelpipe_recreate_nodes(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
+{
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  pipe->shutdown = 0;
+  pipe->patch_valid = 0;
+  // rasters of the previous image are of no use for this one
+  dt_masks_cache_flush(pipe->masks_cache);
+  GList *donors = pipe->nodes;
+  pipe->nodes = NULL;
+  _create_nodes(pipe, dev, &donors);
+  // whatever is left wasn't taken over
+  for(GList *nodes = donors; nodes; nodes = g_list_next(nodes))
+    _free_piece(pipe, (dt_dev_pixelpipe_iop_t *)nodes->data, 1);
+  g_list_free(donors);
   dt_pthread_mutex_unlock(&pipe->busy_mutex);
 }
 
@@ -251,24 +326,34 @@ void dt_dev_pixelpipe_synch(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, GList *
 void dt_dev_pixelpipe_synch_all(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
 {
   dt_pthread_mutex_lock(&pipe->busy_mutex);
-  // call reset_params on all pieces first.
+  // every piece ends up with its last history item, or the defaults if there is none. commit that one only,
+  // instead of going through the defaults and all history items of the module.
   GList *nodes = pipe->nodes;
   while(nodes)
   {
     dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    dt_dev_history_item_t *last = NULL;
+    GList *history = dev->history;
+    for(int k = 0; k < dev->history_end && history; k++)
+    {
+      dt_dev_history_item_t *hist = (dt_dev_history_item_t *)history->data;
+      if(hist->module == piece->module) last = hist;
+      history = g_list_next(history);
+    }
     piece->hash = 0;
-    piece->enabled = piece->module->default_enabled;
-    dt_iop_commit_params(piece->module, piece->module->default_params, piece->module->default_blendop_params,
-                         pipe, piece);
+    if(last)
+    {
+      piece->enabled = last->enabled;
+      dt_iop_commit_params(last->module, last->params, last->blend_params, pipe, piece);
+    }
+    else
+    {
+      piece->enabled = piece->module->default_enabled;
+      dt_iop_commit_params(piece->module, piece->module->default_params,
+                           piece->module->default_blendop_params, pipe, piece);
+    }
     nodes = g_list_next(nodes);
   }
-  // go through all history items and adjust params
-  GList *history = dev->history;
-  for(int k = 0; k < dev->history_end && history; k++)
-  {
-    dt_dev_pixelpipe_synch(pipe, dev, history);
-    history = g_list_next(history);
-  }
   dt_pthread_mutex_unlock(&pipe->busy_mutex);
 }
 
@@ -705,6 +790,85 @@ static void pixelpipe_picker_cl(int devid, dt_iop_module_t *module, cl_mem img,
 #endif
 
 
+// the display histogram (every 4th pixel of the 8-bit output inside box) and the counts of the waveform (all of
+// the float input) in a single traversal. every thread works on a stripe of columns, which for the waveform are
+// snapped to its bins, so the threads never count into the same waveform bins and only the small display
+// histogram needs a copy per thread.
+static inline int _waveform_bin(const int x, const double bin_width, const int ww)
+{
+  return (int)MIN(x / bin_width, ww - 1);
+}
+
+static void _final_histograms(dt_develop_t *dev, const uint8_t *const out, const dt_iop_roi_t *const roi_out,
+                              const int *const box, const float *const in, const dt_iop_roi_t *const roi_in,
+                              uint32_t *const waveform)
+{
+  const int nthreads = dt_get_num_threads();
+  uint32_t *partial = (uint32_t *)calloc((size_t)nthreads * 4 * 64, sizeof(uint32_t));
+  if(!partial) return;
+
+  // 1.0 is at 8/9 of the height!
+  const int ww = dev->histogram_waveform_width;
+  const double bin_width = waveform ? (double)(roi_in->width) / (double)ww : 1.0,
+               _height = (double)(dev->histogram_waveform_height - 1);
+  const int rows = MAX(roi_out->height, waveform ? roi_in->height : 0);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1)
+#endif
+  for(int t = 0; t < nthreads; t++)
+  {
+    uint32_t *const hist = partial + (size_t)4 * 64 * t;
+    // display histogram: every 4th column from box[0], inside this stripe
+    const int o0 = (int)((size_t)roi_out->width * t / nthreads), o1 = (int)((size_t)roi_out->width * (t + 1) / nthreads);
+    const int i0 = box[0] + ((MAX(o0, box[0]) - box[0] + 3) / 4) * 4, i1 = MIN(o1, box[2] + 1);
+    // waveform: whole bins only
+    int x0 = (int)((size_t)roi_in->width * t / nthreads), x1 = (int)((size_t)roi_in->width * (t + 1) / nthreads);
+    if(waveform)
+    {
+      while(x0 > 0 && x0 < roi_in->width
+            && _waveform_bin(x0, bin_width, ww) == _waveform_bin(x0 - 1, bin_width, ww))
+        x0++;
+      while(x1 > 0 && x1 < roi_in->width
+            && _waveform_bin(x1, bin_width, ww) == _waveform_bin(x1 - 1, bin_width, ww))
+        x1++;
+    }
+
+    for(int y = 0; y < rows; y++)
+    {
+      if(y >= box[1] && y <= box[3] && y < roi_out->height && (y - box[1]) % 4 == 0)
+        for(int i = i0; i < i1; i += 4)
+        {
+          const uint8_t *const px = out + 4 * ((size_t)y * roi_out->width + i);
+          uint8_t rgb[3];
+          for(int k = 0; k < 3; k++) rgb[k] = px[2 - k] >> 2;
+
+          for(int k = 0; k < 3; k++) hist[4 * rgb[k] + k]++;
+          const uint8_t lum = MAX(MAX(rgb[0], rgb[1]), rgb[2]);
+          hist[4 * lum + 3]++;
+        }
+
+      if(waveform && y < roi_in->height)
+        for(int x = x0; x < x1; x++)
+        {
+          const float *const px = in + 4 * ((size_t)y * roi_in->width + x);
+          const int out_x = _waveform_bin(x, bin_width, ww);
+          for(int k = 0; k < 3; k++)
+          {
+            const float v = isnan(px[2 - k]) ? 0.0f : px[2 - k]; // catch NaNs as they don't convert well to integers
+            const int out_y = CLAMP(1.0 - (8.0 / 9.0) * v, 0.0, 1.0) * _height;
+            waveform[out_y * ww * 3 + out_x * 3 + k]++;
+          }
+        }
+    }
+  }
+
+  memset(dev->histogram, 0, sizeof(uint32_t) * 4 * 64);
+  for(int t = 0; t < nthreads; t++)
+    for(int k = 0; k < 4 * 64; k++) dev->histogram[k] += partial[(size_t)4 * 64 * t + k];
+  free(partial);
+}
+
 // recursive helper for process:
 static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output,
                                         void **cl_mem_output, int *out_bpp, const dt_iop_roi_t *roi_out,
@@ -2127,63 +2291,28 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
         box[2] = roi_out->width - 1;
         box[3] = roi_out->height - 1;
       }
-      dev->histogram_max = 0;
-      memset(dev->histogram, 0, sizeof(uint32_t) * 4 * 64);
-      for(int j = box[1]; j <= box[3]; j += 4)
-        for(int i = box[0]; i <= box[2]; i += 4)
-        {
-          uint8_t rgb[3];
-          for(int k = 0; k < 3; k++) rgb[k] = pixel[4 * j * roi_out->width + 4 * i + 2 - k] >> 2;
-
-          for(int k = 0; k < 3; k++) dev->histogram[4 * rgb[k] + k]++;
-          uint8_t lum = MAX(MAX(rgb[0], rgb[1]), rgb[2]);
-          dev->histogram[4 * lum + 3]++;
-        }
+      // the waveform is drawn pixel by pixel, so it has to be done in the correct size (thus the weird gui
+      // stuff :(). and it HAS to be done on the float input data, otherwise we get really ugly artefacts due to
+      // rounding issues when putting colors into the bins.
+      uint32_t *buf = NULL;
+      if(dev->histogram_waveform_width != 0 && input)
+      {
+        buf = (uint32_t *)calloc(dev->histogram_waveform_height * dev->histogram_waveform_width * 3,
+                                 sizeof(uint32_t));
+        memset(dev->histogram_waveform, 0,
+               sizeof(uint32_t) * dev->histogram_waveform_height * dev->histogram_waveform_stride / 4);
+      }
+      const int ibox[4] = { box[0], box[1], box[2], box[3] };
+      _final_histograms(dev, pixel, roi_out, ibox, (const float *)input, &roi_in, buf);
 
       // don't count <= 0 pixels
+      dev->histogram_max = 0;
       for(int k = 19; k < 4 * 64; k += 4)
         dev->histogram_max = dev->histogram_max > dev->histogram[k] ? dev->histogram_max : dev->histogram[k];
 
-      // calculate the waveform histogram. since this is drawn pixel by pixel we have to do it in the correct
-      // size (thus the weird gui stuff :().
-      // this HAS to be done on the float input data, otherwise we get really ugly artefacts due to rounding
-      // issues when putting colors into the bins.
       //       dt_pthread_mutex_lock(&dev->histogram_waveform_mutex);
-      if(dev->histogram_waveform_width != 0 && input)
+      if(buf)
       {
-        uint32_t *buf = (uint32_t *)calloc(dev->histogram_waveform_height * dev->histogram_waveform_width * 3,
-                                           sizeof(uint32_t));
-        memset(dev->histogram_waveform, 0,
-               sizeof(uint32_t) * dev->histogram_waveform_height * dev->histogram_waveform_stride / 4);
-
-        // 1.0 is at 8/9 of the height!
-        const double bin_width = (double)(roi_in.width) / (double)dev->histogram_waveform_width,
-                     _height = (double)(dev->histogram_waveform_height - 1);
-        float *pixel = (float *)input;
-        //         uint32_t mincol[3] = {UINT32_MAX,UINT32_MAX,UINT32_MAX}, maxcol[3] = {0,0,0};
-
-        // count the colors into buf ...
-        for(int y = 0; y < roi_in.height; y++)
-        {
-          for(int x = 0; x < roi_in.width; x++)
-          {
-            float rgb[3];
-            for(int k = 0; k < 3; k++) rgb[k] = pixel[4 * y * roi_in.width + 4 * x + 2 - k];
-
-            const int out_x = MIN(x / bin_width, dev->histogram_waveform_width - 1);
-            for(int k = 0; k < 3; k++)
-            {
-              const float v = isnan(rgb[k]) ? 0.0f
-                                            : rgb[k]; // catch NaNs as they don't convert well to integers
-              const int out_y = CLAMP(1.0 - (8.0 / 9.0) * v, 0.0, 1.0) * _height;
-              uint32_t *const out = buf + (out_y * dev->histogram_waveform_width * 3 + out_x * 3 + k);
-              (*out)++;
-              //               mincol[k] = MIN(mincol[k], *out);
-              //               maxcol[k] = MAX(maxcol[k], *out);
-            }
-          }
-        }
-
         // TODO: Find a nicer function to map buf -> image than just clipping
         //         float factor[3];
         //         for(int k = 0; k < 3; k++)
@@ -2329,6 +2458,373 @@ static int dt_dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe, d
 }
 
 
+/* incremental rendering of local edits: modules which implement dirty_rect() (spot removal, ..) say which part
+   of their output an edit touched. if the rest of the pipe is as it was for the last complete output, only
+   that part, mapped through the distortions downstream and grown by the filter margins of all modules, is
+   rendered again and pasted into a copy of the old output. */
+
+// on top of the overlap the modules ask for, in output pixels
+#define DT_DEV_PATCH_MARGIN 16
+
+static void _patch_rect_union(dt_iop_roi_t *a, const dt_iop_roi_t *b)
+{
+  if(b->width <= 0 || b->height <= 0) return;
+  if(a->width <= 0 || a->height <= 0)
+  {
+    *a = *b;
+    return;
+  }
+  const int x1 = MAX(a->x + a->width, b->x + b->width), y1 = MAX(a->y + a->height, b->y + b->height);
+  a->x = MIN(a->x, b->x);
+  a->y = MIN(a->y, b->y);
+  a->width = x1 - a->x;
+  a->height = y1 - a->y;
+}
+
+// grow by margin and clip to width x height
+static void _patch_rect_grow(dt_iop_roi_t *r, const int margin, const int width, const int height)
+{
+  const int x0 = MAX(r->x - margin, 0), y0 = MAX(r->y - margin, 0);
+  const int x1 = MIN(r->x + r->width + margin, width), y1 = MIN(r->y + r->height + margin, height);
+  r->x = x0;
+  r->y = y0;
+  r->width = MAX(x1 - x0, 0);
+  r->height = MAX(y1 - y0, 0);
+}
+
+// where a rect of the output of module (pipe coordinates at scale 1) ends up in the output at roi
+static int _patch_map_rect(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, const dt_iop_module_t *module,
+                           const dt_iop_roi_t *rect, const dt_iop_roi_t *roi, dt_iop_roi_t *out)
+{
+  const int steps = 8; // points per edge
+  float points[2 * 4 * 8];
+  const float x0 = rect->x, y0 = rect->y, x1 = rect->x + rect->width, y1 = rect->y + rect->height;
+  for(int k = 0; k < steps; k++)
+  {
+    const float t = (float)k / steps;
+    float *p = points + 8 * k;
+    p[0] = x0 + t * (x1 - x0); // top
+    p[1] = y0;
+    p[2] = x1; // right
+    p[3] = y0 + t * (y1 - y0);
+    p[4] = x1 - t * (x1 - x0); // bottom
+    p[5] = y1;
+    p[6] = x0; // left
+    p[7] = y1 - t * (y1 - y0);
+  }
+  if(!dt_dev_distort_transform_plus(dev, pipe, module->priority + 1, 99999, points, 4 * steps)) return 1;
+
+  float xmin = FLT_MAX, ymin = FLT_MAX, xmax = -FLT_MAX, ymax = -FLT_MAX;
+  for(int k = 0; k < 4 * steps; k++)
+  {
+    xmin = fminf(xmin, points[2 * k]);
+    xmax = fmaxf(xmax, points[2 * k]);
+    ymin = fminf(ymin, points[2 * k + 1]);
+    ymax = fmaxf(ymax, points[2 * k + 1]);
+  }
+  out->x = floorf(xmin * roi->scale) - roi->x;
+  out->y = floorf(ymin * roi->scale) - roi->y;
+  out->width = ceilf(xmax * roi->scale) - roi->x - out->x;
+  out->height = ceilf(ymax * roi->scale) - roi->y - out->y;
+  out->scale = roi->scale;
+  return 0;
+}
+
+// ask the modules what changed since the last run. done on every run of the full pipe, so that their idea of
+// the last run stays in step with ours.
+static void _patch_collect(dt_dev_pixelpipe_t *pipe)
+{
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  for(GList *nodes = pipe->nodes; nodes && !pipe->shutdown; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    if(!piece->enabled || !piece->module->dirty_rect) continue;
+    dt_iop_roi_t rect = { 0, 0, 0, 0, 1.0f };
+    if(piece->module->dirty_rect(piece->module, piece, &rect))
+      _patch_rect_union(&piece->patch_dirty, &rect);
+    else
+      piece->patch_unknown = 1;
+  }
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+}
+
+// the part of the output at roi which has to be rendered again (relative to roi, possibly empty) and the
+// margin needed around it. returns non-zero if everything has to be rendered.
+static int _patch_region(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, const dt_iop_roi_t *roi,
+                         dt_iop_roi_t *region, int *margin)
+{
+  if(pipe->type != DT_DEV_PIXELPIPE_FULL || pipe->coarse || !pipe->patch_valid) return 1;
+  if(memcmp(roi, &pipe->patch_roi, sizeof(dt_iop_roi_t))) return 1;
+  // with modules filtered out for editing, the distortions below don't match the output
+  if(dev->gui_module && dev->gui_module->operation_tags_filter()) return 1;
+
+  dt_iop_roi_t dirty = { 0, 0, 0, 0, roi->scale };
+  int m = DT_DEV_PATCH_MARGIN;
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  int res = pipe->shutdown;
+  for(GList *nodes = pipe->nodes; nodes && !res; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    dt_iop_module_t *module = piece->module;
+    if(piece->enabled != piece->patch_enabled)
+      res = 1;
+    else if(!piece->enabled)
+      continue;
+    // the patch is rendered like any other region of interest, that only works out if all modules are local
+    else if(!(module->flags() & (IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ALLOW_PATCHING)))
+      res = 1;
+    // histograms would only see the patch
+    else if(piece->request_histogram & DT_REQUEST_ON)
+      res = 1;
+    else if(piece->patch_unknown || (piece->hash != piece->patch_hash && !module->dirty_rect))
+      res = 1;
+    else
+    {
+      if(piece->patch_dirty.width > 0 && piece->patch_dirty.height > 0)
+      {
+        dt_iop_roi_t rect;
+        res = _patch_map_rect(pipe, dev, module, &piece->patch_dirty, roi, &rect);
+        _patch_rect_union(&dirty, &rect);
+      }
+      dt_develop_tiling_t tiling = { 0 };
+      module->tiling_callback(module, piece, roi, roi, &tiling);
+      m += tiling.overlap;
+    }
+  }
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  if(res) return 1;
+
+  // changes spread by the filter margins downstream
+  if(dirty.width > 0 && dirty.height > 0) _patch_rect_grow(&dirty, m, roi->width, roi->height);
+  // not worth it any more
+  if((size_t)2 * dirty.width * dirty.height > (size_t)roi->width * roi->height) return 1;
+  *region = dirty;
+  *margin = m;
+  return 0;
+}
+
+// hash and bpp of the cache line dt_dev_pixelpipe_process_rec() leaves its output in.
+static uint64_t _patch_output_hash(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, const dt_iop_roi_t *roi,
+                                   GList *modules, GList *pieces, int pos, int *bpp)
+{
+  // skipped modules at the end pass the buffer of the one before through
+  while(modules)
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
+    if(piece->enabled
+       && !(dev->gui_module && dev->gui_module->operation_tags_filter() & module->operation_tags()))
+      break;
+    modules = g_list_previous(modules);
+    pieces = g_list_previous(pieces);
+    pos--;
+  }
+  *bpp = get_output_bpp(modules ? (dt_iop_module_t *)modules->data : NULL, pipe,
+                        pieces ? (dt_dev_pixelpipe_iop_t *)pieces->data : NULL, dev);
+  return dt_dev_pixelpipe_cache_hash(pipe->image.id, roi, pipe, pos);
+}
+
+// remember the output of a complete run of the full pipe as the base for the next patches.
+static void _patch_record(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, const dt_iop_roi_t *roi, GList *modules,
+                          GList *pieces, int pos)
+{
+  int bpp;
+  pipe->patch_hash = _patch_output_hash(pipe, dev, roi, modules, pieces, pos, &bpp);
+  pipe->patch_roi = *roi;
+  pipe->patch_valid = !(dev->gui_module && dev->gui_module->operation_tags_filter());
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    piece->patch_hash = piece->hash;
+    piece->patch_enabled = piece->enabled;
+    piece->patch_dirty = (dt_iop_roi_t){ 0, 0, 0, 0, 1.0f };
+    piece->patch_unknown = 0;
+  }
+}
+
+// render the part of the output local edits touched, with margins, and paste it into a copy of the last
+// complete output. returns -1 if everything has to be rendered, otherwise like dt_dev_pixelpipe_process_rec().
+static int _process_patch(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output, void **cl_mem_output,
+                          int *out_bpp, const dt_iop_roi_t *roi, GList *modules, GList *pieces, int pos)
+{
+  dt_iop_roi_t region;
+  int margin;
+  if(_patch_region(pipe, dev, roi, &region, &margin)) return -1;
+
+  int bpp;
+  const uint64_t hash = _patch_output_hash(pipe, dev, roi, modules, pieces, pos, &bpp);
+  const size_t size = (size_t)bpp * roi->width * roi->height;
+
+  // the old output may well be pushed out of the cache while rendering the patch, so copy it first
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  // nothing to gain if the new one is cached already
+  const void *old = (pipe->shutdown || dt_dev_pixelpipe_cache_available(&(pipe->cache), hash))
+                        ? NULL
+                        : dt_dev_pixelpipe_cache_peek(&(pipe->cache), pipe->patch_hash);
+  uint8_t *copy = old ? (uint8_t *)dt_alloc_align(16, size) : NULL;
+  if(copy) memcpy(copy, old, size);
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  if(!copy) return -1;
+
+  dt_times_t start;
+  dt_get_times(&start);
+  if(region.width > 0 && region.height > 0)
+  {
+    // render the margins around it, too, so that the region itself doesn't see the borders
+    dt_iop_roi_t rroi = region;
+    _patch_rect_grow(&rroi, margin, roi->width, roi->height);
+    const int px = region.x - rroi.x, py = region.y - rroi.y;
+    rroi.x += roi->x;
+    rroi.y += roi->y;
+    rroi.scale = roi->scale;
+
+    void *patch = NULL;
+    const int err = dt_dev_pixelpipe_process_rec_and_backcopy(pipe, dev, &patch, cl_mem_output, out_bpp, &rroi,
+                                                              modules, pieces, pos);
+    if(err)
+    {
+      dt_free_align(copy);
+      return err;
+    }
+    for(int j = 0; j < region.height; j++)
+      memcpy(copy + (size_t)bpp * ((size_t)(region.y + j) * roi->width + region.x),
+             (uint8_t *)patch + (size_t)bpp * ((size_t)(py + j) * rroi.width + px), (size_t)bpp * region.width);
+  }
+
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  if(pipe->shutdown)
+  {
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    dt_free_align(copy);
+    return 1;
+  }
+  (void)dt_dev_pixelpipe_cache_get_important(&(pipe->cache), hash, size, output);
+  memcpy(*output, copy, size);
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  dt_free_align(copy);
+  *out_bpp = bpp;
+
+  dt_show_times(&start, "[dev_pixelpipe]", "patching %dx%d of %dx%d [%s]", region.width, region.height,
+                roi->width, roi->height, _pipe_type_to_str(pipe->type));
+  return 0;
+}
+
+int dt_dev_pixelpipe_can_patch(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width, int height,
+                               float scale)
+{
+  const dt_iop_roi_t roi = (dt_iop_roi_t){ x, y, width, height, scale };
+  dt_iop_roi_t region;
+  int margin;
+  _patch_collect(pipe);
+  return !_patch_region(pipe, dev, &roi, &region, &margin);
+}
+
+/* the preview pipe starts from the downscaled mip f, the full pipe from the raw itself. when the center view is
+   zoomed to fit, the full pipe has done the same work on the whole image already, only at a higher
+   resolution. if one of its cached buffers matches a stage of the preview pipe, that is downsampled into the
+   preview cache, so the preview only has to run the modules after it. */
+
+// modules which have to run in the preview pipe itself, for pickers, histograms and gui data
+static int _preview_only(dt_develop_t *dev, dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_module_t *module = piece->module;
+  return (piece->request_histogram & DT_REQUEST_ON) || module->request_color_pick != DT_REQUEST_COLORPICK_OFF
+         || module->request_mask_display || (module->flags() & IOP_FLAGS_PREVIEW_SIDE_EFFECTS);
+}
+
+// roi covers all of the output of piece
+static int _full_frame(const dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *roi)
+{
+  return roi->x == 0 && roi->y == 0 && roi->width >= (int)(piece->buf_out.width * roi->scale) - 1
+         && roi->height >= (int)(piece->buf_out.height * roi->scale) - 1;
+}
+
+static void _preview_from_full(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, const dt_iop_roi_t *roi,
+                               GList *modules, GList *pieces, int pos)
+{
+  dt_dev_pixelpipe_t *full = dev->pipe;
+  if(!dev->gui_attached || pipe != dev->preview_pipe || !full) return;
+  if(!dt_conf_get_bool("plugins/darkroom/share_intermediates")) return;
+  // the full pipe is processing, its cache lines may be half written
+  if(dt_pthread_mutex_trylock(&dev->pipe_mutex)) return;
+  dt_pthread_mutex_lock(&full->busy_mutex);
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+
+  const int nodes = g_list_length(pipe->nodes);
+  if(full->shutdown || pipe->shutdown || !full->patch_valid || full->image.id != pipe->image.id
+     || g_list_length(full->nodes) != nodes || nodes != pos)
+    goto done;
+
+  // stages at or after the first module which has to run here can't be taken over
+  int first = pos + 1, k = 1;
+  for(GList *l = pipe->nodes; l; l = g_list_next(l), k++)
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)l->data;
+    if(piece->enabled && _preview_only(dev, piece))
+    {
+      first = k;
+      break;
+    }
+  }
+
+  // follow both pipes down from their outputs, as dt_dev_pixelpipe_process_rec() does
+  const dt_iop_roi_t zero = { 0, 0, 0, 0, 0.0f };
+  dt_iop_roi_t proi = *roi, froi = full->patch_roi;
+  GList *fpieces = g_list_last(full->nodes);
+  for(; modules && pos > 0; modules = g_list_previous(modules), pieces = g_list_previous(pieces),
+                            fpieces = g_list_previous(fpieces), pos--)
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
+    dt_dev_pixelpipe_iop_t *fpiece = (dt_dev_pixelpipe_iop_t *)fpieces->data;
+    if(!piece->enabled
+       || (dev->gui_module && dev->gui_module->operation_tags_filter() & module->operation_tags()))
+      continue;
+
+    if(pos < first && get_output_bpp(module, pipe, piece, dev) == 4 * sizeof(float)
+       && get_output_bpp(module, full, fpiece, dev) == 4 * sizeof(float))
+    {
+      const uint64_t hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, &proi, pipe, pos);
+      // the preview will find that on its own
+      if(dt_dev_pixelpipe_cache_available(&(pipe->cache), hash)) break;
+
+      // same modules with the same parameters up to here?
+      if(dt_dev_pixelpipe_cache_hash(pipe->image.id, &zero, pipe, pos)
+         == dt_dev_pixelpipe_cache_hash(pipe->image.id, &zero, full, pos)
+         && _full_frame(piece, &proi) && _full_frame(fpiece, &froi) && proi.width <= froi.width)
+      {
+        const float *fbuf = (const float *)dt_dev_pixelpipe_cache_peek(
+            &(full->cache), dt_dev_pixelpipe_cache_hash(pipe->image.id, &froi, full, pos));
+        if(fbuf)
+        {
+          void *buf = NULL;
+          (void)dt_dev_pixelpipe_cache_get(&(pipe->cache), hash, 4 * sizeof(float) * proi.width * proi.height,
+                                           &buf);
+          const dt_iop_roi_t roi_in = { 0, 0, froi.width, froi.height, 1.0f };
+          const dt_iop_roi_t roi_out = { 0, 0, proi.width, proi.height, proi.width / (float)froi.width };
+          dt_iop_clip_and_zoom((float *)buf, fbuf, &roi_out, &roi_in, proi.width, froi.width);
+          for(int c = 0; c < 3; c++) piece->processed_maximum[c] = fpiece->processed_maximum[c];
+          dt_print(DT_DEBUG_DEV, "[pixelpipe_process] [preview] taking over the full pipe up to %s\n",
+                   module->op);
+          break;
+        }
+      }
+    }
+
+    // on to the input of this module
+    dt_iop_roi_t roi_in;
+    module->modify_roi_in(module, piece, &proi, &roi_in);
+    proi = roi_in;
+    module->modify_roi_in(module, fpiece, &froi, &roi_in);
+    froi = roi_in;
+  }
+
+done:
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  dt_pthread_mutex_unlock(&full->busy_mutex);
+  dt_pthread_mutex_unlock(&dev->pipe_mutex);
+}
+
 int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width, int height,
                              float scale)
 {
@@ -2357,6 +2853,8 @@ int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x,
   GList *modules = g_list_last(dev->iop);
   GList *pieces = g_list_last(pipe->nodes);
 
+  if(pipe->type == DT_DEV_PIXELPIPE_FULL) _patch_collect(pipe);
+
 // re-entry point: in case of late opencl errors we start all over again with opencl-support disabled
 restart:
 
@@ -2367,6 +2865,8 @@ restart:
   if(pipe->cache_obsolete) dt_dev_pixelpipe_cache_flush(&(pipe->cache));
   pipe->cache_obsolete = 0;
 
+  if(pipe->type == DT_DEV_PIXELPIPE_PREVIEW) _preview_from_full(pipe, dev, &roi, modules, pieces, pos);
+
   // mask display off as a starting point
   pipe->mask_display = 0;
 
@@ -2374,9 +2874,11 @@ restart:
   void *cl_mem_out = NULL;
   int out_bpp;
 
-  // run pixelpipe recursively and get error status
-  int err = dt_dev_pixelpipe_process_rec_and_backcopy(pipe, dev, &buf, &cl_mem_out, &out_bpp, &roi, modules,
-                                                      pieces, pos);
+  // run pixelpipe recursively and get error status. only the parts touched by local edits, if possible.
+  int err = _process_patch(pipe, dev, &buf, &cl_mem_out, &out_bpp, &roi, modules, pieces, pos);
+  if(err < 0)
+    err = dt_dev_pixelpipe_process_rec_and_backcopy(pipe, dev, &buf, &cl_mem_out, &out_bpp, &roi, modules,
+                                                    pieces, pos);
 
   // get status summary of opencl queue by checking the eventlist
   int oclerr = (pipe->devid >= 0) ? (dt_opencl_events_flush(pipe->devid, 1) != 0) : 0;
@@ -2433,16 +2935,43 @@ restart:
   pipe->backbuf = buf;
   pipe->backbuf_width = width;
   pipe->backbuf_height = height;
+  pipe->backbuf_downscale = MAX(pipe->coarse, 1);
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
 
+  if(pipe->type == DT_DEV_PIXELPIPE_FULL && !pipe->coarse) _patch_record(pipe, dev, &roi, modules, pieces, pos);
+
   // printf("pixelpipe homebrew process end\n");
   pipe->processing = 0;
   return 0;
 }
 
+int dt_dev_pixelpipe_process_coarse(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width,
+                                    int height, float scale, int downscale)
+{
+  // the pass runs on the coarse cache, so that it doesn't push out the buffers the full size pass is going to
+  // need. the caches are only ever touched by the thread processing the pipe, so swapping them is fine.
+  if(pipe->cache_obsolete)
+  {
+    // the flag is consumed by the coarse cache below, so do the full size one here
+    dt_dev_pixelpipe_cache_flush(&(pipe->cache));
+  }
+  const dt_dev_pixelpipe_cache_t cache = pipe->cache;
+  pipe->cache = pipe->coarse_cache;
+  pipe->coarse = downscale;
+
+  const int err = dt_dev_pixelpipe_process(pipe, dev, x / downscale, y / downscale, width / downscale,
+                                           height / downscale, scale / downscale);
+
+  pipe->coarse = 0;
+  pipe->coarse_cache = pipe->cache;
+  pipe->cache = cache;
+  return err;
+}
+
 void dt_dev_pixelpipe_flush_caches(dt_dev_pixelpipe_t *pipe)
 {
   dt_dev_pixelpipe_cache_flush(&pipe->cache);
+  dt_dev_pixelpipe_cache_flush(&pipe->coarse_cache);
 }
 
 void dt_dev_pixelpipe_get_dimensions(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int width_in,
@@ -32,6 +32,7 @@
  * will be freed at the end.
  */
 struct dt_iop_module_t;
+struct dt_masks_cache_t;
 
 /** region of interest */
 typedef struct dt_iop_roi_t
@@ -63,6 +64,14 @@ typedef struct dt_dev_pixelpipe_iop_t
       buf_out;                // theoretical full buffer regions of interest, as passed through modify_roi_out
   int process_cl_ready;       // set this to 0 in commit_params to temporarily disable the use of process_cl
   float processed_maximum[3]; // sensor saturation after this iop, used internally for caching
+  GHashTable *roi_cache;      // tile roi fits of the tiling code, see tiling.c
+  // state of the last complete output, for patching local edits into it. see dt_dev_pixelpipe_process()
+  uint64_t patch_hash;      // hash and enabled state the output was rendered with
+  int patch_enabled;
+  dt_iop_roi_t patch_dirty; // union of what dirty_rect() reported since, at scale 1
+  int patch_unknown;        // dirty_rect() didn't know
+  uint64_t commit_hash;     // params, blend params and masks data was last committed with
+  int adopted;              // data was handed over from the previous image, see dt_dev_pixelpipe_recreate_nodes()
 } dt_dev_pixelpipe_iop_t;
 
 typedef enum dt_dev_pixelpipe_change_t
@@ -85,6 +94,10 @@ typedef struct dt_dev_pixelpipe_t
 {
   // store history/zoom caches
   dt_dev_pixelpipe_cache_t cache;
+  // separate cache for the low resolution passes of progressive refinement
+  dt_dev_pixelpipe_cache_t coarse_cache;
+  // non-zero while processing such a coarse pass: output is that many times smaller than requested
+  int coarse;
   // set to non-zero in order to obsolete old cache entries on next pixelpipe run
   int cache_obsolete;
   // input buffer
@@ -105,6 +118,8 @@ typedef struct dt_dev_pixelpipe_t
   uint8_t *backbuf;
   size_t backbuf_size;
   int backbuf_width, backbuf_height;
+  // backbuf is a coarse pass, to be magnified by this factor for display
+  int backbuf_downscale;
   uint64_t backbuf_hash;
   dt_pthread_mutex_t backbuf_mutex, busy_mutex;
   // working?
@@ -128,6 +143,12 @@ typedef struct dt_dev_pixelpipe_t
   int devid;
   // image struct as it was when the pixelpipe was initialized. copied to avoid race conditions.
   dt_image_t image;
+  // rasterised masks of this pipe, see dt_masks_get_mask_roi()
+  struct dt_masks_cache_t *masks_cache;
+  // the last complete output of the full pipe, local edits only re-render their part of it
+  int patch_valid;
+  dt_iop_roi_t patch_roi;
+  uint64_t patch_hash; // its cache line
 } dt_dev_pixelpipe_t;
 
 struct dt_develop_t;
@@ -167,6 +188,10 @@ void dt_dev_pixelpipe_change(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev)
 void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe);
 // sync with develop_t history stack from scratch (new node added, have to pop old ones)
 void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
+// replace the nodes by new ones for the modules of dev, for the next image of an export. pieces of image
+// independent modules take over the data of the same module instance of the old nodes, so they don't need to
+// be committed again if the params didn't change. the modules of the old nodes have to be still alive.
+void dt_dev_pixelpipe_recreate_nodes(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
 // sync with develop_t history stack by just copying the top item params (same op, new params on top)
 void dt_dev_pixelpipe_synch_all(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
 // adjust gegl:nop output node according to history stack (history pop event)
@@ -175,6 +200,14 @@ void dt_dev_pixelpipe_synch_top(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *d
 // process region of interest of pixels. returns 1 if pipe was altered during processing.
 int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y, int width,
                              int height, float scale);
+// returns non-zero if the next dt_dev_pixelpipe_process() for this region only has to render the parts local
+// edits touched since the last one.
+int dt_dev_pixelpipe_can_patch(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y, int width,
+                               int height, float scale);
+// same, but render at 1/downscale of the requested size, for a quick first look at an edit. the backbuf then
+// has to be magnified by backbuf_downscale. uses its own cache, the full size buffers stay untouched.
+int dt_dev_pixelpipe_process_coarse(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y,
+                                    int width, int height, float scale, int downscale);
 // convenience method that does not gamma-compress the image.
 int dt_dev_pixelpipe_process_no_gamma(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y,
                                       int width, int height, float scale);
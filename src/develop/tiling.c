@@ -29,6 +29,7 @@
 #include <math.h>
 #include <unistd.h>
 #include <assert.h>
+#include <float.h>
 
 #define CLAMPI(a, mn, mx) ((a) < (mn) ? (mn) : ((a) > (mx) ? (mx) : (a)))
 
@@ -539,8 +540,8 @@ static int _nm_fit_output_to_input_roi(struct dt_iop_module_t *self, struct dt_d
 /* find a matching oroi_full by probing start value of oroi and get corresponding input roi into iroi_probe.
    We search in two steps. first by a simplicistic iterative search which will succeed in most cases.
    If this does not converge, we do a downhill simplex (nelder-mead) fitting */
-static int _fit_output_to_input_roi(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
-                                    const dt_iop_roi_t *iroi, dt_iop_roi_t *oroi, int delta, int iter)
+static int _search_output_to_input_roi(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                                       const dt_iop_roi_t *iroi, dt_iop_roi_t *oroi, int delta, int iter)
 {
   dt_iop_roi_t iroi_probe = *iroi;
   dt_iop_roi_t save_oroi = *oroi;
@@ -579,6 +580,128 @@ static int _fit_output_to_input_roi(struct dt_iop_module_t *self, struct dt_dev_
 }
 
 
+/* tile fits are remembered per piece, so that the next export or zoom level with the same tiles does not
+   have to search again. the key holds everything a module's modify_roi_in() depends on: its parameters (via
+   the piece hash), the full buffers and the input roi we look for. */
+typedef struct _roi_cache_key_t
+{
+  uint64_t hash;
+  dt_iop_roi_t buf_in, buf_out;
+  dt_iop_roi_t iroi;
+  float oscale;
+} _roi_cache_key_t;
+
+#define DT_TILING_ROI_CACHE_SIZE 512
+
+static guint _roi_cache_key_hash(gconstpointer key)
+{
+  const unsigned char *str = (const unsigned char *)key;
+  guint hash = 5381;
+  for(size_t i = 0; i < sizeof(_roi_cache_key_t); i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash;
+}
+
+static gboolean _roi_cache_key_equal(gconstpointer a, gconstpointer b)
+{
+  return !memcmp(a, b, sizeof(_roi_cache_key_t));
+}
+
+static void _roi_cache_key_init(_roi_cache_key_t *key, const struct dt_dev_pixelpipe_iop_t *piece,
+                                const dt_iop_roi_t *iroi, const float oscale)
+{
+  // clear padding, the key is hashed and compared bytewise
+  memset(key, 0, sizeof(_roi_cache_key_t));
+  key->hash = piece->hash;
+  key->buf_in = piece->buf_in;
+  key->buf_out = piece->buf_out;
+  key->iroi = *iroi;
+  key->oscale = oscale;
+}
+
+static int _roi_error(const dt_iop_roi_t *a, const dt_iop_roi_t *b)
+{
+  return _max(_max(abs(a->x - b->x), abs(a->y - b->y)),
+              _max(abs(a->width - b->width), abs(a->height - b->height)));
+}
+
+/* estimate the output region of an input tile by mapping points along its border forward with
+   distort_transform(). modules without distortion have the identity there, for them this only rescales. */
+static void _sample_output_roi(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                               const dt_iop_roi_t *iroi, dt_iop_roi_t *oroi)
+{
+  const int steps = 8; // points per edge
+  float points[2 * 4 * 8];
+  const float x0 = iroi->x / iroi->scale, y0 = iroi->y / iroi->scale;
+  const float x1 = (iroi->x + iroi->width) / iroi->scale, y1 = (iroi->y + iroi->height) / iroi->scale;
+  for(int k = 0; k < steps; k++)
+  {
+    const float t = (float)k / steps;
+    float *p = points + 8 * k;
+    p[0] = x0 + t * (x1 - x0); // top
+    p[1] = y0;
+    p[2] = x1; // right
+    p[3] = y0 + t * (y1 - y0);
+    p[4] = x1 - t * (x1 - x0); // bottom
+    p[5] = y1;
+    p[6] = x0; // left
+    p[7] = y1 - t * (y1 - y0);
+  }
+  if(!self->distort_transform(self, piece, points, 4 * steps)) return;
+
+  float xmin = FLT_MAX, ymin = FLT_MAX, xmax = -FLT_MAX, ymax = -FLT_MAX;
+  for(int k = 0; k < 4 * steps; k++)
+  {
+    xmin = fminf(xmin, points[2 * k]);
+    xmax = fmaxf(xmax, points[2 * k]);
+    ymin = fminf(ymin, points[2 * k + 1]);
+    ymax = fmaxf(ymax, points[2 * k + 1]);
+  }
+  oroi->x = _max(0, floorf(xmin * oroi->scale));
+  oroi->y = _max(0, floorf(ymin * oroi->scale));
+  oroi->width = _max(1, ceilf(xmax * oroi->scale) - oroi->x);
+  oroi->height = _max(1, ceilf(ymax * oroi->scale) - oroi->y);
+}
+
+/* find a matching oroi for iroi, see above. fits are looked up in the piece's cache first, and the search
+   starts from the module's own inverse of modify_roi_in() (or a sampled one) if that is closer than oroi. */
+static int _fit_output_to_input_roi(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                                    const dt_iop_roi_t *iroi, dt_iop_roi_t *oroi, int delta, int iter)
+{
+  _roi_cache_key_t key;
+  _roi_cache_key_init(&key, piece, iroi, oroi->scale);
+  if(piece->roi_cache)
+  {
+    const dt_iop_roi_t *cached = (const dt_iop_roi_t *)g_hash_table_lookup(piece->roi_cache, &key);
+    if(cached)
+    {
+      *oroi = *cached;
+      return TRUE;
+    }
+  }
+
+  dt_iop_roi_t oroi_guess = *oroi;
+  if(self->invert_roi_in)
+    self->invert_roi_in(self, piece, iroi, &oroi_guess);
+  else
+    _sample_output_roi(self, piece, iroi, &oroi_guess);
+
+  dt_iop_roi_t iroi_probe = *iroi;
+  self->modify_roi_in(self, piece, oroi, &iroi_probe);
+  const int error = _roi_error(iroi, &iroi_probe);
+  self->modify_roi_in(self, piece, &oroi_guess, &iroi_probe);
+  if(_roi_error(iroi, &iroi_probe) < error) *oroi = oroi_guess;
+
+  if(!_search_output_to_input_roi(self, piece, iroi, oroi, delta, iter)) return FALSE;
+
+  if(!piece->roi_cache)
+    piece->roi_cache = g_hash_table_new_full(_roi_cache_key_hash, _roi_cache_key_equal, g_free, g_free);
+  else if(g_hash_table_size(piece->roi_cache) >= DT_TILING_ROI_CACHE_SIZE)
+    g_hash_table_remove_all(piece->roi_cache);
+  g_hash_table_insert(piece->roi_cache, g_memdup(&key, sizeof(key)), g_memdup(oroi, sizeof(dt_iop_roi_t)));
+  return TRUE;
+}
+
+
 /* simple tiling algorithm for roi_in == roi_out, i.e. for pixel to pixel modules/operations */
 static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                                         void *ivoid, void *ovoid, const dt_iop_roi_t *roi_in,
@@ -621,7 +744,21 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
   singlebuffer = fmax(singlebuffer, 2.0f * 1024.0f * 1024.0f);
   float factor = fmax(tiling.factor, 1.0f);
   float maxbuf = fmax(tiling.maxbuf, 1.0f);
-  singlebuffer = fmax(available / factor, singlebuffer);
+
+  /* modules which allow for it get several tiles processed at once, one thread each, instead of all threads
+     working on one tile. the memory budget is split between the tiles in flight, but we don't go below
+     tiles which are large compared to their overlap. */
+  int nthreads = 1;
+#ifdef _OPENMP
+  if((self->flags() & IOP_FLAGS_TILING_PARALLEL) && dt_conf_get_bool("parallel_tiling"))
+  {
+    const float min_tile = 8.0f * tiling.overlap + 256.0f;
+    const float min_buffer = fmax(min_tile * min_tile * max_bpp * maxbuf, singlebuffer);
+    nthreads = dt_get_num_threads();
+    while(nthreads > 1 && available / (factor * nthreads) < min_buffer) nthreads--;
+  }
+#endif
+  singlebuffer = nthreads > 1 ? available / (factor * nthreads) : fmax(available / factor, singlebuffer);
 
   int width = roi_in->width;
   int height = roi_in->height;
@@ -693,19 +830,25 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
   dt_print(DT_DEBUG_DEV,
            "[default_process_tiling_ptp] use tiling on module '%s' for image with full size %d x %d\n",
            self->op, roi_in->width, roi_in->height);
+
+  /* no use in more threads than tiles */
+  nthreads = _min(nthreads, tiles_x * tiles_y);
+
   dt_print(DT_DEBUG_DEV,
-           "[default_process_tiling_ptp] (%d x %d) tiles with max dimensions %d x %d and overlap %d\n",
-           tiles_x, tiles_y, width, height, overlap);
+           "[default_process_tiling_ptp] (%d x %d) tiles with max dimensions %d x %d and overlap %d, %d at once\n",
+           tiles_x, tiles_y, width, height, overlap, nthreads);
 
-  /* reserve input and output buffers for tiles */
-  input = dt_alloc_align(64, (size_t)width * height * in_bpp);
+  /* reserve input and output buffers for tiles, one pair per tile in flight */
+  const size_t in_tile_size = (size_t)width * height * in_bpp;
+  const size_t out_tile_size = (size_t)width * height * out_bpp;
+  input = dt_alloc_align(64, in_tile_size * nthreads);
   if(input == NULL)
   {
     dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] could not alloc input buffer for module '%s'\n",
              self->op);
     goto error;
   }
-  output = dt_alloc_align(64, (size_t)width * height * out_bpp);
+  output = dt_alloc_align(64, out_tile_size * nthreads);
   if(output == NULL)
   {
     dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] could not alloc output buffer for module '%s'\n",
@@ -718,85 +861,105 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
   float processed_maximum_new[3] = { 1.0f };
   for(int k = 0; k < 3; k++) processed_maximum_saved[k] = piece->pipe->processed_maximum[k];
 
+  piece->pipe->tiling = 1;
 
-  /* iterate over tiles */
-  for(size_t tx = 0; tx < tiles_x; tx++)
-    for(size_t ty = 0; ty < tiles_y; ty++)
-    {
-      piece->pipe->tiling = 1;
+  /* iterate over tiles in memory order: neighbouring tiles share the rows of their overlap, so these are
+     still in cache when the next tile (or the tile next to us on another thread) copies them in.
+     when running several tiles at once, each thread copies its next tile in while the others are still
+     processing theirs. */
+  const int tiles = tiles_x * tiles_y;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(dynamic, 1) default(none)         \
+    shared(self, piece, ivoid, ovoid, roi_in, roi_out, input, output, processed_maximum_saved,               \
+           processed_maximum_new, nthreads, width, height)
+#endif
+  for(int k = 0; k < tiles; k++)
+  {
+    const size_t tx = k % tiles_x;
+    const size_t ty = k / tiles_x;
 
-      size_t wd = tx * tile_wd + width > roi_in->width ? roi_in->width - tx * tile_wd : width;
-      size_t ht = ty * tile_ht + height > roi_in->height ? roi_in->height - ty * tile_ht : height;
+    size_t wd = tx * tile_wd + width > roi_in->width ? roi_in->width - tx * tile_wd : width;
+    size_t ht = ty * tile_ht + height > roi_in->height ? roi_in->height - ty * tile_ht : height;
 
-      /* no need to process end-tiles that are smaller than overlap */
-      if((wd <= overlap && tx > 0) || (ht <= overlap && ty > 0)) continue;
+    /* no need to process end-tiles that are smaller than overlap */
+    if((wd <= overlap && tx > 0) || (ht <= overlap && ty > 0)) continue;
 
-      /* origin and region of effective part of tile, which we want to store later */
-      size_t origin[] = { 0, 0, 0 };
-      size_t region[] = { wd, ht, 1 };
+    /* this thread's tile buffers */
+    char *tinput = (char *)input + (nthreads > 1 ? dt_get_thread_num() : 0) * in_tile_size;
+    char *toutput = (char *)output + (nthreads > 1 ? dt_get_thread_num() : 0) * out_tile_size;
 
-      /* roi_in and roi_out for process_cl on subbuffer */
-      dt_iop_roi_t iroi = { roi_in->x + tx * tile_wd, roi_in->y + ty * tile_ht, wd, ht, roi_in->scale };
-      dt_iop_roi_t oroi = { roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
+    /* origin and region of effective part of tile, which we want to store later */
+    size_t origin[] = { 0, 0, 0 };
+    size_t region[] = { wd, ht, 1 };
 
-      /* offsets of tile into ivoid and ovoid */
-      size_t ioffs = (ty * tile_ht) * ipitch + (tx * tile_wd) * in_bpp;
-      size_t ooffs = (ty * tile_ht) * opitch + (tx * tile_wd) * out_bpp;
+    /* roi_in and roi_out for process_cl on subbuffer */
+    dt_iop_roi_t iroi = { roi_in->x + tx * tile_wd, roi_in->y + ty * tile_ht, wd, ht, roi_in->scale };
+    dt_iop_roi_t oroi = { roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
 
+    /* offsets of tile into ivoid and ovoid */
+    size_t ioffs = (ty * tile_ht) * ipitch + (tx * tile_wd) * in_bpp;
+    size_t ooffs = (ty * tile_ht) * opitch + (tx * tile_wd) * out_bpp;
 
-      dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] tile (%d, %d) with %d x %d at origin [%d, %d]\n",
-               tx, ty, wd, ht, tx * tile_wd, ty * tile_ht);
+
+    dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] tile (%d, %d) with %d x %d at origin [%d, %d]\n",
+             (int)tx, (int)ty, (int)wd, (int)ht, (int)(tx * tile_wd), (int)(ty * tile_ht));
 
 /* prepare input tile buffer */
 #ifdef _OPENMP
-#pragma omp parallel for default(none) shared(input, width, ivoid, ioffs, wd, ht) schedule(static)
+#pragma omp parallel for default(none) shared(tinput, ivoid, ioffs, wd, ht) schedule(static)
 #endif
-      for(size_t j = 0; j < ht; j++)
-        memcpy((char *)input + j * wd * in_bpp, (char *)ivoid + ioffs + j * ipitch, (size_t)wd * in_bpp);
-
-      /* take original processed_maximum as starting point */
-      for(int k = 0; k < 3; k++) piece->pipe->processed_maximum[k] = processed_maximum_saved[k];
-
-      /* call process() of module */
-      self->process(self, piece, input, output, &iroi, &oroi);
-
-      /* aggregate resulting processed_maximum */
-      /* TODO: check if there really can be differences between tiles and take
-               appropriate action (calculate minimum, maximum, average, ...?) */
-      for(int k = 0; k < 3; k++)
+    for(size_t j = 0; j < ht; j++)
+      memcpy(tinput + j * wd * in_bpp, (char *)ivoid + ioffs + j * ipitch, (size_t)wd * in_bpp);
+
+    /* take original processed_maximum as starting point. modules which process tiles in parallel
+       don't touch it. */
+    if(nthreads == 1)
+      for(int c = 0; c < 3; c++) piece->pipe->processed_maximum[c] = processed_maximum_saved[c];
+
+    /* call process() of module */
+    self->process(self, piece, tinput, toutput, &iroi, &oroi);
+
+    /* aggregate resulting processed_maximum */
+    /* TODO: check if there really can be differences between tiles and take
+             appropriate action (calculate minimum, maximum, average, ...?) */
+    if(nthreads == 1)
+      for(int c = 0; c < 3; c++)
       {
-        if(tx + ty > 0 && fabs(processed_maximum_new[k] - piece->pipe->processed_maximum[k]) > 1.0e-6f)
+        if(tx + ty > 0 && fabs(processed_maximum_new[c] - piece->pipe->processed_maximum[c]) > 1.0e-6f)
           dt_print(
               DT_DEBUG_DEV,
-              "[default_process_tiling_ptp] processed_maximum[%d] differs between tiles in module '%s'\n", k,
+              "[default_process_tiling_ptp] processed_maximum[%d] differs between tiles in module '%s'\n", c,
               self->op);
-        processed_maximum_new[k] = piece->pipe->processed_maximum[k];
+        processed_maximum_new[c] = piece->pipe->processed_maximum[c];
       }
 
-      /* correct origin and region of tile for overlap.
-         make sure that we only copy back the "good" part. */
-      if(tx > 0)
-      {
-        origin[0] += overlap;
-        region[0] -= overlap;
-        ooffs += overlap * out_bpp;
-      }
-      if(ty > 0)
-      {
-        origin[1] += overlap;
-        region[1] -= overlap;
-        ooffs += overlap * opitch;
-      }
+    /* correct origin and region of tile for overlap.
+       make sure that we only copy back the "good" part. */
+    if(tx > 0)
+    {
+      origin[0] += overlap;
+      region[0] -= overlap;
+      ooffs += overlap * out_bpp;
+    }
+    if(ty > 0)
+    {
+      origin[1] += overlap;
+      region[1] -= overlap;
+      ooffs += overlap * opitch;
+    }
 
 /* copy "good" part of tile to output buffer */
 #ifdef _OPENMP
-#pragma omp parallel for default(none) shared(ovoid, ooffs, output, width, origin, region,                   \
-                                              wd) schedule(static)
+#pragma omp parallel for default(none) shared(ovoid, ooffs, toutput, origin, region, wd) schedule(static)
 #endif
-      for(size_t j = 0; j < region[1]; j++)
-        memcpy((char *)ovoid + ooffs + j * opitch,
-               (char *)output + ((j + origin[1]) * wd + origin[0]) * out_bpp, (size_t)region[0] * out_bpp);
-    }
+    for(size_t j = 0; j < region[1]; j++)
+      memcpy((char *)ovoid + ooffs + j * opitch, toutput + ((j + origin[1]) * wd + origin[0]) * out_bpp,
+             (size_t)region[0] * out_bpp);
+  }
+
+  /* parallel tiles left the processed_maximum alone */
+  if(nthreads > 1)
+    for(int k = 0; k < 3; k++) processed_maximum_new[k] = processed_maximum_saved[k];
 
   /* copy back final processed_maximum */
   for(int k = 0; k < 3; k++) piece->pipe->processed_maximum[k] = processed_maximum_new[k];
@@ -0,0 +1,142 @@
+#include "StdAfx.h"
+#include "DecoderThreadPool.h"
+/*
+    RawSpeed - RAW file decoder.
+
+    Copyright (C) 2009-2014 Klaus Post
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+    http://www.klauspost.com
+*/
+
+namespace RawSpeed {
+
+class DecoderJob
+{
+public:
+  DecoderTaskFunc func;
+  void *data;
+  uint32 tasks;
+  uint32 next;        // Next task to hand out
+  uint32 done;        // Number of tasks completed
+};
+
+static DecoderThreadPool* pool_instance = NULL;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+void DecoderThreadPool::createInstance(void) {
+  pool_instance = new DecoderThreadPool();
+}
+
+DecoderThreadPool* DecoderThreadPool::getInstance() {
+  pthread_once(&pool_once, createInstance);
+  return pool_instance;
+}
+
+DecoderThreadPool::DecoderThreadPool(void) {
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&wakeup, NULL);
+  pthread_cond_init(&finished, NULL);
+
+  // The calling thread always helps out, so we need one less
+  uint32 cores = getThreadCount();
+  nThreads = cores > 1 ? cores - 1 : 0;
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  for (uint32 i = 0; i < nThreads; i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, workerThread, this) != 0) {
+      nThreads = i;
+      break;
+    }
+  }
+  pthread_attr_destroy(&attr);
+}
+
+// The pool lives as long as the process, the threads are never stopped.
+DecoderThreadPool::~DecoderThreadPool(void) {
+}
+
+void *DecoderThreadPool::workerThread(void *_this) {
+  ((DecoderThreadPool*)_this)->work();
+  return NULL;
+}
+
+void DecoderThreadPool::removeJob(DecoderJob *job) {
+  for (deque<DecoderJob*>::iterator i = jobs.begin(); i != jobs.end(); ++i) {
+    if (*i == job) {
+      jobs.erase(i);
+      return;
+    }
+  }
+}
+
+void DecoderThreadPool::work() {
+  pthread_mutex_lock(&mutex);
+  while (true) {
+    while (jobs.empty())
+      pthread_cond_wait(&wakeup, &mutex);
+
+    DecoderJob *job = jobs.front();
+    uint32 task = job->next++;
+    if (job->next == job->tasks)
+      jobs.pop_front();
+
+    pthread_mutex_unlock(&mutex);
+    job->func(job->data, task);
+    pthread_mutex_lock(&mutex);
+
+    // Don't touch the job after this, it belongs to the thread that queued it.
+    if (++job->done == job->tasks)
+      pthread_cond_broadcast(&finished);
+  }
+}
+
+void DecoderThreadPool::run(uint32 tasks, DecoderTaskFunc func, void *data) {
+  if (!tasks)
+    return;
+
+  DecoderJob job;
+  job.func = func;
+  job.data = data;
+  job.tasks = tasks;
+  job.next = 0;
+  job.done = 0;
+
+  pthread_mutex_lock(&mutex);
+  if (tasks > 1 && nThreads) {
+    jobs.push_back(&job);
+    pthread_cond_broadcast(&wakeup);
+  }
+
+  while (job.next < job.tasks) {
+    uint32 task = job.next++;
+    if (job.next == job.tasks)
+      removeJob(&job);
+    pthread_mutex_unlock(&mutex);
+    func(data, task);
+    pthread_mutex_lock(&mutex);
+    job.done++;
+  }
+
+  while (job.done < job.tasks)
+    pthread_cond_wait(&finished, &mutex);
+  pthread_mutex_unlock(&mutex);
+}
+
+} // namespace RawSpeed
@@ -0,0 +1,65 @@
+#ifndef DECODER_THREAD_POOL_H
+#define DECODER_THREAD_POOL_H
+
+#include "Common.h"
+/*
+    RawSpeed - RAW file decoder.
+
+    Copyright (C) 2009-2014 Klaus Post
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+    http://www.klauspost.com
+*/
+
+namespace RawSpeed {
+
+/* Called with the user data and the number of the task to run. */
+/* Must not throw, errors should be stored in the image instead. */
+typedef void (*DecoderTaskFunc)(void *data, uint32 task);
+
+class DecoderJob;
+
+/* A set of decoder threads shared by all decoders. The threads are started */
+/* on first use and kept around, so files with many tiles or slices don't */
+/* pay for creating and joining threads every time. */
+class DecoderThreadPool
+{
+public:
+  static DecoderThreadPool* getInstance();
+
+  /* Runs task 0 to tasks-1 and returns when all of them are done. */
+  /* The calling thread works on its own tasks as well, so several images */
+  /* can be decoded at the same time without waiting for each other. */
+  void run(uint32 tasks, DecoderTaskFunc func, void *data);
+
+private:
+  DecoderThreadPool(void);
+  ~DecoderThreadPool(void);
+  static void createInstance(void);
+  static void *workerThread(void *_this);
+  void work();
+  void removeJob(DecoderJob *job);
+
+  deque<DecoderJob*> jobs;
+  pthread_mutex_t mutex;
+  pthread_cond_t wakeup;      // Signalled when new jobs are queued
+  pthread_cond_t finished;    // Signalled when a job has finished all its tasks
+  uint32 nThreads;
+};
+
+} // namespace RawSpeed
+
+#endif
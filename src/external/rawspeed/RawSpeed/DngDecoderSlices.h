@@ -2,7 +2,6 @@
 #define DNG_DECODER_SLICES_H
 
 #include "RawDecoder.h"
-#include <queue>
 #include "LJpegPlain.h"
 /* 
     RawSpeed - RAW file decoder.
@@ -40,19 +39,6 @@ public:
   const uint32 offY;
   bool mUseBigtable;
 };
-class DngDecoderSlices;
-
-class DngDecoderThread
-{
-public:
-  DngDecoderThread(void) {}
-  ~DngDecoderThread(void) {}
-  pthread_t threadid;
-  queue<DngSliceElement> slices;
-  DngDecoderSlices* parent;
-};
-
-
 class DngDecoderSlices
 {
 public:
@@ -60,14 +46,12 @@ public:
   ~DngDecoderSlices(void);
   void addSlice(DngSliceElement slice);
   void startDecoding();
-  void decodeSlice(DngDecoderThread* t);
+  void decodeSlice(DngSliceElement &e);
   int size();
-  queue<DngSliceElement> slices;
-  vector<DngDecoderThread*> threads;
+  vector<DngSliceElement> slices;
   FileMap *mFile; 
   RawImage mRaw;
   bool mFixLjpeg;
-  uint32 nThreads;
   int compression;
 };
 
@@ -87,6 +87,7 @@ LJpegDecompressor::LJpegDecompressor(FileMap* file, RawImage img):
   for (int i = 0; i < 4; i++) {
     huff[i].initialized = false;
     huff[i].bigTable = 0;
+    huff[i].pairTable = 0;
   }
   mDNGCompatible = false;
   slicesW.clear();
@@ -102,6 +103,8 @@ LJpegDecompressor::~LJpegDecompressor(void) {
   for (int i = 0; i < 4; i++) {
     if (huff[i].bigTable)
       _aligned_free(huff[i].bigTable);
+    if (huff[i].pairTable)
+      _aligned_free(huff[i].pairTable);
   }
 
 }
@@ -524,6 +527,32 @@ void LJpegDecompressor::createBigTable(HuffmanTable *htbl) {
       htbl->bigTable[i] = l;
     }
   }
+
+  /*
+  * Second level: most differences are short, so the same 14 bits
+  * often hold the next one as well. An entry only depends on the
+  * bits it consumes, so the second one can be looked up in the
+  * bigTable with the remaining bits shifted up.
+  */
+  if (!htbl->pairTable)
+    htbl->pairTable = (HuffmanPair*)_aligned_malloc(size * sizeof(HuffmanPair), 16);
+  if (!htbl->pairTable)
+    ThrowRDE("Out of memory, failed to allocate %d bytes", size*sizeof(HuffmanPair));
+  for (uint32 i = 0; i < size; i++) {
+    HuffmanPair *p = &htbl->pairTable[i];
+    p->len = 0;
+    int v1 = htbl->bigTable[i];
+    uint32 l1 = v1 & 0xff;
+    if (l1 == 0xff || l1 >= bits)
+      continue;
+    int v2 = htbl->bigTable[(i << l1) & (size - 1)];
+    uint32 l2 = v2 & 0xff;
+    if (l2 == 0xff || l1 + l2 > bits)
+      continue;
+    p->diff1 = (short)(v1 >> 8);
+    p->diff2 = (short)(v2 >> 8);
+    p->len = (uchar8)(l1 + l2);
+  }
 }
 
 
@@ -622,4 +651,30 @@ int LJpegDecompressor::HuffDecode(HuffmanTable *htbl) {
   return 0;
 }
 
+/*
+* Decodes two differences coded with the same table, in a single lookup
+* when both fit into the next 14 bits.
+*/
+void LJpegDecompressor::HuffDecodePair(HuffmanTable *htbl, int &diff1, int &diff2) {
+  if (htbl->pairTable) {
+    bits->fill();
+    const HuffmanPair *p = &htbl->pairTable[bits->peekBitsNoFill(14)];
+    if (p->len) {
+      bits->skipBitsNoFill(p->len);
+      diff1 = p->diff1;
+      diff2 = p->diff2;
+      return;
+    }
+  }
+  diff1 = HuffDecode(htbl);
+  diff2 = HuffDecode(htbl);
+}
+
+/* Cameras often write two tables with the same content */
+bool LJpegDecompressor::isSameTable(HuffmanTable *a, HuffmanTable *b) {
+  if (a == b)
+    return true;
+  return !memcmp(a->bits, b->bits, sizeof(a->bits)) && !memcmp(a->huffval, b->huffval, sizeof(a->huffval));
+}
+
 } // namespace RawSpeed
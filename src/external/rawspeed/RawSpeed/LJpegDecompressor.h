@@ -128,6 +128,16 @@ typedef struct JpegComponentInfo {
 * and vice-versa.
 */
 
+/*
+* Two complete differences decoded from the same 14 bits as the bigTable,
+* len is 0 if they don't fit.
+*/
+struct HuffmanPair {
+  short diff1;
+  short diff2;
+  uchar8 len;
+};
+
 struct HuffmanTable {
   /*
   * These two fields directly represent the contents of a JPEG DHT
@@ -147,6 +157,7 @@ struct HuffmanTable {
   short valptr[17];
   uint32 numbits[256];
   int* bigTable;
+  HuffmanPair* pairTable;
   bool initialized;
 };
 
@@ -183,6 +194,8 @@ protected:
   JpegMarker getNextMarker(bool allowskip);
   void parseDHT();
   int HuffDecode(HuffmanTable *htbl);
+  void HuffDecodePair(HuffmanTable *htbl, int &diff1, int &diff2);
+  bool isSameTable(HuffmanTable *a, HuffmanTable *b);
   ByteStream* input;
   BitPumpJPEG* bits;
   FileMap *mFile;
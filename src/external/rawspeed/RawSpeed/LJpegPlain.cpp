@@ -579,6 +579,8 @@ void LJpegPlain::decodeScanLeft2Comps() {
   // First line
   HuffmanTable *dctbl1 = &huff[frame.compInfo[0].dcTblNo];
   HuffmanTable *dctbl2 = &huff[frame.compInfo[1].dcTblNo];
+  // Both components coded alike, decode them together
+  const bool pairs = dctbl1->pairTable && isSameTable(dctbl1, dctbl2);
 
   //Prepare slices (for CR2)
   uint32 slices = (uint32)slicesW.size() * (frame.h - skipY);
@@ -627,13 +629,18 @@ void LJpegPlain::decodeScanLeft2Comps() {
   uint32 x = 1;                            // Skip first pixels on first line.
   for (uint32 y = 0;y < (frame.h - skipY);y++) {
     for (; x < cw ; x++) {
-      int diff = HuffDecode(dctbl1);
-      p1 += diff;
+      int diff1, diff2;
+      if (pairs) {
+        HuffDecodePair(dctbl1, diff1, diff2);
+      } else {
+        diff1 = HuffDecode(dctbl1);
+        diff2 = HuffDecode(dctbl2);
+      }
+      p1 += diff1;
       *dest++ = (ushort16)p1;
   //    _ASSERTE(p1 >= 0 && p1 < 65536);
 
-      diff = HuffDecode(dctbl2);
-      p2 += diff;
+      p2 += diff2;
       *dest++ = (ushort16)p2;
 //      _ASSERTE(p2 >= 0 && p2 < 65536);
 
@@ -202,6 +202,7 @@ void NefDecoder::DecodeUncompressed() {
     else
       slice.h = yPerSlice;
 
+    slice.offY = offY;
     offY = MIN(height, offY + yPerSlice);
 
     if (mFile->isValid(slice.offset + slice.count)) // Only decode if size is valid
@@ -227,6 +228,20 @@ void NefDecoder::DecodeUncompressed() {
   if (msb_hint != hints.end())
     bitorder = (0 == (msb_hint->second).compare("true"));
 
+  if (hints.find(string("coolpixmangled")) == hints.end() && hints.find(string("coolpixsplit")) == hints.end()) {
+    // Every strip covers its own rows, so they can be unpacked in parallel
+    mSlices = slices;
+    mSliceWidth = width;
+    mBitPerPixel = bitPerPixel;
+    mBitOrder = bitorder;
+    mFirstSliceError.clear();
+    startTasks((uint32)slices.size());
+    mSlices.clear();
+    if (!mFirstSliceError.empty())
+      ThrowRDE("%s", mFirstSliceError.c_str());
+    return;
+  }
+
   offY = 0;
   for (uint32 i = 0; i < slices.size(); i++) {
     NefSlice slice = slices[i];
@@ -236,10 +251,8 @@ void NefDecoder::DecodeUncompressed() {
     try {
       if (hints.find(string("coolpixmangled")) != hints.end())
         readCoolpixMangledRaw(in, size, pos, width*bitPerPixel / 8);
-      else if (hints.find(string("coolpixsplit")) != hints.end())
-        readCoolpixSplitRaw(in, size, pos, width*bitPerPixel / 8);
       else
-        readUncompressedRaw(in, size, pos, width*bitPerPixel / 8, bitPerPixel, bitorder ? BitOrder_Jpeg : BitOrder_Plain);
+        readCoolpixSplitRaw(in, size, pos, width*bitPerPixel / 8);
     } catch (RawDecoderException e) {
       if (i>0)
         mRaw->setError(e.what());
@@ -255,6 +268,27 @@ void NefDecoder::DecodeUncompressed() {
   }
 }
 
+void NefDecoder::decodeThreaded(RawDecoderThread * t) {
+  NefSlice &slice = mSlices[t->taskNo];
+  ByteStream in(mFile->getData(slice.offset), slice.count);
+  iPoint2D size(mSliceWidth, slice.h);
+  iPoint2D pos(0, slice.offY);
+  try {
+    readUncompressedRaw(in, size, pos, mSliceWidth*mBitPerPixel / 8, mBitPerPixel, mBitOrder ? BitOrder_Jpeg : BitOrder_Plain);
+  } catch (RawDecoderException &e) {
+    // Like before, the image is only useless if the first strip is broken
+    if (t->taskNo > 0)
+      mRaw->setError(e.what());
+    else
+      mFirstSliceError = e.what();
+  } catch (IOException &e) {
+    if (t->taskNo > 0)
+      mRaw->setError(e.what());
+    else
+      mFirstSliceError = string("NEF decoder: IO error occurred in first slice, unable to decode more. Error is: ") + e.what();
+  }
+}
+
 void NefDecoder::readCoolpixMangledRaw(ByteStream &input, iPoint2D& size, iPoint2D& offset, int inputPitch) {
   uchar8* data = mRaw->getData();
   uint32 outPitch = mRaw->pitch;
@@ -31,6 +31,16 @@
 
 namespace RawSpeed {
 
+class NefSlice {
+public:
+  NefSlice() { h = offset = count = offY = 0;};
+  ~NefSlice() {};
+  uint32 h;
+  uint32 offset;
+  uint32 count;
+  uint32 offY;
+};
+
 class NefDecoder :
   public RawDecoder
 {
@@ -40,6 +50,7 @@ public:
   virtual RawImage decodeRawInternal();
   virtual void decodeMetaDataInternal(CameraMetaData *meta);
   virtual void checkSupportInternal(CameraMetaData *meta);
+  virtual void decodeThreaded(RawDecoderThread* t);
   TiffIFD *mRootIFD;
   virtual TiffIFD* getRootIFD() {return mRootIFD;}
 private:
@@ -56,15 +67,12 @@ private:
   string getMode();
   string getExtendedMode(string mode);
   ushort16* gammaCurve(double pwr, double ts, int mode, int imax);
-};
-
-class NefSlice {
-public:
-  NefSlice() { h = offset = count = 0;};
-  ~NefSlice() {};
-  uint32 h;
-  uint32 offset;
-  uint32 count;
+  // Uncompressed strips, decoded in parallel by decodeThreaded()
+  vector<NefSlice> mSlices;
+  uint32 mSliceWidth;
+  uint32 mBitPerPixel;
+  bool mBitOrder;
+  string mFirstSliceError;
 };
 
 } // namespace RawSpeed
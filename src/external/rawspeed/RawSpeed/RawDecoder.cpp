@@ -587,53 +587,36 @@ void RawDecoder::setMetaData(CameraMetaData *meta, string make, string model, st
 }
 
 
-void *RawDecoderDecodeThread(void *_this) {
-  RawDecoderThread* me = (RawDecoderThread*)_this;
+static void RawDecoderDecodeTask(void *data, uint32 task) {
+  RawDecoderThread* me = &((RawDecoderThread*)data)[task];
   try {
      me->parent->decodeThreaded(me);
   } catch (RawDecoderException &ex) {
     me->parent->mRaw->setError(ex.what());
   } catch (IOException &ex) {
     me->parent->mRaw->setError(ex.what());
+  } catch (...) {
+    me->parent->mRaw->setError("RawDecoder: Caught exception in decoder thread.");
   }
-  pthread_exit(NULL);
-  return 0;
 }
 
 void RawDecoder::startThreads() {
   uint32 threads;
-  bool fail = false;
   threads = getThreadCount(); 
   int y_offset = 0;
   int y_per_thread = (mRaw->dim.y + threads - 1) / threads;
   RawDecoderThread *t = new RawDecoderThread[threads];
 
-  /* Initialize and set thread detached attribute */
-  pthread_attr_t attr;
-  pthread_attr_init(&attr);
-  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-
   for (uint32 i = 0; i < threads; i++) {
     t[i].start_y = y_offset;
     t[i].end_y = MIN(y_offset + y_per_thread, mRaw->dim.y);
     t[i].parent = this;
-    if (pthread_create(&t[i].threadid, &attr, RawDecoderDecodeThread, &t[i]) != 0) {
-      // If a failure occurs, we need to wait for the already created threads to finish
-      threads = i-1;
-      fail = true;
-    }
     y_offset = t[i].end_y;
   }
 
-  for (uint32 i = 0; i < threads; i++) {
-    pthread_join(t[i].threadid, NULL);
-  }
-  pthread_attr_destroy(&attr);
+  DecoderThreadPool::getInstance()->run(threads, RawDecoderDecodeTask, t);
   delete[] t;
 
-  if (fail) {
-    ThrowRDE("RawDecoder::startThreads: Unable to start threads");
-  }
   if (mRaw->errors.size() >= threads)
     ThrowRDE("RawDecoder::startThreads: All threads reported errors. Cannot load image.");
 }
@@ -691,50 +674,18 @@ void RawDecoder::checkSupport(CameraMetaData *meta)
 
 void RawDecoder::startTasks( uint32 tasks )
 {
-  uint32 threads;
-  threads = min(tasks, getThreadCount()); 
-  int ctask = 0;
-  RawDecoderThread *t = new RawDecoderThread[threads];
-
-  // We don't need a thread
-  if (threads == 1) {
-    t[0].parent = this;
-    while ((uint32)ctask < tasks) {
-      t[0].taskNo = ctask++;
-      try {
-        decodeThreaded(&t[0]);
-      } catch (RawDecoderException &ex) {
-        mRaw->setError(ex.what());
-      } catch (IOException &ex) {
-        mRaw->setError(ex.what());
-      }
-    }
-    delete[] t;
-    return;
+  RawDecoderThread *t = new RawDecoderThread[tasks];
+  for (uint32 i = 0; i < tasks; i++) {
+    t[i].taskNo = i;
+    t[i].parent = this;
   }
-  pthread_attr_t attr;
 
-  /* Initialize and set thread detached attribute */
-  pthread_attr_init(&attr);
-  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-
-  /* TODO: Create a way to re-use threads */
-  void *status;
-  while ((uint32)ctask < tasks) {
-    for (uint32 i = 0; i < threads && (uint32)ctask < tasks; i++) {
-      t[i].taskNo = ctask++;
-      t[i].parent = this;
-      pthread_create(&t[i].threadid, &attr, RawDecoderDecodeThread, &t[i]);
-    }
-    for (uint32 i = 0; i < threads; i++) {
-      pthread_join(t[i].threadid, &status);
-    }
-  } 
+  DecoderThreadPool::getInstance()->run(tasks, RawDecoderDecodeTask, t);
+  delete[] t;
 
-  if (mRaw->errors.size() >= tasks)
+  // A single task has always been decoded in place, without failing on errors.
+  if (tasks > 1 && mRaw->errors.size() >= tasks)
     ThrowRDE("RawDecoder::startThreads: All threads reported errors. Cannot load image.");
-
-  delete[] t;
 }
 
 } // namespace RawSpeed
@@ -11,6 +11,7 @@
 #include "BitPumpPlain.h"
 #include "CameraMetaData.h"
 #include "TiffIFD.h"
+#include "DecoderThreadPool.h"
 
 /* 
     RawSpeed - RAW file decoder.
@@ -47,7 +48,6 @@ class RawDecoderThread
     uint32 start_y;
     uint32 end_y;
     const char* error;
-    pthread_t threadid;
     RawDecoder* parent;
     uint32 taskNo;
 };
@@ -136,13 +136,13 @@ protected:
   virtual void decodeMetaDataInternal(CameraMetaData *meta) = 0;
   virtual void checkSupportInternal(CameraMetaData *meta) = 0;
 
-  /* Helper function for decoders - splits the image vertically and starts of decoder threads */
-  /* The function returns when all threads are done */
+  /* Helper function for decoders - splits the image vertically and decodes the parts on the shared decoder threads */
+  /* The function returns when all parts are done */
   /* All errors are silently pushed into the "errors" array.*/
   /* If all threads report an error an exception will be thrown*/
   void startThreads();
 
-  /* Helper function for decoders -  */
+  /* Helper function for decoders - runs decodeThreaded() for each task number on the shared decoder threads */
   /* The function returns when all tasks are done */
   /* All errors are silently pushed into the "errors" array.*/
   /* If all threads report an error an exception will be thrown*/
@@ -94,6 +94,7 @@ extern "C" {
 #include <vector>
 #include <map>
 #include <list>
+#include <deque>
 using namespace std;
 
 #include "pugixml.hpp"
@@ -73,7 +73,8 @@ int write_image(dt_imageio_module_data_t *ppm, const char *filename, const void
 
   // we got a copy of the file, now write the xmp data
   xmpfile = g_strconcat(targetfile, ".xmp", NULL);
-  if(dt_exif_xmp_write(imgid, xmpfile) != 0)
+  // a fresh sidecar next to the copy, nothing to compare against
+  if(dt_exif_xmp_write(imgid, xmpfile, NULL, NULL) != 0)
   {
     // something went wrong, unlink the copied image.
     g_unlink(targetfile);
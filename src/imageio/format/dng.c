@@ -0,0 +1,313 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2016 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <tiffio.h>
+#include "common/darktable.h"
+#include "common/imageio_module.h"
+#include "common/imageio.h"
+#include "common/imageio_tiff.h"
+#include "common/image_cache.h"
+#include "common/exif.h"
+#include "common/colorspaces.h"
+#include "control/conf.h"
+#include "control/control.h"
+#include "common/imageio_format.h"
+#include "bauhaus/bauhaus.h"
+
+DT_MODULE(1)
+
+// tiles of 256x256 pixels, as recommended by the dng spec
+#define DNG_TILE 256
+#define DNG_LUT_SIZE 0x10000
+
+typedef struct dt_imageio_dng_t
+{
+  int max_width, max_height;
+  int width, height;
+  char style[128];
+  gboolean style_append;
+  int bpp;
+} dt_imageio_dng_t;
+
+typedef struct dt_imageio_dng_gui_t
+{
+  GtkWidget *bpp;
+} dt_imageio_dng_gui_t;
+
+typedef struct _tiles_t
+{
+  const dt_imageio_dng_t *d;
+  const float *in;
+  int across;
+  // tone curves of the output profile, to get back to linear data. lut[c][0] < 0 if they are linear already.
+  float lut[3][DNG_LUT_SIZE];
+} _tiles_t;
+
+static inline float _linear(const float *const lut, const float v)
+{
+  if(lut[0] < 0.0f) return v;
+  const float f = v * (DNG_LUT_SIZE - 1);
+  if(f <= 0.0f) return lut[0];
+  // extrapolate above 1
+  const int i = MIN((int)f, DNG_LUT_SIZE - 2);
+  return lut[i] + (f - i) * (lut[i + 1] - lut[i]);
+}
+
+// gather one tile from the rgba pipe output, linear, without alpha, padded with black
+static int _fill_tile(void *data, const int tile, uint8_t *buf)
+{
+  const _tiles_t *t = (const _tiles_t *)data;
+  const dt_imageio_dng_t *d = t->d;
+  const int x0 = (tile % t->across) * DNG_TILE, y0 = (tile / t->across) * DNG_TILE;
+  const int cols = MIN(DNG_TILE, d->width - x0);
+
+  for(int y = 0; y < DNG_TILE; y++)
+  {
+    const float *in = t->in + 4 * ((size_t)d->width * (y0 + y) + x0);
+    if(d->bpp == 32)
+    {
+      float *out = (float *)buf + (size_t)3 * DNG_TILE * y;
+      memset(out, 0, sizeof(float) * 3 * DNG_TILE);
+      if(y0 + y >= d->height) continue;
+      for(int x = 0; x < cols; x++)
+        for(int c = 0; c < 3; c++) out[3 * x + c] = _linear(t->lut[c], in[4 * x + c]);
+    }
+    else
+    {
+      uint16_t *out = (uint16_t *)buf + (size_t)3 * DNG_TILE * y;
+      memset(out, 0, sizeof(uint16_t) * 3 * DNG_TILE);
+      if(y0 + y >= d->height) continue;
+      for(int x = 0; x < cols; x++)
+        for(int c = 0; c < 3; c++) out[3 * x + c] = CLAMP(_linear(t->lut[c], in[4 * x + c]) * 0xffff + 0.5f, 0, 0xffff);
+    }
+  }
+  return DNG_TILE;
+}
+
+int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const void *in_void, void *exif,
+                int exif_len, int imgid, int num, int total)
+{
+  const dt_imageio_dng_t *d = (dt_imageio_dng_t *)d_tmp;
+  int rc = 1; // default to error
+  TIFF *tif = NULL;
+
+  _tiles_t *t = (_tiles_t *)malloc(sizeof(_tiles_t));
+  if(!t) return 1;
+  t->d = d;
+  t->in = (const float *)in_void;
+  t->across = (d->width + DNG_TILE - 1) / DNG_TILE;
+
+  // the pixels are in the output profile, the dng needs its matrix and linear data
+  cmsHPROFILE profile = imgid > 0 ? dt_colorspaces_create_output_profile(imgid)
+                                  : dt_colorspaces_create_srgb_profile();
+  float rgb_to_xyz[9], xyz_to_rgb[9];
+  const int matrix_failed = dt_colorspaces_get_matrix_from_input_profile(profile, rgb_to_xyz, t->lut[0], t->lut[1],
+                                                                         t->lut[2], DNG_LUT_SIZE)
+                            || mat3inv(xyz_to_rgb, rgb_to_xyz);
+  dt_colorspaces_cleanup_profile(profile);
+  if(matrix_failed)
+  {
+    dt_control_log(_("dng export needs a matrix based output profile"));
+    goto exit;
+  }
+
+  char model[128] = "darktable";
+  if(imgid > 0)
+  {
+    const dt_image_t *img = dt_image_cache_get(darktable.image_cache, imgid, 'r');
+    snprintf(model, sizeof(model), "%s %s", img->exif_maker, img->exif_model);
+    dt_image_cache_read_release(darktable.image_cache, img);
+  }
+
+  // in host byte order, so the tiles can be handed over as they are
+  tif = TIFFOpen(filename, "w");
+  if(!tif) goto exit;
+
+  const uint8_t version[4] = { 1, 4, 0, 0 };
+  const float neutral[3] = { 1.0f, 1.0f, 1.0f };
+  const uint32_t white = d->bpp == 32 ? 1 : 0xffff;
+  const int predictor = d->bpp == 32 ? 3 : 2;
+
+  TIFFSetField(tif, TIFFTAG_SUBFILETYPE, (uint32_t)0);
+  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, (uint32_t)d->width);
+  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32_t)d->height);
+  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, (uint16_t)3);
+  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, (uint16_t)d->bpp);
+  TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, (uint16_t)(d->bpp == 32 ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT));
+  TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, (uint16_t)PHOTOMETRIC_LINEARRAW);
+  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, (uint16_t)PLANARCONFIG_CONTIG);
+  TIFFSetField(tif, TIFFTAG_COMPRESSION, (uint16_t)COMPRESSION_ADOBE_DEFLATE);
+  TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)predictor);
+  TIFFSetField(tif, TIFFTAG_TILEWIDTH, (uint32_t)DNG_TILE);
+  TIFFSetField(tif, TIFFTAG_TILELENGTH, (uint32_t)DNG_TILE);
+  TIFFSetField(tif, TIFFTAG_ORIENTATION, (uint16_t)ORIENTATION_TOPLEFT);
+  TIFFSetField(tif, TIFFTAG_DNGVERSION, version);
+  TIFFSetField(tif, TIFFTAG_DNGBACKWARDVERSION, version);
+  TIFFSetField(tif, TIFFTAG_UNIQUECAMERAMODEL, model);
+  TIFFSetField(tif, TIFFTAG_COLORMATRIX1, 9, xyz_to_rgb);
+  TIFFSetField(tif, TIFFTAG_CALIBRATIONILLUMINANT1, (uint16_t)23); // D50, like the icc profile connection space
+  TIFFSetField(tif, TIFFTAG_ASSHOTNEUTRAL, 3, neutral);
+  TIFFSetField(tif, TIFFTAG_WHITELEVEL, 1, &white);
+
+  const int resolution = dt_conf_get_int("metadata/resolution");
+  if(resolution > 0)
+  {
+    TIFFSetField(tif, TIFFTAG_XRESOLUTION, (float)resolution);
+    TIFFSetField(tif, TIFFTAG_YRESOLUTION, (float)resolution);
+    TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, (uint16_t)RESUNIT_INCH);
+  }
+
+  // the tiles are gathered straight from the pipe output, linearized, predicted and deflated on all threads
+  const int ntiles = t->across * ((d->height + DNG_TILE - 1) / DNG_TILE);
+  if(dt_imageio_tiff_write_chunks(tif, 1, ntiles, (size_t)DNG_TILE * 3 * d->bpp / 8, DNG_TILE, d->bpp, 3,
+                                  predictor, 1, _fill_tile, t))
+    goto exit;
+
+  // success
+  rc = 0;
+
+exit:
+  // close the file before adding exif data
+  if(tif)
+  {
+    TIFFClose(tif);
+    tif = NULL;
+  }
+  if(!rc && exif)
+  {
+    rc = dt_exif_write_blob(exif, exif_len, filename);
+    // Until we get symbolic error status codes, if rc is 1, return 0
+    rc = (rc == 1) ? 0 : 1;
+  }
+  free(t);
+
+  return rc;
+}
+
+size_t params_size(dt_imageio_module_format_t *self)
+{
+  return sizeof(dt_imageio_dng_t);
+}
+
+void *get_params(dt_imageio_module_format_t *self)
+{
+  dt_imageio_dng_t *d = (dt_imageio_dng_t *)calloc(1, sizeof(dt_imageio_dng_t));
+  d->bpp = dt_conf_get_int("plugins/imageio/format/dng/bpp") == 16 ? 16 : 32;
+  return d;
+}
+
+void free_params(dt_imageio_module_format_t *self, dt_imageio_module_data_t *params)
+{
+  free(params);
+}
+
+int set_params(dt_imageio_module_format_t *self, const void *params, const int size)
+{
+  if(size != self->params_size(self)) return 1;
+  const dt_imageio_dng_t *d = (dt_imageio_dng_t *)params;
+  const dt_imageio_dng_gui_t *g = (dt_imageio_dng_gui_t *)self->gui_data;
+  dt_bauhaus_combobox_set(g->bpp, d->bpp == 16 ? 0 : 1);
+  return 0;
+}
+
+// the pipe always delivers float, the conversion to 16 bit happens while gathering the tiles
+int bpp(dt_imageio_module_data_t *p)
+{
+  return 32;
+}
+
+int levels(dt_imageio_module_data_t *p)
+{
+  return IMAGEIO_RGB | IMAGEIO_FLOAT;
+}
+
+const char *mime(dt_imageio_module_data_t *data)
+{
+  return "image/x-adobe-dng";
+}
+
+const char *extension(dt_imageio_module_data_t *data)
+{
+  return "dng";
+}
+
+const char *name()
+{
+  return _("DNG (linear, 16/32-bit)");
+}
+
+static void bpp_combobox_changed(GtkWidget *widget, gpointer user_data)
+{
+  dt_conf_set_int("plugins/imageio/format/dng/bpp", dt_bauhaus_combobox_get(widget) == 0 ? 16 : 32);
+}
+
+void init(dt_imageio_module_format_t *self)
+{
+#ifdef USE_LUA
+  dt_lua_register_module_member(darktable.lua_state.state, self, dt_imageio_dng_t, bpp, int);
+#endif
+}
+
+void cleanup(dt_imageio_module_format_t *self)
+{
+}
+
+void gui_init(dt_imageio_module_format_t *self)
+{
+  dt_imageio_dng_gui_t *gui = (dt_imageio_dng_gui_t *)malloc(sizeof(dt_imageio_dng_gui_t));
+  self->gui_data = (void *)gui;
+
+  const int bpp = dt_conf_get_int("plugins/imageio/format/dng/bpp");
+
+  self->widget = gtk_box_new(GTK_ORIENTATION_VERTICAL, DT_PIXEL_APPLY_DPI(5));
+
+  gui->bpp = dt_bauhaus_combobox_new(NULL);
+  dt_bauhaus_widget_set_label(gui->bpp, NULL, _("bit depth"));
+  dt_bauhaus_combobox_add(gui->bpp, _("16 bit"));
+  dt_bauhaus_combobox_add(gui->bpp, _("32 bit (float)"));
+  dt_bauhaus_combobox_set(gui->bpp, bpp == 16 ? 0 : 1);
+  g_object_set(G_OBJECT(gui->bpp), "tooltip-text",
+               _("the image is stored as linear data in the export profile, which has to be matrix based"),
+               (char *)NULL);
+  gtk_box_pack_start(GTK_BOX(self->widget), gui->bpp, TRUE, TRUE, 0);
+  g_signal_connect(G_OBJECT(gui->bpp), "value-changed", G_CALLBACK(bpp_combobox_changed), NULL);
+}
+
+void gui_cleanup(dt_imageio_module_format_t *self)
+{
+  free(self->gui_data);
+}
+
+void gui_reset(dt_imageio_module_format_t *self)
+{
+}
+
+int flags(dt_imageio_module_data_t *data)
+{
+  return FORMAT_FLAGS_SUPPORT_XMP;
+}
+
+#undef DNG_TILE
+#undef DNG_LUT_SIZE
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
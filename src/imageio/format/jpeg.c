@@ -35,6 +35,7 @@
 #undef HAVE_STDLIB_H
 #undef HAVE_STDDEF_H
 #include <jpeglib.h>
+#include <jerror.h>
 #undef HAVE_STDLIB_H
 #undef HAVE_STDDEF_H
 
@@ -76,6 +77,10 @@ static void dt_imageio_jpeg_error_exit(j_common_ptr cinfo)
   longjmp(myerr->setjmp_buffer, 1);
 }
 
+static void _jpeg_silent_message(j_common_ptr cinfo)
+{
+}
+
 /*
  * Since an ICC profile can be larger than the maximum size of a JPEG marker
  * (64K), we need provisions to split it into multiple markers.  The format
@@ -312,39 +317,63 @@ read_icc_profile (j_decompress_ptr cinfo,
 #undef MAX_SEQ_NO
 
 
-int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const void *in_tmp, void *exif,
-                int exif_len, int imgid, int num, int total)
+// rows per jpeg_write_scanlines() call
+#define DT_JPEG_ROWS 16
+// stripes start on a multiple of the largest mcu height
+#define DT_JPEG_STRIPE_ALIGN 16
+// don't bother with threads for small images
+#define DT_JPEG_MIN_STRIPE 128
+
+// libjpeg-turbo can take our rgba rows directly. it might have been only available at build time, though.
+static int _rgbx_supported()
 {
-  dt_imageio_jpeg_t *jpg = (dt_imageio_jpeg_t *)jpg_tmp;
-  const uint8_t *in = (const uint8_t *)in_tmp;
+#ifdef JCS_EXTENSIONS
+  static int supported = -1;
+  if(supported >= 0) return supported;
+  struct jpeg_compress_struct cinfo;
   struct dt_imageio_jpeg_error_mgr jerr;
-
-  jpg->cinfo.err = jpeg_std_error(&jerr.pub);
+  cinfo.err = jpeg_std_error(&jerr.pub);
   jerr.pub.error_exit = dt_imageio_jpeg_error_exit;
+  jerr.pub.output_message = _jpeg_silent_message;
   if(setjmp(jerr.setjmp_buffer))
   {
-    jpeg_destroy_compress(&(jpg->cinfo));
-    return 1;
+    jpeg_destroy_compress(&cinfo);
+    supported = 0;
+    return 0;
   }
-  jpeg_create_compress(&(jpg->cinfo));
-  FILE *f = fopen(filename, "wb");
-  if(!f) return 1;
-  jpeg_stdio_dest(&(jpg->cinfo), f);
+  jpeg_create_compress(&cinfo);
+  cinfo.input_components = 4;
+  cinfo.in_color_space = JCS_EXT_RGBX;
+  jpeg_set_defaults(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  supported = 1;
+  return 1;
+#else
+  return 0;
+#endif
+}
 
-  jpg->cinfo.image_width = jpg->width;
-  jpg->cinfo.image_height = jpg->height;
-  jpg->cinfo.input_components = 3;
-  jpg->cinfo.in_color_space = JCS_RGB;
-  jpeg_set_defaults(&(jpg->cinfo));
-  jpeg_set_quality(&(jpg->cinfo), jpg->quality, TRUE);
-  if(jpg->quality > 90) jpg->cinfo.comp_info[0].v_samp_factor = 1;
-  if(jpg->quality > 92) jpg->cinfo.comp_info[0].h_samp_factor = 1;
-  if(jpg->quality > 95) jpg->cinfo.dct_method = JDCT_FLOAT;
-  if(jpg->quality < 50) jpg->cinfo.dct_method = JDCT_IFAST;
-  if(jpg->quality < 80) jpg->cinfo.smoothing_factor = 20;
-  if(jpg->quality < 60) jpg->cinfo.smoothing_factor = 40;
-  if(jpg->quality < 40) jpg->cinfo.smoothing_factor = 60;
-  jpg->cinfo.optimize_coding = 1;
+static void _setup_compress(const dt_imageio_jpeg_t *jpg, j_compress_ptr cinfo, const int height, const int rgbx)
+{
+  cinfo->image_width = jpg->width;
+  cinfo->image_height = height;
+#ifdef JCS_EXTENSIONS
+  cinfo->input_components = rgbx ? 4 : 3;
+  cinfo->in_color_space = rgbx ? JCS_EXT_RGBX : JCS_RGB;
+#else
+  cinfo->input_components = 3;
+  cinfo->in_color_space = JCS_RGB;
+#endif
+  jpeg_set_defaults(cinfo);
+  jpeg_set_quality(cinfo, jpg->quality, TRUE);
+  if(jpg->quality > 90) cinfo->comp_info[0].v_samp_factor = 1;
+  if(jpg->quality > 92) cinfo->comp_info[0].h_samp_factor = 1;
+  if(jpg->quality > 95) cinfo->dct_method = JDCT_FLOAT;
+  if(jpg->quality < 50) cinfo->dct_method = JDCT_IFAST;
+  if(jpg->quality < 80) cinfo->smoothing_factor = 20;
+  if(jpg->quality < 60) cinfo->smoothing_factor = 40;
+  if(jpg->quality < 40) cinfo->smoothing_factor = 60;
+  cinfo->optimize_coding = 1;
 
   // according to specs density_unit = 0, X_density = 1, Y_density = 1 should be fine and valid since it
   // describes an image with unknown unit and square pixels.
@@ -353,19 +382,20 @@ int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const v
   const int resolution = dt_conf_get_int("metadata/resolution");
   if(resolution > 0)
   {
-    jpg->cinfo.density_unit = 1;
-    jpg->cinfo.X_density = resolution;
-    jpg->cinfo.Y_density = resolution;
+    cinfo->density_unit = 1;
+    cinfo->X_density = resolution;
+    cinfo->Y_density = resolution;
   }
   else
   {
-    jpg->cinfo.density_unit = 0;
-    jpg->cinfo.X_density = 1;
-    jpg->cinfo.Y_density = 1;
+    cinfo->density_unit = 0;
+    cinfo->X_density = 1;
+    cinfo->Y_density = 1;
   }
+}
 
-  jpeg_start_compress(&(jpg->cinfo), TRUE);
-
+static void _write_markers(j_compress_ptr cinfo, void *exif, const int exif_len, const int imgid)
+{
   if(imgid > 0)
   {
     cmsHPROFILE out_profile = dt_colorspaces_create_output_profile(imgid);
@@ -375,31 +405,258 @@ int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const v
     {
       unsigned char buf[len];
       cmsSaveProfileToMem(out_profile, buf, &len);
-      write_icc_profile(&(jpg->cinfo), buf, len);
+      write_icc_profile(cinfo, buf, len);
     }
     dt_colorspaces_cleanup_profile(out_profile);
   }
 
-  if(exif && exif_len > 0 && exif_len < 65534)
-    jpeg_write_marker(&(jpg->cinfo), JPEG_APP0 + 1, exif, exif_len);
+  if(exif && exif_len > 0 && exif_len < 65534) jpeg_write_marker(cinfo, JPEG_APP0 + 1, exif, exif_len);
+}
+
+// feed rows of the rgba buffer, starting at in, to the started compressor
+static void _write_rows(const dt_imageio_jpeg_t *jpg, j_compress_ptr cinfo, const uint8_t *in, const int rgbx)
+{
+  if(rgbx)
+  {
+    JSAMPROW rows[DT_JPEG_ROWS];
+    while(cinfo->next_scanline < cinfo->image_height)
+    {
+      const int n = MIN(DT_JPEG_ROWS, cinfo->image_height - cinfo->next_scanline);
+      for(int k = 0; k < n; k++)
+        rows[k] = (JSAMPROW)(in + ((size_t)cinfo->next_scanline + k) * jpg->width * 4);
+      jpeg_write_scanlines(cinfo, rows, n);
+    }
+    return;
+  }
 
-  uint8_t row[3 * jpg->width];
-  const uint8_t *buf;
-  while(jpg->cinfo.next_scanline < jpg->cinfo.image_height)
+  uint8_t *row = (uint8_t *)malloc(sizeof(uint8_t) * 3 * jpg->width);
+  while(cinfo->next_scanline < cinfo->image_height)
   {
     JSAMPROW tmp[1];
-    buf = in + (size_t)jpg->cinfo.next_scanline * jpg->cinfo.image_width * 4;
+    const uint8_t *buf = in + (size_t)cinfo->next_scanline * jpg->width * 4;
     for(int i = 0; i < jpg->width; i++)
       for(int k = 0; k < 3; k++) row[3 * i + k] = buf[4 * i + k];
     tmp[0] = row;
-    jpeg_write_scanlines(&(jpg->cinfo), tmp, 1);
+    jpeg_write_scanlines(cinfo, tmp, 1);
+  }
+  free(row);
+}
+
+// growing in-memory destination for the stripes
+typedef struct _jpeg_mem_dest_t
+{
+  struct jpeg_destination_mgr pub;
+  JOCTET *buf;
+  size_t size, alloc;
+} _jpeg_mem_dest_t;
+
+static void _mem_init_destination(j_compress_ptr cinfo)
+{
+  _jpeg_mem_dest_t *dest = (_jpeg_mem_dest_t *)cinfo->dest;
+  dest->pub.next_output_byte = dest->buf;
+  dest->pub.free_in_buffer = dest->alloc;
+}
+
+static boolean _mem_empty_output_buffer(j_compress_ptr cinfo)
+{
+  _jpeg_mem_dest_t *dest = (_jpeg_mem_dest_t *)cinfo->dest;
+  const size_t alloc = 2 * dest->alloc;
+  JOCTET *buf = (JOCTET *)realloc(dest->buf, alloc);
+  if(!buf) ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+  // the whole buffer was full
+  dest->pub.next_output_byte = buf + dest->alloc;
+  dest->pub.free_in_buffer = alloc - dest->alloc;
+  dest->buf = buf;
+  dest->alloc = alloc;
+  return TRUE;
+}
+
+static void _mem_term_destination(j_compress_ptr cinfo)
+{
+  _jpeg_mem_dest_t *dest = (_jpeg_mem_dest_t *)cinfo->dest;
+  dest->size = dest->alloc - dest->pub.free_in_buffer;
+}
+
+// encode rows [y, y+height) as a complete jpeg with a restart marker after every mcu row. all stripes use the
+// standard huffman tables, so the entropy coded data of all of them can go under the headers of the first.
+static int _compress_stripe(const dt_imageio_jpeg_t *jpg, const uint8_t *in, const int y, const int height,
+                            void *exif, const int exif_len, const int imgid, const int rgbx,
+                            _jpeg_mem_dest_t *dest)
+{
+  struct jpeg_compress_struct cinfo;
+  struct dt_imageio_jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = dt_imageio_jpeg_error_exit;
+  if(setjmp(jerr.setjmp_buffer))
+  {
+    jpeg_destroy_compress(&cinfo);
+    return 1;
   }
+  jpeg_create_compress(&cinfo);
+
+  dest->alloc = MAX((size_t)jpg->width * height / 2, 4096);
+  dest->buf = (JOCTET *)malloc(dest->alloc);
+  if(!dest->buf)
+  {
+    jpeg_destroy_compress(&cinfo);
+    return 1;
+  }
+  dest->pub.init_destination = _mem_init_destination;
+  dest->pub.empty_output_buffer = _mem_empty_output_buffer;
+  dest->pub.term_destination = _mem_term_destination;
+  cinfo.dest = &dest->pub;
+
+  _setup_compress(jpg, &cinfo, height, rgbx);
+  cinfo.optimize_coding = 0;
+  cinfo.restart_in_rows = 1;
+
+  jpeg_start_compress(&cinfo, TRUE);
+  if(y == 0) _write_markers(&cinfo, exif, exif_len, imgid);
+  _write_rows(jpg, &cinfo, in + (size_t)y * jpg->width * 4, rgbx);
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  return 0;
+}
+
+// offset of the entropy coded data behind the sos marker, patching the image height into the frame header
+// on the way. returns 0 if the stream doesn't look like what we wrote.
+static size_t _find_scan(JOCTET *buf, const size_t size, const int height)
+{
+  size_t pos = 2;
+  while(pos + 4 <= size && buf[pos] == 0xff)
+  {
+    const int marker = buf[pos + 1];
+    const size_t len = (buf[pos + 2] << 8) | buf[pos + 3];
+    if(pos + 2 + len > size) return 0;
+    if((marker == 0xc0 || marker == 0xc1) && height > 0)
+    {
+      buf[pos + 5] = (height >> 8) & 0xff;
+      buf[pos + 6] = height & 0xff;
+    }
+    if(marker == 0xda) return pos + 2 + len;
+    pos += 2 + len;
+  }
+  return 0;
+}
+
+// copy the entropy coded data, with the restart markers numbered on from *rst
+static int _write_scan(FILE *f, JOCTET *buf, const size_t size, int *rst)
+{
+  for(size_t k = 0; k + 1 < size; k++)
+    if(buf[k] == 0xff && buf[k + 1] >= 0xd0 && buf[k + 1] <= 0xd7)
+    {
+      buf[k + 1] = 0xd0 + (*rst & 7);
+      (*rst)++;
+      k++;
+    }
+  return fwrite(buf, 1, size, f) != size;
+}
+
+static int _write_image_parallel(dt_imageio_jpeg_t *jpg, FILE *f, const uint8_t *in, void *exif,
+                                 const int exif_len, const int imgid, const int rgbx, const int nstripes,
+                                 const int stripe)
+{
+  _jpeg_mem_dest_t *dest = (_jpeg_mem_dest_t *)calloc(nstripes, sizeof(_jpeg_mem_dest_t));
+  if(!dest) return 1;
+  int err = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) reduction(+ : err)
+#endif
+  for(int s = 0; s < nstripes; s++)
+  {
+    const int y = s * stripe;
+    const int height = MIN(stripe, jpg->height - y);
+    err += _compress_stripe(jpg, in, y, height, exif, exif_len, imgid, rgbx, dest + s);
+  }
+
+  int rst = 0;
+  for(int s = 0; s < nstripes && !err; s++)
+  {
+    // all of the first stripe, with the height of the whole image, and then only the scans of the others
+    const size_t scan = _find_scan(dest[s].buf, dest[s].size, s == 0 ? jpg->height : 0);
+    const int eoi = dest[s].size >= 2 && dest[s].buf[dest[s].size - 2] == 0xff
+                    && dest[s].buf[dest[s].size - 1] == 0xd9;
+    if(!scan || !eoi || scan > dest[s].size - 2)
+    {
+      err = 1;
+      break;
+    }
+    if(s == 0)
+      err = fwrite(dest[s].buf, 1, scan, f) != scan;
+    else
+    {
+      // the stripes end on an mcu row, restart in between
+      const JOCTET marker[2] = { 0xff, 0xd0 + (rst & 7) };
+      rst++;
+      err = fwrite(marker, 1, 2, f) != 2;
+    }
+    if(!err) err = _write_scan(f, dest[s].buf + scan, dest[s].size - 2 - scan, &rst);
+  }
+  if(!err)
+  {
+    const JOCTET eoi[2] = { 0xff, 0xd9 };
+    err = fwrite(eoi, 1, 2, f) != 2;
+  }
+
+  for(int s = 0; s < nstripes; s++) free(dest[s].buf);
+  free(dest);
+  return err;
+}
+
+int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const void *in_tmp, void *exif,
+                int exif_len, int imgid, int num, int total)
+{
+  dt_imageio_jpeg_t *jpg = (dt_imageio_jpeg_t *)jpg_tmp;
+  const uint8_t *in = (const uint8_t *)in_tmp;
+  const int rgbx = _rgbx_supported();
+
+  // split into stripes which are encoded at the same time. smoothing would look across their borders, and the
+  // huffman tables can't be optimized for all of them at once, so that's for the higher qualities only.
+  const int nthreads = dt_get_num_threads();
+  const int stripe = ((jpg->height + nthreads - 1) / nthreads + DT_JPEG_STRIPE_ALIGN - 1)
+                     / DT_JPEG_STRIPE_ALIGN * DT_JPEG_STRIPE_ALIGN;
+  const int nstripes = (jpg->height + stripe - 1) / stripe;
+  if(nstripes > 1 && stripe >= DT_JPEG_MIN_STRIPE && jpg->quality >= 80
+     && dt_conf_get_bool("plugins/imageio/format/jpeg/parallel"))
+  {
+    FILE *f = fopen(filename, "wb");
+    if(!f) return 1;
+    const int err = _write_image_parallel(jpg, f, in, exif, exif_len, imgid, rgbx, nstripes, stripe);
+    fclose(f);
+    return err;
+  }
+
+  struct dt_imageio_jpeg_error_mgr jerr;
+
+  jpg->cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = dt_imageio_jpeg_error_exit;
+  if(setjmp(jerr.setjmp_buffer))
+  {
+    jpeg_destroy_compress(&(jpg->cinfo));
+    return 1;
+  }
+  jpeg_create_compress(&(jpg->cinfo));
+  FILE *f = fopen(filename, "wb");
+  if(!f) return 1;
+  jpeg_stdio_dest(&(jpg->cinfo), f);
+
+  _setup_compress(jpg, &(jpg->cinfo), jpg->height, rgbx);
+
+  jpeg_start_compress(&(jpg->cinfo), TRUE);
+  _write_markers(&(jpg->cinfo), exif, exif_len, imgid);
+  _write_rows(jpg, &(jpg->cinfo), in, rgbx);
+
   jpeg_finish_compress(&(jpg->cinfo));
   jpeg_destroy_compress(&(jpg->cinfo));
   fclose(f);
   return 0;
 }
 
+#undef DT_JPEG_ROWS
+#undef DT_JPEG_STRIPE_ALIGN
+#undef DT_JPEG_MIN_STRIPE
+
 int read_header(const char *filename, dt_imageio_jpeg_t *jpg)
 {
   jpg->f = fopen(filename, "rb");
@@ -20,6 +20,7 @@
 #include "common/colorspaces.h"
 #include "common/darktable.h"
 #include "common/imageio.h"
+#include "common/imageio_convert.h"
 #include "common/imageio_module.h"
 #include "common/variables.h"
 #include "common/pdf.h"
@@ -253,27 +254,14 @@ int write_image(dt_imageio_module_data_t *data, const char *filename, const void
     if(d->params.bpp == 8)
     {
       image_data = (uint8_t *)malloc(data->width * data->height * 3);
-      const uint8_t *in_ptr = (const uint8_t *)in;
-      uint8_t *out_ptr = image_data;
-      for(int y = 0; y < data->height; y++)
-      {
-        for(int x = 0; x < data->width; x++, in_ptr += 4, out_ptr += 3)
-          memcpy(out_ptr, in_ptr, 3);
-      }
+      dt_imageio_convert_row_u8((const uint8_t *)in, image_data, data->width * data->height,
+                                DT_IMAGEIO_CONVERT_RGB);
     }
     else
     {
       image_data = (uint8_t *)malloc(data->width * data->height * 3 * sizeof(uint16_t));
-      const uint16_t *in_ptr = (const uint16_t *)in;
-      uint16_t *out_ptr = (uint16_t *)image_data;
-      for(int y = 0; y < data->height; y++)
-      {
-        for(int x = 0; x < data->width; x++, in_ptr += 4, out_ptr += 3)
-        {
-          for(int c = 0; c < 3; c++)
-            out_ptr[c] = (0xff00 & (in_ptr[c] << 8)) | (in_ptr[c] >> 8);
-        }
-      }
+      dt_imageio_convert_row_u16((const uint16_t *)in, (uint16_t *)image_data, data->width * data->height,
+                                 DT_IMAGEIO_CONVERT_RGB | DT_IMAGEIO_CONVERT_BYTESWAP);
     }
   }
 
@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <png.h>
 #include <inttypes.h>
 #include <zlib.h>
@@ -31,12 +32,13 @@
 #include "common/darktable.h"
 #include "common/imageio_module.h"
 #include "common/imageio.h"
+#include "common/imageio_convert.h"
 #include "common/colorspaces.h"
 #include "control/conf.h"
 #include "common/imageio_format.h"
 #include "bauhaus/bauhaus.h"
 
-DT_MODULE(2)
+DT_MODULE(3)
 
 typedef struct dt_imageio_png_t
 {
@@ -45,6 +47,7 @@ typedef struct dt_imageio_png_t
   char style[128];
   gboolean style_append;
   int bpp;
+  int compression;
   FILE *f;
   png_structp png_ptr;
   png_infop info_ptr;
@@ -53,8 +56,18 @@ typedef struct dt_imageio_png_t
 typedef struct dt_imageio_png_gui_t
 {
   GtkWidget *bit_depth;
+  GtkWidget *compression;
 } dt_imageio_png_gui_t;
 
+// one horizontal stripe of the image, deflated on its own
+typedef struct _stripe_t
+{
+  uint8_t *buf; // 2 bytes zlib header, the deflate data, 4 bytes adler32
+  size_t len;
+  uLong adler;
+  int err;
+} _stripe_t;
+
 /* Write EXIF data to PNG file.
  * Code copied from DigiKam's libs/dimg/loaders/pngloader.cpp.
  * The EXIF embedding is defined by ImageMagicK.
@@ -120,6 +133,100 @@ static void PNGwriteRawProfile(png_struct *ping, png_info *ping_info, char *prof
   png_free(ping, text);
 }
 
+static inline void _convert_row(const dt_imageio_png_t *const p, const void *const ivoid, const int y,
+                                uint8_t *const row)
+{
+  // drop the filler byte and, for 16 bit files, swap to most significant byte first
+  if(p->bpp > 8)
+    dt_imageio_convert_row_u16((const uint16_t *)ivoid + (size_t)4 * y * p->width, (uint16_t *)row, p->width,
+                               DT_IMAGEIO_CONVERT_RGB | DT_IMAGEIO_CONVERT_BYTESWAP);
+  else
+    dt_imageio_convert_row_u8((const uint8_t *)ivoid + (size_t)4 * y * p->width, row, p->width,
+                              DT_IMAGEIO_CONVERT_RGB);
+}
+
+/*
+ * Try all five png filters on a row and keep the one with the smallest sum of absolute (signed) residuals.
+ * That is the heuristic recommended by the png spec for continuous tone images, and what photos profit from:
+ * paeth and average usually win there, sub and up on smooth gradients.
+ */
+static void _filter_row(const uint8_t *const cur, const uint8_t *const prev, const size_t rowsize, const int bpp,
+                        uint8_t *const tmp, uint8_t *const out)
+{
+  uint8_t *const f[5] = { tmp, tmp + rowsize, tmp + 2 * rowsize, tmp + 3 * rowsize, tmp + 4 * rowsize };
+  uint64_t sum[5] = { 0 };
+  for(size_t i = 0; i < rowsize; i++)
+  {
+    const int x = cur[i], b = prev[i];
+    const int a = i >= (size_t)bpp ? cur[i - bpp] : 0, c = i >= (size_t)bpp ? prev[i - bpp] : 0;
+    const int pp = a + b - c, pa = abs(pp - a), pb = abs(pp - b), pc = abs(pp - c);
+    const int paeth = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+    f[0][i] = x;
+    f[1][i] = x - a;
+    f[2][i] = x - b;
+    f[3][i] = x - ((a + b) >> 1);
+    f[4][i] = x - paeth;
+    for(int k = 0; k < 5; k++) sum[k] += abs((int8_t)f[k][i]);
+  }
+  int best = 0;
+  for(int k = 1; k < 5; k++)
+    if(sum[k] < sum[best]) best = k;
+  out[0] = best;
+  memcpy(out + 1, f[best], rowsize);
+}
+
+// filter and deflate rows [y0, y1) into a raw deflate stream, ending in a full flush so the stripes can be
+// concatenated. only the last stripe finishes the stream.
+static void _deflate_stripe(const dt_imageio_png_t *const p, const void *const ivoid, const int y0, const int y1,
+                            const int last, _stripe_t *const st)
+{
+  const int bpp = 3 * (p->bpp > 8 ? 2 : 1);
+  const size_t rowsize = (size_t)bpp * p->width;
+  const size_t insize = (size_t)(y1 - y0) * (rowsize + 1);
+  uint8_t *rows = calloc(2 * rowsize + 5 * rowsize + rowsize + 1, sizeof(uint8_t));
+  st->adler = adler32(0L, Z_NULL, 0);
+  st->len = 0;
+  st->buf = NULL;
+  st->err = 1;
+  if(!rows) return;
+  uint8_t *const tmp = rows + 2 * rowsize, *const filtered = tmp + 5 * rowsize;
+
+  z_stream zs = { 0 };
+  if(deflateInit2(&zs, p->compression, Z_DEFLATED, -15, 8, Z_FILTERED) != Z_OK)
+  {
+    free(rows);
+    return;
+  }
+  const size_t bound = deflateBound(&zs, insize) + 16;
+  st->buf = malloc(2 + bound + 4);
+  if(!st->buf) goto exit;
+  zs.next_out = st->buf + 2;
+  zs.avail_out = (uInt)bound;
+
+  // the row above the first one of the image is all zeros, the one above a stripe is converted again
+  if(y0 > 0) _convert_row(p, ivoid, y0 - 1, rows + rowsize);
+  for(int y = y0; y < y1; y++)
+  {
+    uint8_t *const cur = rows + ((y - y0) & 1) * rowsize, *const prev = rows + ((y - y0 + 1) & 1) * rowsize;
+    _convert_row(p, ivoid, y, cur);
+    _filter_row(cur, prev, rowsize, bpp, tmp, filtered);
+    st->adler = adler32(st->adler, filtered, rowsize + 1);
+    zs.next_in = filtered;
+    zs.avail_in = rowsize + 1;
+    const int flush = y < y1 - 1 ? Z_NO_FLUSH : (last ? Z_FINISH : Z_FULL_FLUSH);
+    const int ret = deflate(&zs, flush);
+    if(ret == Z_STREAM_ERROR || zs.avail_in > 0 || (flush != Z_NO_FLUSH && zs.avail_out == 0)
+       || (flush == Z_FINISH && ret != Z_STREAM_END))
+      goto exit;
+  }
+  st->len = bound - zs.avail_out;
+  st->err = 0;
+
+exit:
+  deflateEnd(&zs);
+  free(rows);
+}
+
 int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const void *ivoid, void *exif,
                 int exif_len, int imgid, int num, int total)
 {
@@ -155,13 +262,6 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
 
   png_init_io(png_ptr, f);
 
-  png_set_compression_level(png_ptr, Z_BEST_COMPRESSION);
-  png_set_compression_mem_level(png_ptr, 8);
-  png_set_compression_strategy(png_ptr, Z_DEFAULT_STRATEGY);
-  png_set_compression_window_bits(png_ptr, 15);
-  png_set_compression_method(png_ptr, 8);
-  png_set_compression_buffer_size(png_ptr, 8192);
-
   png_set_IHDR(png_ptr, info_ptr, width, height, p->bpp, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
                PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
@@ -196,34 +296,66 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
   png_write_info(png_ptr, info_ptr);
 
   /*
-   * Get rid of filler (OR ALPHA) bytes, pack XRGB/RGBX/ARGB/RGBA into
-   * RGB (4 channels -> 3 channels). The second parameter is not used.
+   * The image data is one zlib stream, split into IDAT chunks. Instead of letting libpng filter and deflate it
+   * row after row, horizontal stripes are filtered and deflated independently on all threads, each ending in a
+   * full flush, and concatenated. The adler32 checksums of the stripes are combined for the stream trailer.
    */
-  png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
+  const int rowsize = 3 * width * (p->bpp > 8 ? 2 : 1);
+  const int nthreads = dt_get_num_threads();
+  const int rows_per_stripe = MAX(64, (height + nthreads - 1) / nthreads);
+  const int nstripes = (height + rows_per_stripe - 1) / rows_per_stripe;
+  _stripe_t *stripes = calloc(nstripes, sizeof(_stripe_t));
+  if(!stripes)
+  {
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(f);
+    return 1;
+  }
 
-  png_bytep *row_pointers = malloc((size_t)height * sizeof(png_bytep));
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(int s = 0; s < nstripes; s++)
+    _deflate_stripe(p, ivoid, s * rows_per_stripe, MIN(height, (s + 1) * rows_per_stripe), s == nstripes - 1,
+                    stripes + s);
 
-  if(p->bpp > 8)
+  int err = 0;
+  uLong adler = adler32(0L, Z_NULL, 0);
+  for(int s = 0; s < nstripes; s++)
   {
-    /* swap bytes of 16 bit files to most significant bit first */
-    png_set_swap(png_ptr);
-
-    for(unsigned i = 0; i < height; i++)
-      row_pointers[i] = (png_bytep)((uint16_t *)ivoid + (size_t)4 * i * width);
+    err |= stripes[s].err;
+    if(!err) adler = adler32_combine(adler, stripes[s].adler, (z_off_t)(MIN(height, (s + 1) * rows_per_stripe)
+                                                                        - s * rows_per_stripe) * (rowsize + 1));
   }
-  else
+
+  if(!err)
   {
-    for(unsigned i = 0; i < height; i++) row_pointers[i] = (uint8_t *)ivoid + (size_t)4 * i * width;
+    // zlib header: 32k window, deflate, and the compression level hint
+    const int flevel = p->compression < 2 ? 0 : p->compression < 6 ? 1 : p->compression == 6 ? 2 : 3;
+    const int header = (0x78 << 8) | (flevel << 6);
+    stripes[0].buf[0] = 0x78;
+    stripes[0].buf[1] = (flevel << 6) + (31 - header % 31) % 31;
+    _stripe_t *const st = stripes + nstripes - 1;
+    uint8_t *const trailer = st->buf + 2 + st->len;
+    trailer[0] = adler >> 24;
+    trailer[1] = adler >> 16;
+    trailer[2] = adler >> 8;
+    trailer[3] = adler;
+
+    for(int s = 0; s < nstripes; s++)
+      png_write_chunk(png_ptr, (png_bytep) "IDAT", stripes[s].buf + (s ? 2 : 0),
+                      stripes[s].len + (s ? 0 : 2) + (s == nstripes - 1 ? 4 : 0));
+    // libpng did not see the IDAT chunks, so it would refuse png_write_end(). nothing is left to write after
+    // the image data anyway, the text chunks went out with the header.
+    png_write_chunk(png_ptr, (png_bytep) "IEND", NULL, 0);
   }
 
-  png_write_image(png_ptr, row_pointers);
+  for(int s = 0; s < nstripes; s++) free(stripes[s].buf);
+  free(stripes);
 
-  free(row_pointers);
-
-  png_write_end(png_ptr, info_ptr);
   png_destroy_write_struct(&png_ptr, &info_ptr);
   fclose(f);
-  return 0;
+  return err;
 }
 
 int read_header(const char *filename, dt_imageio_module_data_t *p_tmp)
@@ -348,14 +480,14 @@ int read_image(dt_imageio_module_data_t *p_tmp, uint8_t *out)
 
 size_t params_size(dt_imageio_module_format_t *self)
 {
-  return sizeof(dt_imageio_module_data_t) + sizeof(int);
+  return sizeof(dt_imageio_module_data_t) + 2 * sizeof(int);
 }
 
 void *legacy_params(dt_imageio_module_format_t *self, const void *const old_params,
                     const size_t old_params_size, const int old_version, const int new_version,
                     size_t *new_size)
 {
-  if(old_version == 1 && new_version == 2)
+  if(old_version == 1 && new_version == 3)
   {
     typedef struct dt_imageio_png_v1_t
     {
@@ -379,9 +511,43 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
     g_strlcpy(n->style, o->style, sizeof(o->style));
     n->style_append = 0;
     n->bpp = o->bpp;
-    n->f = o->f;
-    n->png_ptr = o->png_ptr;
-    n->info_ptr = o->info_ptr;
+    n->compression = Z_BEST_COMPRESSION;
+    // the stored params end after bpp, the writer state was never part of them
+    n->f = NULL;
+    n->png_ptr = NULL;
+    n->info_ptr = NULL;
+    *new_size = self->params_size(self);
+    return n;
+  }
+  if(old_version == 2 && new_version == 3)
+  {
+    typedef struct dt_imageio_png_v2_t
+    {
+      int max_width, max_height;
+      int width, height;
+      char style[128];
+      gboolean style_append;
+      int bpp;
+      FILE *f;
+      png_structp png_ptr;
+      png_infop info_ptr;
+    } dt_imageio_png_v2_t;
+
+    dt_imageio_png_v2_t *o = (dt_imageio_png_v2_t *)old_params;
+    dt_imageio_png_t *n = (dt_imageio_png_t *)malloc(sizeof(dt_imageio_png_t));
+
+    n->max_width = o->max_width;
+    n->max_height = o->max_height;
+    n->width = o->width;
+    n->height = o->height;
+    g_strlcpy(n->style, o->style, sizeof(o->style));
+    n->style_append = o->style_append;
+    n->bpp = o->bpp;
+    n->compression = Z_BEST_COMPRESSION;
+    // the stored params end after bpp, the writer state was never part of them
+    n->f = NULL;
+    n->png_ptr = NULL;
+    n->info_ptr = NULL;
     *new_size = self->params_size(self);
     return n;
   }
@@ -395,6 +561,8 @@ void *get_params(dt_imageio_module_format_t *self)
     d->bpp = 8;
   else
     d->bpp = 16;
+  d->compression = CLAMP(dt_conf_get_int("plugins/imageio/format/png/compression"), Z_NO_COMPRESSION,
+                         Z_BEST_COMPRESSION);
   return d;
 }
 
@@ -413,6 +581,7 @@ int set_params(dt_imageio_module_format_t *self, const void *params, const int s
   else
     dt_bauhaus_combobox_set(g->bit_depth, 1);
   dt_conf_set_int("plugins/imageio/format/png/bpp", d->bpp);
+  dt_bauhaus_slider_set(g->compression, d->compression);
   return 0;
 }
 
@@ -447,23 +616,30 @@ static void bit_depth_changed(GtkWidget *widget, gpointer user_data)
   dt_conf_set_int("plugins/imageio/format/png/bpp", bpp);
 }
 
+static void compression_level_changed(GtkWidget *slider, gpointer user_data)
+{
+  const int compression = (int)dt_bauhaus_slider_get(slider);
+  dt_conf_set_int("plugins/imageio/format/png/compression", compression);
+}
+
 void init(dt_imageio_module_format_t *self)
 {
 #ifdef USE_LUA
   luaA_struct(darktable.lua_state.state, dt_imageio_png_t);
   dt_lua_register_module_member(darktable.lua_state.state, self, dt_imageio_png_t, bpp, int);
+  dt_lua_register_module_member(darktable.lua_state.state, self, dt_imageio_png_t, compression, int);
 #endif
 }
 void cleanup(dt_imageio_module_format_t *self)
 {
 }
 
-// TODO: some quality/compression stuff?
 void gui_init(dt_imageio_module_format_t *self)
 {
   dt_imageio_png_gui_t *gui = (dt_imageio_png_gui_t *)malloc(sizeof(dt_imageio_png_gui_t));
   self->gui_data = (void *)gui;
   const int bpp = dt_conf_get_int("plugins/imageio/format/png/bpp");
+  const int compression = dt_conf_get_int("plugins/imageio/format/png/compression");
   self->widget = gtk_box_new(GTK_ORIENTATION_VERTICAL, DT_PIXEL_APPLY_DPI(5));
 
   gui->bit_depth = dt_bauhaus_combobox_new(NULL);
@@ -473,6 +649,15 @@ void gui_init(dt_imageio_module_format_t *self)
   dt_bauhaus_combobox_set(gui->bit_depth, bpp);
   gtk_box_pack_start(GTK_BOX(self->widget), gui->bit_depth, TRUE, TRUE, 0);
   g_signal_connect(G_OBJECT(gui->bit_depth), "value-changed", G_CALLBACK(bit_depth_changed), NULL);
+
+  gui->compression = dt_bauhaus_slider_new_with_range(NULL, Z_NO_COMPRESSION, Z_BEST_COMPRESSION, 1, 6, 0);
+  dt_bauhaus_widget_set_label(gui->compression, NULL, _("compression"));
+  dt_bauhaus_slider_set_default(gui->compression, 6);
+  g_object_set(G_OBJECT(gui->compression), "tooltip-text",
+               _("deflate level, 0 is fastest, 9 gives the smallest files"), (char *)NULL);
+  dt_bauhaus_slider_set(gui->compression, compression);
+  gtk_box_pack_start(GTK_BOX(self->widget), gui->compression, TRUE, TRUE, 0);
+  g_signal_connect(G_OBJECT(gui->compression), "value-changed", G_CALLBACK(compression_level_changed), NULL);
 }
 
 void gui_cleanup(dt_imageio_module_format_t *self)
@@ -25,6 +25,8 @@
 #include "common/darktable.h"
 #include "common/imageio_module.h"
 #include "common/imageio.h"
+#include "common/imageio_convert.h"
+#include "common/imageio_tiff.h"
 #include "common/exif.h"
 #include "common/colorspaces.h"
 #include "control/conf.h"
@@ -50,6 +52,35 @@ typedef struct dt_imageio_tiff_gui_t
   GtkWidget *compress;
 } dt_imageio_tiff_gui_t;
 
+#define ZIPQUALITY 9
+
+static void _convert_row(const dt_imageio_tiff_t *d, const void *in_void, const int y, void *rowdata)
+{
+  const size_t offset = (size_t)4 * y * d->width;
+  if(d->bpp == 32)
+    dt_imageio_convert_row_float((const float *)in_void + offset, rowdata, d->width, DT_IMAGEIO_CONVERT_RGB);
+  else if(d->bpp == 16)
+    dt_imageio_convert_row_u16((const uint16_t *)in_void + offset, rowdata, d->width, DT_IMAGEIO_CONVERT_RGB);
+  else
+    dt_imageio_convert_row_u8((const uint8_t *)in_void + offset, rowdata, d->width, DT_IMAGEIO_CONVERT_RGB);
+}
+
+typedef struct _strips_t
+{
+  const dt_imageio_tiff_t *d;
+  const void *in;
+  int rows_per_strip;
+  size_t rowsize;
+} _strips_t;
+
+static int _fill_strip(void *data, const int strip, uint8_t *buf)
+{
+  const _strips_t *s = (const _strips_t *)data;
+  const int y0 = strip * s->rows_per_strip;
+  const int rows = MIN(s->rows_per_strip, s->d->height - y0);
+  for(int y = 0; y < rows; y++) _convert_row(s->d, s->in, y0 + y, buf + y * s->rowsize);
+  return rows;
+}
 
 int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const void *in_void, void *exif,
                 int exif_len, int imgid, int num, int total)
@@ -64,6 +95,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   void *rowdata = NULL;
 
   int rc = 1; // default to error
+  int predictor = 1;
 
   if(imgid > 0)
   {
@@ -101,22 +133,21 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   {
     TIFFSetField(tif, TIFFTAG_COMPRESSION, (uint16_t)COMPRESSION_ADOBE_DEFLATE);
     TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)1);
-    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)9);
+    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)ZIPQUALITY);
   }
   else if(d->compress == 2)
   {
     TIFFSetField(tif, TIFFTAG_COMPRESSION, (uint16_t)COMPRESSION_ADOBE_DEFLATE);
     TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)2);
-    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)9);
+    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)ZIPQUALITY);
+    predictor = 2;
   }
   else if(d->compress == 3)
   {
     TIFFSetField(tif, TIFFTAG_COMPRESSION, (uint16_t)COMPRESSION_ADOBE_DEFLATE);
-    if(d->bpp == 32)
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)3);
-    else
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)2);
-    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)9);
+    predictor = (d->bpp == 32) ? 3 : 2;
+    TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)predictor);
+    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)ZIPQUALITY);
   }
   else // (d->compress == 0)
   {
@@ -135,7 +166,9 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32_t)d->height);
   TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, (uint16_t)PHOTOMETRIC_RGB);
   TIFFSetField(tif, TIFFTAG_PLANARCONFIG, (uint16_t)PLANARCONFIG_CONTIG);
-  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32_t)1);
+  const int rows_per_strip
+      = CLAMP(dt_conf_get_int("plugins/imageio/format/tiff/rows_per_strip"), 1, MAX(d->height, 1));
+  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32_t)rows_per_strip);
   TIFFSetField(tif, TIFFTAG_ORIENTATION, (uint16_t)ORIENTATION_TOPLEFT);
 
   int resolution = dt_conf_get_int("metadata/resolution");
@@ -146,6 +179,16 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, (uint16_t)RESUNIT_INCH);
   }
 
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  // convert, predict and deflate the strips on all threads, libtiff only gets to write them
+  _strips_t strips = { d, in_void, rows_per_strip, (size_t)d->width * 3 * d->bpp / 8 };
+  if(dt_imageio_tiff_write_chunks(tif, 0, (d->height + rows_per_strip - 1) / rows_per_strip, strips.rowsize,
+                                  rows_per_strip, d->bpp, 3, predictor, d->compress != 0, _fill_strip, &strips))
+  {
+    rc = 1;
+    goto exit;
+  }
+#else
   const size_t rowsize = (d->width * 3) * d->bpp / 8;
   if((rowdata = malloc(rowsize)) == NULL)
   {
@@ -153,63 +196,17 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     goto exit;
   }
 
-  if(d->bpp == 32)
-  {
-    for(int y = 0; y < d->height; y++)
-    {
-      float *in = (float *)in_void + (size_t)4 * y * d->width;
-      float *out = (float *)rowdata;
-
-      for(int x = 0; x < d->width; x++, in += 4, out += 3)
-      {
-        memcpy(out, in, 3 * sizeof(float));
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-  else if(d->bpp == 16)
+  for(int y = 0; y < d->height; y++)
   {
-    for(int y = 0; y < d->height; y++)
-    {
-      uint16_t *in = (uint16_t *)in_void + (size_t)4 * y * d->width;
-      uint16_t *out = (uint16_t *)rowdata;
+    _convert_row(d, in_void, y, rowdata);
 
-      for(int x = 0; x < d->width; x++, in += 4, out += 3)
-      {
-        memcpy(out, in, 3 * sizeof(uint16_t));
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-  else
-  {
-    for(int y = 0; y < d->height; y++)
+    if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
     {
-      uint8_t *in = (uint8_t *)in_void + (size_t)4 * y * d->width;
-      uint8_t *out = (uint8_t *)rowdata;
-
-      for(int x = 0; x < d->width; x++, in += 4, out += 3)
-      {
-        memcpy(out, in, 3 * sizeof(uint8_t));
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
+      rc = 1;
+      goto exit;
     }
   }
+#endif
 
   // success
   rc = 0;
@@ -335,11 +332,6 @@ int bpp(dt_imageio_module_data_t *p)
   return ((dt_imageio_tiff_t *)p)->bpp;
 }
 
-int compress(dt_imageio_module_data_t *p)
-{
-  return ((dt_imageio_tiff_t *)p)->compress;
-}
-
 int levels(dt_imageio_module_data_t *p)
 {
   int ret = IMAGEIO_RGB;
@@ -449,6 +441,8 @@ int flags(dt_imageio_module_data_t *data)
   return FORMAT_FLAGS_SUPPORT_XMP;
 }
 
+#undef ZIPQUALITY
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -31,7 +31,7 @@
 
 #include <webp/encode.h>
 
-DT_MODULE(2)
+DT_MODULE(3)
 
 typedef enum
 {
@@ -58,6 +58,7 @@ typedef struct dt_imageio_webp_t
   int comp_type;
   int quality;
   int hint;
+  int method;
 } dt_imageio_webp_t;
 
 typedef struct dt_imageio_webp_gui_data_t
@@ -65,6 +66,7 @@ typedef struct dt_imageio_webp_gui_data_t
   GtkWidget *compression;
   GtkWidget *quality;
   GtkWidget *hint;
+  GtkWidget *method;
 } dt_imageio_webp_gui_data_t;
 
 static const char *const EncoderError[] = {
@@ -96,6 +98,7 @@ void init(dt_imageio_module_format_t *self)
   luaA_enum_value(darktable.lua_state.state, hint_t, hint_photo);
   luaA_enum_value(darktable.lua_state.state, hint_t, hint_graphic);
   dt_lua_register_module_member(darktable.lua_state.state, self, dt_imageio_webp_t, hint, hint_t);
+  dt_lua_register_module_member(darktable.lua_state.state, self, dt_imageio_webp_t, method, int);
 #endif
 }
 void cleanup(dt_imageio_module_format_t *self)
@@ -120,6 +123,10 @@ int write_image(dt_imageio_module_data_t *webp, const char *filename, const void
   // TODO(jinxos): expose more config options in the UI
   config.lossless = webp_data->comp_type;
   config.image_hint = webp_data->hint;
+  // 0 is fastest, 6 gives the smallest files
+  config.method = CLAMP(webp_data->method, 0, 6);
+  // let libwebp use its worker threads (analysis, and filtering/entropy coding for lossless)
+  config.thread_level = 1;
 
   // these are to allow for large image export.
   // TODO(jinxos): these values should be adjusted as needed and ideally determined at runtime.
@@ -184,7 +191,7 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
                     const size_t old_params_size, const int old_version, const int new_version,
                     size_t *new_size)
 {
-  if(old_version == 1 && new_version == 2)
+  if(old_version == 1 && new_version == 3)
   {
     typedef struct dt_imageio_webp_v1_t
     {
@@ -209,6 +216,36 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
     n->comp_type = o->comp_type;
     n->quality = o->quality;
     n->hint = o->hint;
+    n->method = 4;
+    *new_size = self->params_size(self);
+    return n;
+  }
+  if(old_version == 2 && new_version == 3)
+  {
+    typedef struct dt_imageio_webp_v2_t
+    {
+      int max_width, max_height;
+      int width, height;
+      char style[128];
+      gboolean style_append;
+      int comp_type;
+      int quality;
+      int hint;
+    } dt_imageio_webp_v2_t;
+
+    dt_imageio_webp_v2_t *o = (dt_imageio_webp_v2_t *)old_params;
+    dt_imageio_webp_t *n = (dt_imageio_webp_t *)malloc(sizeof(dt_imageio_webp_t));
+
+    n->max_width = o->max_width;
+    n->max_height = o->max_height;
+    n->width = o->width;
+    n->height = o->height;
+    g_strlcpy(n->style, o->style, sizeof(o->style));
+    n->style_append = o->style_append;
+    n->comp_type = o->comp_type;
+    n->quality = o->quality;
+    n->hint = o->hint;
+    n->method = 4;
     *new_size = self->params_size(self);
     return n;
   }
@@ -223,6 +260,7 @@ void *get_params(dt_imageio_module_format_t *self)
   else
     d->quality = 100;
   d->hint = dt_conf_get_int("plugins/imageio/format/webp/hint");
+  d->method = dt_conf_get_int("plugins/imageio/format/webp/method");
   return d;
 }
 
@@ -234,6 +272,7 @@ int set_params(dt_imageio_module_format_t *self, const void *params, const int s
   dt_bauhaus_combobox_set(g->compression, d->comp_type);
   dt_bauhaus_slider_set(g->quality, d->quality);
   dt_bauhaus_combobox_set(g->hint, d->hint);
+  dt_bauhaus_slider_set(g->method, d->method);
   return 0;
 }
 
@@ -286,6 +325,12 @@ static void hint_combobox_changed(GtkWidget *widget, gpointer user_data)
   dt_conf_set_int("plugins/imageio/format/webp/hint", hint);
 }
 
+static void method_changed(GtkWidget *slider, gpointer user_data)
+{
+  const int method = (int)dt_bauhaus_slider_get(slider);
+  dt_conf_set_int("plugins/imageio/format/webp/method", method);
+}
+
 void gui_init(dt_imageio_module_format_t *self)
 {
   dt_imageio_webp_gui_data_t *gui = (dt_imageio_webp_gui_data_t *)malloc(sizeof(dt_imageio_webp_gui_data_t));
@@ -293,6 +338,7 @@ void gui_init(dt_imageio_module_format_t *self)
   const int comp_type = dt_conf_get_int("plugins/imageio/format/webp/comp_type");
   const int quality = dt_conf_get_int("plugins/imageio/format/webp/quality");
   const int hint = dt_conf_get_int("plugins/imageio/format/webp/hint");
+  const int method = dt_conf_get_int("plugins/imageio/format/webp/method");
 
   self->widget = gtk_box_new(GTK_ORIENTATION_VERTICAL, DT_PIXEL_APPLY_DPI(5));
 
@@ -329,6 +375,17 @@ void gui_init(dt_imageio_module_format_t *self)
   dt_bauhaus_combobox_set(gui->hint, hint);
   gtk_box_pack_start(GTK_BOX(self->widget), gui->hint, TRUE, TRUE, 0);
   g_signal_connect(G_OBJECT(gui->hint), "value-changed", G_CALLBACK(hint_combobox_changed), NULL);
+
+  gui->method = dt_bauhaus_slider_new_with_range(NULL, 0, 6, 1, 4, 0);
+  dt_bauhaus_widget_set_label(gui->method, NULL, _("method"));
+  dt_bauhaus_slider_set_default(gui->method, 4);
+  g_object_set(G_OBJECT(gui->method), "tooltip-text",
+               _("trade-off between encoding speed and file size.\n"
+                 "0 is fastest, 6 is slowest and gives the smallest files"),
+               (char *)NULL);
+  dt_bauhaus_slider_set(gui->method, method);
+  gtk_box_pack_start(GTK_BOX(self->widget), gui->method, TRUE, TRUE, 0);
+  g_signal_connect(G_OBJECT(gui->method), "value-changed", G_CALLBACK(method_changed), NULL);
 }
 
 void gui_cleanup(dt_imageio_module_format_t *self)
@@ -34,11 +34,20 @@
 #include "common/imageio_storage.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <glib.h>
 #include <glib/gstdio.h>
+#ifdef USE_LUA
+#include "lua/lua.h"
+#include "lua/events.h"
+#endif
 
 DT_MODULE(2)
 
+// written files are fsync'ed in groups of this many
+#define DISK_SYNC_BATCH 8
+
 // gui data
 typedef struct disk_t
 {
@@ -46,12 +55,35 @@ typedef struct disk_t
   GtkWidget *overwrite;
 } disk_t;
 
+/*
+ * write-behind queue of one export job: images are encoded into temporary files in the (usually local, fast)
+ * tmp directory, and a few i/o threads move them to their target while the next image is already processed.
+ */
+typedef struct _write_behind_t
+{
+  GThreadPool *pool;
+  GMutex mutex;
+  GCond cond;
+  int pending;         // files handed to the i/o threads and not done yet
+  int max_pending;     // bounds the amount of temporary data
+  GHashTable *targets; // all file names claimed by this export, written or not
+  GList *unsynced;     // written, but not fsync'ed yet
+  int failed;
+} _write_behind_t;
+
+typedef struct _write_job_t
+{
+  char *tmpname;
+  char *filename;
+} _write_job_t;
+
 // saved params
 typedef struct dt_imageio_disk_t
 {
   char filename[DT_MAX_PATH_FOR_PARAMS];
   gboolean overwrite;
   dt_variables_params_t *vp;
+  _write_behind_t *wb;
 } dt_imageio_disk_t;
 
 
@@ -186,6 +218,151 @@ void gui_reset(dt_imageio_module_storage_t *self)
   dt_bauhaus_combobox_set(d->overwrite, 0);
 }
 
+static void _sync_files(GList *files)
+{
+  // the kernel had time to write these back in the meantime, so this mostly waits for the last of them
+  for(GList *l = files; l; l = g_list_next(l))
+  {
+    const int fd = g_open((char *)l->data, O_RDONLY, 0);
+    if(fd < 0) continue;
+#ifndef __WIN32__
+    fsync(fd);
+#endif
+    close(fd);
+  }
+  g_list_free_full(files, g_free);
+}
+
+static int _move_file(const char *tmpname, const char *filename)
+{
+  // cheap if the tmp directory happens to be on the same file system. an existing file is overwritten in place
+  // instead, so it keeps its mode like it would with a synchronous export.
+  if(!g_file_test(filename, G_FILE_TEST_EXISTS) && !g_rename(tmpname, filename)) return 0;
+
+  FILE *in = g_fopen(tmpname, "rb");
+  FILE *out = g_fopen(filename, "wb");
+  const size_t bufsize = 1 << 20;
+  char *buf = malloc(bufsize);
+  int err = !in || !out || !buf;
+  while(!err)
+  {
+    const size_t n = fread(buf, 1, bufsize, in);
+    if(n && fwrite(buf, 1, n, out) != n) err = 1;
+    if(n < bufsize)
+    {
+      err |= ferror(in);
+      break;
+    }
+  }
+  if(out && fclose(out)) err = 1;
+  if(in) fclose(in);
+  free(buf);
+  g_unlink(tmpname);
+  return err;
+}
+
+static void _write_behind_run(gpointer data, gpointer user_data)
+{
+  _write_job_t *job = (_write_job_t *)data;
+  _write_behind_t *wb = (_write_behind_t *)user_data;
+
+  const int err = _move_file(job->tmpname, job->filename);
+  if(err)
+  {
+    fprintf(stderr, "[imageio_storage_disk] could not write file: `%s'!\n", job->filename);
+    dt_control_log(_("could not write file `%s'!"), job->filename);
+  }
+
+  GList *batch = NULL;
+  g_mutex_lock(&wb->mutex);
+  wb->failed |= err;
+  if(!err) wb->unsynced = g_list_prepend(wb->unsynced, job->filename);
+  if(g_list_length(wb->unsynced) >= DISK_SYNC_BATCH)
+  {
+    batch = wb->unsynced;
+    wb->unsynced = NULL;
+  }
+  g_mutex_unlock(&wb->mutex);
+
+  _sync_files(batch);
+
+  g_mutex_lock(&wb->mutex);
+  wb->pending--;
+  g_cond_broadcast(&wb->cond);
+  g_mutex_unlock(&wb->mutex);
+
+  if(err) g_free(job->filename);
+  g_free(job->tmpname);
+  free(job);
+}
+
+static void _write_behind_finish(dt_imageio_disk_t *d)
+{
+  _write_behind_t *wb = d->wb;
+  if(!wb) return;
+  d->wb = NULL;
+
+  // waits for all queued files
+  g_thread_pool_free(wb->pool, FALSE, TRUE);
+  _sync_files(wb->unsynced);
+  g_hash_table_destroy(wb->targets);
+  g_cond_clear(&wb->cond);
+  g_mutex_clear(&wb->mutex);
+  free(wb);
+}
+
+// called with darktable.plugin_threadsafe held
+static gboolean _file_taken(const dt_imageio_disk_t *d, const char *filename)
+{
+  if(g_file_test(filename, G_FILE_TEST_EXISTS)) return TRUE;
+  if(!d->wb) return FALSE;
+  g_mutex_lock(&d->wb->mutex);
+  const gboolean taken = g_hash_table_contains(d->wb->targets, filename);
+  g_mutex_unlock(&d->wb->mutex);
+  return taken;
+}
+
+int initialize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *data,
+                     dt_imageio_module_format_t **format, dt_imageio_module_data_t **fdata, GList **images,
+                     const gboolean high_quality, const gboolean upscale)
+{
+  dt_imageio_disk_t *d = (dt_imageio_disk_t *)data;
+  const int threads = dt_conf_get_int("plugins/imageio/storage/disk/write_behind");
+  if(threads <= 0) return 0;
+
+#ifdef USE_LUA
+  // the intermediate-export-image event gets the name of the written file and is handled asynchronously.
+  // scripts expect to find the exported file there, not a temporary one that is already moved away.
+  dt_lua_lock();
+  const gboolean lua_handlers = dt_lua_event_in_use(darktable.lua_state.state, "intermediate-export-image");
+  dt_lua_unlock();
+  if(lua_handlers) return 0;
+#endif
+
+  _write_behind_t *wb = (_write_behind_t *)calloc(1, sizeof(_write_behind_t));
+  g_mutex_init(&wb->mutex);
+  g_cond_init(&wb->cond);
+  wb->max_pending = 2 * threads;
+  wb->targets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  wb->pool = g_thread_pool_new(_write_behind_run, wb, threads, FALSE, NULL);
+  if(!wb->pool)
+  {
+    // just write synchronously then
+    g_hash_table_destroy(wb->targets);
+    g_cond_clear(&wb->cond);
+    g_mutex_clear(&wb->mutex);
+    free(wb);
+    return 0;
+  }
+  d->wb = wb;
+  return 0;
+}
+
+void finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *data)
+{
+  _write_behind_finish((dt_imageio_disk_t *)data);
+}
+
 int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, const int imgid,
           dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata, const int num, const int total,
           const gboolean high_quality, const gboolean upscale)
@@ -269,27 +446,76 @@ int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, co
     if(!d->overwrite)
     {
       int seq = 1;
-      if(!fail && g_file_test(filename, G_FILE_TEST_EXISTS))
+      if(!fail && _file_taken(d, filename))
       {
         do
         {
           sprintf(c, "_%.2d.%s", seq, ext);
           seq++;
-        } while(g_file_test(filename, G_FILE_TEST_EXISTS));
+        } while(_file_taken(d, filename));
       }
     }
+    // files still in the write-behind queue are not on disk yet, remember the name for the next images
+    if(!fail && d->wb)
+    {
+      g_mutex_lock(&d->wb->mutex);
+      g_hash_table_add(d->wb->targets, g_strdup(filename));
+      g_mutex_unlock(&d->wb->mutex);
+    }
   } // end of critical block
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
   if(fail) return 1;
 
-  /* export image to file */
-  if(dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, TRUE, self, sdata, num, total) != 0)
+  /* export image to file, or to a temporary one the write-behind queue moves to its place */
+  char *tmpname = NULL;
+  if(d->wb)
+  {
+    // like fopen() would, not 0600 as g_file_open_tmp(): renaming the file keeps its mode
+    gchar *template = g_strdup_printf("darktable-export-XXXXXX.%s", format->extension(fdata));
+    tmpname = g_build_filename(g_get_tmp_dir(), template, NULL);
+    g_free(template);
+    const int fd = g_mkstemp_full(tmpname, O_RDWR, 0666);
+    if(fd >= 0)
+      close(fd);
+    else
+    {
+      g_free(tmpname);
+      tmpname = NULL;
+    }
+  }
+
+  if(dt_imageio_export(imgid, tmpname ? tmpname : filename, format, fdata, high_quality, upscale, TRUE, self,
+                       sdata, num, total) != 0)
   {
     fprintf(stderr, "[imageio_storage_disk] could not export to file: `%s'!\n", filename);
     dt_control_log(_("could not export to file `%s'!"), filename);
+    if(tmpname)
+    {
+      g_unlink(tmpname);
+      g_free(tmpname);
+    }
     return 1;
   }
 
+  if(tmpname)
+  {
+    _write_behind_t *wb = d->wb;
+    _write_job_t *job = (_write_job_t *)malloc(sizeof(_write_job_t));
+    job->tmpname = tmpname;
+    job->filename = g_strdup(filename);
+
+    // don't let the encoder run too far ahead of slow targets
+    g_mutex_lock(&wb->mutex);
+    while(wb->pending >= wb->max_pending) g_cond_wait(&wb->cond, &wb->mutex);
+    wb->pending++;
+    const int failed = wb->failed;
+    g_mutex_unlock(&wb->mutex);
+
+    g_thread_pool_push(wb->pool, job, NULL);
+    // an earlier file could not be written, stop like a synchronous export would
+    if(failed) return 1;
+  }
+
   printf("[export_job] exported to `%s'\n", filename);
   char *trunc = filename + strlen(filename) - 32;
   if(trunc < filename) trunc = filename;
@@ -299,7 +525,7 @@ int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, co
 
 size_t params_size(dt_imageio_module_storage_t *self)
 {
-  return sizeof(dt_imageio_disk_t) - sizeof(void *);
+  return sizeof(dt_imageio_disk_t) - 2 * sizeof(void *);
 }
 
 void init(dt_imageio_module_storage_t *self)
@@ -322,6 +548,7 @@ void *get_params(dt_imageio_module_storage_t *self)
 
   d->vp = NULL;
   dt_variables_params_init(&d->vp);
+  d->wb = NULL;
 
   return d;
 }
@@ -329,6 +556,7 @@ void *get_params(dt_imageio_module_storage_t *self)
 void free_params(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *params)
 {
   dt_imageio_disk_t *d = (dt_imageio_disk_t *)params;
+  _write_behind_finish(d);
   dt_variables_params_destroy(d->vp);
   free(params);
 }
@@ -353,6 +581,8 @@ void export_dispatched(dt_imageio_module_storage_t *self)
   dt_bauhaus_combobox_set(g->overwrite, 0);
 }
 
+#undef DISK_SYNC_BATCH
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -330,36 +330,32 @@ int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, co
   } // end of critical block
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
-  /* export image to file */
-  if(dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, FALSE, self, sdata, num, total) != 0)
-  {
-    fprintf(stderr, "[imageio_storage_gallery] could not export to file: `%s'!\n", filename);
-    dt_control_log(_("could not export to file `%s'!"), filename);
-    return 1;
-  }
-
-  /* also export thumbnail: */
-  // write with reduced resolution:
-  const int max_width = fdata->max_width;
-  const int max_height = fdata->max_height;
-  fdata->max_width = 200;
-  fdata->max_height = 200;
-  // alter filename with -thumb:
-  char *c = filename + strlen(filename);
-  for(; c > filename && *c != '.' && *c != '/'; c--)
+  /* export image and thumbnail to file, with a single run of the pipeline: */
+  // the thumbnail is written with reduced resolution and -thumb in its filename:
+  char thumbfilename[PATH_MAX] = { 0 };
+  g_strlcpy(thumbfilename, filename, sizeof(thumbfilename));
+  char *c = thumbfilename + strlen(thumbfilename);
+  for(; c > thumbfilename && *c != '.' && *c != '/'; c--)
     ;
-  if(c <= filename || *c == '/') c = filename + strlen(filename);
+  if(c <= thumbfilename || *c == '/') c = thumbfilename + strlen(thumbfilename);
   const char *ext = format->extension(fdata);
-  sprintf(c, "-thumb.%s", ext);
-  if(dt_imageio_export(imgid, filename, format, fdata, FALSE, TRUE, FALSE, self, sdata, num, total) != 0)
+  snprintf(c, sizeof(thumbfilename) - (c - thumbfilename), "-thumb.%s", ext);
+
+  dt_imageio_module_data_t *tdata = format->get_params(format);
+  memcpy(tdata, fdata, format->params_size(format));
+  tdata->max_width = 200;
+  tdata->max_height = 200;
+
+  const dt_imageio_rendition_t renditions[2] = { { filename, format, fdata }, { thumbfilename, format, tdata } };
+  const int res
+      = dt_imageio_export_renditions(imgid, renditions, 2, high_quality, upscale, FALSE, self, sdata, num, total);
+  format->free_params(format, tdata);
+  if(res != 0)
   {
     fprintf(stderr, "[imageio_storage_gallery] could not export to file: `%s'!\n", filename);
     dt_control_log(_("could not export to file `%s'!"), filename);
     return 1;
   }
-  // restore for next image:
-  fdata->max_width = max_width;
-  fdata->max_height = max_height;
 
   printf("[export_job] exported to `%s'\n", filename);
   char *trunc = filename + strlen(filename) - 32;
@@ -107,7 +107,8 @@ int groups()
 
 int flags()
 {
-  return IOP_FLAGS_DEPRECATED | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_PREVIEW_NON_OPENCL;
+  return IOP_FLAGS_DEPRECATED | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_PREVIEW_NON_OPENCL
+         | IOP_FLAGS_PREVIEW_SIDE_EFFECTS;
 }
 
 #if 0
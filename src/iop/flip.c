@@ -174,6 +174,27 @@ static void backtransform(const int32_t *x, int32_t *o, const dt_image_orientati
   }
 }
 
+static void transform(const int32_t *x, int32_t *o, const dt_image_orientation_t orientation, const int32_t iw,
+                      const int32_t ih)
+{
+  o[0] = x[0];
+  o[1] = x[1];
+  if(orientation & ORIENTATION_FLIP_X)
+  {
+    o[1] = ih - o[1] - 1;
+  }
+  if(orientation & ORIENTATION_FLIP_Y)
+  {
+    o[0] = iw - o[0] - 1;
+  }
+  if(orientation & ORIENTATION_SWAP_XY)
+  {
+    const int32_t tmp = o[0];
+    o[0] = o[1];
+    o[1] = tmp;
+  }
+}
+
 int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *points, size_t points_count)
 {
   // if (!self->enabled) return 2;
@@ -282,6 +303,28 @@ void modify_roi_in(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *
   roi_in->height = CLAMP(roi_in->height, 1, (int)ceilf(h) - roi_in->y);
 }
 
+// exact inverse of the above, lets the tiling code skip its search for the output tile of an input tile
+void invert_roi_in(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                   const dt_iop_roi_t *roi_in, dt_iop_roi_t *roi_out)
+{
+  dt_iop_flip_data_t *d = (dt_iop_flip_data_t *)piece->data;
+
+  int32_t p[2], o[2],
+      aabb[4] = { roi_in->x, roi_in->y, roi_in->x + roi_in->width - 1, roi_in->y + roi_in->height - 1 };
+  int32_t aabb_out[4] = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+  for(int c = 0; c < 4; c++)
+  {
+    get_corner(aabb, c, p);
+    transform(p, o, d->orientation, piece->buf_in.width * roi_in->scale, piece->buf_in.height * roi_in->scale);
+    adjust_aabb(o, aabb_out);
+  }
+
+  roi_out->x = aabb_out[0];
+  roi_out->y = aabb_out[1];
+  roi_out->width = aabb_out[2] - aabb_out[0] + 1;
+  roi_out->height = aabb_out[3] - aabb_out[1] + 1;
+}
+
 // 3rd (final) pass: you get this input region (may be different from what was requested above),
 // do your best to fill the output region!
 void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *ivoid, void *ovoid,
@@ -67,7 +67,7 @@ int groups()
 
 int flags()
 {
-  return IOP_FLAGS_ONE_INSTANCE;
+  return IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_ALLOW_PATCHING;
 }
 
 void init_key_accels(dt_iop_module_so_t *self)
@@ -68,7 +68,7 @@ int groups()
 
 int flags()
 {
-  return IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_IMAGE_INDEPENDENT;
 }
 
 void init_key_accels(dt_iop_module_so_t *self)
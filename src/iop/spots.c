@@ -44,7 +44,17 @@ typedef struct dt_iop_spots_gui_data_t
   GtkWidget *bt_path, *bt_circle, *bt_ellipse;
 } dt_iop_spots_gui_data_t;
 
-typedef struct dt_iop_spots_params_t dt_iop_spots_data_t;
+typedef struct dt_iop_spots_data_t
+{
+  int clone_id[64];
+  int clone_algo[64];
+  // the forms as of the last dirty_rect(), to tell which parts of the image an edit touched
+  int num_forms;
+  int form_id[64];
+  uint64_t form_hash[64];
+  dt_iop_roi_t form_area[64];
+  uint64_t blend_hash;
+} dt_iop_spots_data_t;
 
 // this returns a translatable name
 const char *name()
@@ -59,7 +69,7 @@ int groups()
 
 int flags()
 {
-  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_NO_MASKS;
+  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_NO_MASKS | IOP_FLAGS_ALLOW_PATCHING;
 }
 
 int legacy_params(dt_iop_module_t *self, const void *const old_params, const int old_version,
@@ -361,7 +371,7 @@ static int masks_get_delta(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
 void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *i, void *o,
              const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out)
 {
-  dt_iop_spots_params_t *d = (dt_iop_spots_params_t *)piece->data;
+  dt_iop_spots_data_t *d = (dt_iop_spots_data_t *)piece->data;
   dt_develop_blend_params_t *bp = self->blend_params;
 
   const int ch = piece->colors;
@@ -587,15 +597,108 @@ void gui_focus(struct dt_iop_module_t *self, gboolean in)
 void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *params, dt_dev_pixelpipe_t *pipe,
                    dt_dev_pixelpipe_iop_t *piece)
 {
-  memcpy(piece->data, params, sizeof(dt_iop_spots_params_t));
+  dt_iop_spots_params_t *p = (dt_iop_spots_params_t *)params;
+  dt_iop_spots_data_t *d = (dt_iop_spots_data_t *)piece->data;
+  memcpy(d->clone_id, p->clone_id, sizeof(d->clone_id));
+  memcpy(d->clone_algo, p->clone_algo, sizeof(d->clone_algo));
 }
 
 void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  piece->data = malloc(sizeof(dt_iop_spots_data_t));
+  piece->data = calloc(1, sizeof(dt_iop_spots_data_t));
   self->commit_params(self, self->default_params, pipe, piece);
 }
 
+static void _rect_union(dt_iop_roi_t *a, const dt_iop_roi_t *b)
+{
+  if(b->width <= 0 || b->height <= 0) return;
+  if(a->width <= 0 || a->height <= 0)
+  {
+    *a = *b;
+    return;
+  }
+  const int x1 = MAX(a->x + a->width, b->x + b->width), y1 = MAX(a->y + a->height, b->y + b->height);
+  a->x = MIN(a->x, b->x);
+  a->y = MIN(a->y, b->y);
+  a->width = x1 - a->x;
+  a->height = y1 - a->y;
+}
+
+static uint64_t _hash_bytes(uint64_t hash, const void *data, const size_t size)
+{
+  const char *str = (const char *)data;
+  for(size_t i = 0; i < size; i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash;
+}
+
+/** a spot only changes the image where it is pasted, so edits touch the old and new place of the spots that
+ * were added, removed or changed. */
+int dirty_rect(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, dt_iop_roi_t *rect)
+{
+  dt_iop_spots_data_t *d = (dt_iop_spots_data_t *)piece->data;
+  dt_develop_blend_params_t *bp = (dt_develop_blend_params_t *)piece->blendop_data;
+
+  // blending applies to all of the image
+  const uint64_t blend_hash = _hash_bytes(5381, bp, sizeof(dt_develop_blend_params_t));
+  const int known = (blend_hash == d->blend_hash);
+  d->blend_hash = blend_hash;
+
+  int num = 0;
+  int id[64];
+  uint64_t hash[64];
+  dt_iop_roi_t area[64];
+  dt_masks_form_t *grp = dt_masks_get_from_id(self->dev, bp->mask_id);
+  if(grp && (grp->type & DT_MASKS_GROUP))
+  {
+    // same order as in process(), which also decides which spot ends up on top
+    int pos = 0;
+    for(GList *forms = g_list_first(grp->points); forms && pos < 64; forms = g_list_next(forms), pos++)
+    {
+      dt_masks_point_group_t *grpt = (dt_masks_point_group_t *)forms->data;
+      dt_masks_form_t *form = dt_masks_get_from_id(self->dev, grpt->formid);
+      if(!form) continue;
+
+      uint64_t h = dt_masks_form_get_hash(self->dev, form);
+      h = _hash_bytes(h, &pos, sizeof(int));
+      h = _hash_bytes(h, &d->clone_algo[pos], sizeof(int));
+      h = _hash_bytes(h, &grpt->state, sizeof(int));
+      h = _hash_bytes(h, &grpt->opacity, sizeof(float));
+
+      int fw, fh, fl, ft;
+      area[num] = (dt_iop_roi_t){ 0, 0, 0, 0, 1.0f };
+      if(dt_masks_get_area(self, piece, form, &fw, &fh, &fl, &ft))
+        area[num] = (dt_iop_roi_t){ fl, ft, fw, fh, 1.0f };
+      id[num] = form->formid;
+      hash[num] = h;
+      num++;
+    }
+  }
+
+  dt_iop_roi_t dirty = { 0, 0, 0, 0, 1.0f };
+  for(int k = 0; k < num; k++)
+  {
+    int j = 0;
+    while(j < d->num_forms && d->form_id[j] != id[k]) j++;
+    if(j < d->num_forms && d->form_hash[j] == hash[k]) continue;
+    _rect_union(&dirty, &area[k]);
+    if(j < d->num_forms) _rect_union(&dirty, &d->form_area[j]);
+  }
+  for(int j = 0; j < d->num_forms; j++)
+  {
+    int k = 0;
+    while(k < num && id[k] != d->form_id[j]) k++;
+    if(k == num) _rect_union(&dirty, &d->form_area[j]);
+  }
+
+  d->num_forms = num;
+  memcpy(d->form_id, id, sizeof(int) * num);
+  memcpy(d->form_hash, hash, sizeof(uint64_t) * num);
+  memcpy(d->form_area, area, sizeof(dt_iop_roi_t) * num);
+
+  *rect = dirty;
+  return known;
+}
+
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   free(piece->data);
@@ -148,7 +148,8 @@ int groups()
 
 int flags()
 {
-  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_IMAGE_INDEPENDENT
+         | IOP_FLAGS_PREVIEW_SIDE_EFFECTS;
 }
 
 int legacy_params(dt_iop_module_t *self, const void *const old_params, const int old_version,
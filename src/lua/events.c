@@ -55,6 +55,26 @@ void dt_lua_event_trigger(lua_State *L, const char *event, int nargs)
   dt_lua_redraw_screen();
 }
 
+gboolean dt_lua_event_in_use(lua_State *L, const char *event)
+{
+  lua_getfield(L, LUA_REGISTRYINDEX, "dt_lua_event_list");
+  if(lua_isnil(L, -1))
+  { // events have been disabled
+    lua_pop(L, 1);
+    return FALSE;
+  }
+  lua_getfield(L, -1, event);
+  if(lua_isnil(L, -1))
+  { // event doesn't exist
+    lua_pop(L, 2);
+    return FALSE;
+  }
+  lua_getfield(L, -1, "in_use");
+  const gboolean in_use = lua_toboolean(L, -1);
+  lua_pop(L, 3);
+  return in_use;
+}
+
 int dt_lua_event_trigger_wrapper(lua_State *L) 
 {
   const char*event = luaL_checkstring(L,1);
@@ -17,6 +17,7 @@
 */
 #ifndef DT_LUA_EVENTS_H
 #define DT_LUA_EVENTS_H
+#include <glib.h>
 #include <lualib.h>
 #include <lua.h>
 #include <lauxlib.h>
@@ -51,6 +52,11 @@ void dt_lua_event_add(lua_State *L, const char *evt_name);
   */
 void dt_lua_event_trigger(lua_State *L, const char *event, int nargs);
 
+/**
+  check if any handler is registered for an event, the lua lock has to be held
+  */
+gboolean dt_lua_event_in_use(lua_State *L, const char *event);
+
 /**
   wrapper for the previous function to use with dt_lua_do_chunk_async
   first parameter is the event name
@@ -178,10 +178,12 @@ void expose(
     dt_pthread_mutex_lock(mutex);
     wd = dev->pipe->backbuf_width;
     ht = dev->pipe->backbuf_height;
+    // a coarse pass of progressive refinement is shown magnified until the full one is done
+    const int downscale = dev->pipe->backbuf_downscale;
     stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, wd);
     surface = dt_cairo_image_surface_create_for_data(dev->pipe->backbuf, CAIRO_FORMAT_RGB24, wd, ht, stride);
-    wd /= darktable.gui->ppd;
-    ht /= darktable.gui->ppd;
+    wd = wd * downscale / darktable.gui->ppd;
+    ht = ht * downscale / darktable.gui->ppd;
     if(dev->full_preview)
       cairo_set_source_rgb(cr, .1, .1, .1);
     else
@@ -195,7 +197,15 @@ void expose(
     }
     cairo_rectangle(cr, 0, 0, wd, ht);
     cairo_set_source_surface(cr, surface, 0, 0);
-    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);
+    if(downscale > 1)
+    {
+      cairo_matrix_t matrix;
+      cairo_matrix_init_scale(&matrix, 1.0 / downscale, 1.0 / downscale);
+      cairo_pattern_set_matrix(cairo_get_source(cr), &matrix);
+      cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+    }
+    else
+      cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);
     cairo_fill_preserve(cr);
     cairo_set_line_width(cr, 1.0);
     cairo_set_source_rgb(cr, .3, .3, .3);
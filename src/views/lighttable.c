@@ -103,6 +103,28 @@ typedef struct dt_library_t
 
   int32_t collection_count;
 
+  // what memory.collected_images currently holds, so that a change of only the filters can be applied as a
+  // delta instead of collecting everything again
+  uint64_t collected_base_hash;
+  gchar *collected_filter;
+  uint32_t collected_count;
+  gboolean collected_valid;
+
+  // the collection in display order, so that scrolling doesn't have to go through sqlite for every expose
+  int32_t *collected_ids;
+  uint32_t collected_ids_count;
+
+  // thumbnails are prefetched ahead of the scroll direction
+  struct
+  {
+    int32_t offset;       // first visible image at the last expose
+    double time;          // and when that was
+    float velocity;       // in rows per second, smoothed
+    int direction;        // 1 downwards, -1 upwards
+    int32_t from, to;     // images already queued
+    dt_mipmap_size_t mip; // at this size
+  } prefetch;
+
   // stuff for the audio player
   GPid audio_player_pid;   // the pid of the child process
   int32_t audio_player_id; // the imgid of the image the audio is played for
@@ -260,12 +282,80 @@ void zoom_around_image(dt_library_t *lib, double pointerx, double pointery, int
   lib->images_in_row = new_images_in_row;
 }
 
+// look ahead at least half a page, and further the faster the user scrolls, up to a few pages
+#define DT_LIBRARY_PREFETCH_SECONDS 1.0f
+#define DT_LIBRARY_PREFETCH_PAGES 4
+
 static void _view_lighttable_collection_listener_callback(gpointer instance, gpointer user_data)
 {
   dt_view_t *self = (dt_view_t *)user_data;
   _update_collected_images(self);
 }
 
+/* if only the filters of the collection changed and the new collection is a subset of the old one, it is
+ * enough to drop the images which don't pass the new filters. the order of the rest stays the same. returns
+ * TRUE if memory.collected_images is up to date afterwards. */
+static gboolean _update_collected_images_delta(dt_library_t *lib, const uint64_t base_hash, const gchar *where,
+                                               const gchar *filter, const uint32_t count)
+{
+  if(!lib->collected_valid || !where || !filter || base_hash != lib->collected_base_hash
+     || count > lib->collected_count)
+    return FALSE;
+  if(lib->collected_filter && !strcmp(filter, lib->collected_filter)) return FALSE;
+
+  sqlite3_stmt *stmt;
+  // the whole where clause, images can have left the base set too (tags, film rolls) without the query changing
+  gchar *query = g_strdup_printf("DELETE FROM memory.collected_images WHERE NOT EXISTS (SELECT 1 FROM images "
+                                 "WHERE images.id = memory.collected_images.imgid AND (%s))",
+                                 where);
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), query, NULL, NULL, NULL);
+  g_free(query);
+
+  // images can also have left the collection for other reasons meanwhile, then we rebuild anyway
+  uint32_t remaining = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT COUNT(*) FROM memory.collected_images", -1,
+                              &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW) remaining = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+
+  return remaining == count;
+}
+
+static void _update_collected_ids(dt_library_t *lib)
+{
+  sqlite3_stmt *stmt;
+  uint32_t size = MAX(dt_collection_get_count(darktable.collection), 64);
+  uint32_t count = 0;
+  int32_t *ids = (int32_t *)malloc(sizeof(int32_t) * size);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT imgid FROM memory.collected_images ORDER BY rowid", -1, &stmt, NULL);
+  while(ids && sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    if(count == size)
+    {
+      size *= 2;
+      int32_t *grown = (int32_t *)realloc(ids, sizeof(int32_t) * size);
+      if(!grown)
+      {
+        free(ids);
+        ids = NULL;
+        break;
+      }
+      ids = grown;
+    }
+    ids[count++] = sqlite3_column_int(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+
+  free(lib->collected_ids);
+  lib->collected_ids = ids;
+  lib->collected_ids_count = ids ? count : 0;
+
+  // whatever is queued belongs to the old collection
+  lib->prefetch.mip = DT_MIPMAP_NONE;
+}
+
 static void _update_collected_images(dt_view_t *self)
 {
   dt_library_t *lib = (dt_library_t *)self->data;
@@ -276,6 +366,19 @@ static void _update_collected_images(dt_view_t *self)
   const gchar *query = dt_collection_get_query(darktable.collection);
   if(!query) return;
 
+  const uint64_t base_hash = dt_collection_get_base_hash(darktable.collection);
+  const gchar *where = dt_collection_get_where(darktable.collection);
+  const gchar *filter = dt_collection_get_filter_where(darktable.collection);
+  const uint32_t count = dt_collection_get_count(darktable.collection);
+
+  const gboolean delta = _update_collected_images_delta(lib, base_hash, where, filter, count);
+  lib->collected_valid = TRUE;
+  lib->collected_base_hash = base_hash;
+  lib->collected_count = count;
+  g_free(lib->collected_filter);
+  lib->collected_filter = g_strdup(filter);
+  if(delta) goto done;
+
   // we have a new query for the collection of images to display. For speed reason we collect all images into
   // a temporary (in-memory) table (collected_images).
   //
@@ -337,6 +440,9 @@ static void _update_collected_images(dt_view_t *self)
     }
   }
 
+done:
+  _update_collected_ids(lib);
+
   /* if we have a statment lets clean it */
   if(lib->statements.main_query) sqlite3_finalize(lib->statements.main_query);
 
@@ -406,6 +512,8 @@ void init(dt_view_t *self)
   lib->full_res_thumb = 0;
   lib->full_res_thumb_id = -1;
   lib->audio_player_id = -1;
+  lib->prefetch.direction = 1;
+  lib->prefetch.mip = DT_MIPMAP_NONE;
 
   /* setup collection listener and initialize main_query statement */
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED,
@@ -431,6 +539,8 @@ void cleanup(dt_view_t *self)
   dt_conf_set_float("lighttable/ui/zoom_y", lib->zoom_y);
   if(lib->audio_player_id != -1) _stop_audio(lib);
   free(lib->full_res_thumb);
+  g_free(lib->collected_filter);
+  free(lib->collected_ids);
   free(self->data);
 }
 
@@ -453,12 +563,69 @@ grid_to_index (int row, int col, int stride, int offset)
 }
 #endif
 
+/* queue the thumbnails of the next pages in scroll direction as speculative prefetches, nearest first. what's
+ * queued already isn't asked for again while the user keeps scrolling the same way, everything still waiting
+ * is dropped once the direction changes or the view jumps elsewhere. */
+static void _prefetch_ahead(dt_library_t *lib, const int32_t offset, const int iir, const int max_rows,
+                            const dt_mipmap_size_t mip)
+{
+  const int32_t moved = offset - lib->prefetch.offset;
+  if(!moved && mip == lib->prefetch.mip) return;
+
+  const double now = dt_get_wtime();
+  const float dt = now - lib->prefetch.time;
+  const int32_t page = max_rows * iir;
+  int restart = mip != lib->prefetch.mip || abs(moved) > DT_LIBRARY_PREFETCH_PAGES * page;
+  if(moved)
+  {
+    const int direction = moved > 0 ? 1 : -1;
+    if(direction != lib->prefetch.direction) restart = 1;
+    lib->prefetch.direction = direction;
+    // forget about the past after a pause
+    const float velocity = abs(moved) / (float)iir / MAX(dt, 1e-3f);
+    lib->prefetch.velocity = dt > 0.5f ? velocity : 0.5f * (lib->prefetch.velocity + velocity);
+  }
+  lib->prefetch.offset = offset;
+  lib->prefetch.time = now;
+
+  if(restart)
+  {
+    dt_mipmap_cache_prefetch_cancel_ahead(darktable.mipmap_cache);
+    lib->prefetch.mip = mip;
+    lib->prefetch.from = lib->prefetch.to = lib->prefetch.direction > 0 ? offset + page : offset;
+  }
+
+  // don't push the visible thumbnails out of the cache
+  const size_t quota = darktable.mipmap_cache->mip_thumbs.cache.cost_quota;
+  const size_t thumb = darktable.mipmap_cache->buffer_size[mip];
+  const int max_ahead = thumb ? MIN(DT_LIBRARY_PREFETCH_PAGES * page, quota / 2 / thumb) : 0;
+  const int rows = max_rows / 2 + 1 + (int)(lib->prefetch.velocity * DT_LIBRARY_PREFETCH_SECONDS);
+  const int ahead = MIN(rows * iir, max_ahead);
+  const int32_t count = lib->collected_ids_count;
+
+  if(lib->prefetch.direction > 0)
+  {
+    const int32_t end = MIN(offset + page + ahead, count);
+    for(int32_t k = MAX(offset + page, lib->prefetch.to); k < end; k++)
+      dt_mipmap_cache_get(darktable.mipmap_cache, NULL, lib->collected_ids[k], mip, DT_MIPMAP_PREFETCH_AHEAD,
+                          'r');
+    lib->prefetch.to = MAX(lib->prefetch.to, end);
+  }
+  else
+  {
+    const int32_t begin = MAX(offset - ahead, 0);
+    for(int32_t k = MIN(MIN(offset, lib->prefetch.from), count) - 1; k >= begin; k--)
+      dt_mipmap_cache_get(darktable.mipmap_cache, NULL, lib->collected_ids[k], mip, DT_MIPMAP_PREFETCH_AHEAD,
+                          'r');
+    lib->prefetch.from = MIN(lib->prefetch.from, begin);
+  }
+}
+
 static int expose_filemanager(dt_view_t *self, cairo_t *cr, int32_t width, int32_t height, int32_t pointerx,
                                int32_t pointery)
 {
   dt_library_t *lib = (dt_library_t *)self->data;
 
-  gboolean offset_changed = FALSE;
   int missing = 0;
 
   /* query new collection count */
@@ -478,8 +645,6 @@ static int expose_filemanager(dt_view_t *self, cairo_t *cr, int32_t width, int32
   cairo_set_source_rgb(cr, .2, .2, .2);
   cairo_paint(cr);
 
-  offset_changed = lib->offset_changed;
-
   const float wd = width / (float)iir;
   const float ht = width / (float)iir;
 
@@ -559,14 +724,6 @@ static int expose_filemanager(dt_view_t *self, cairo_t *cr, int32_t width, int32
   /* update scroll borders */
   dt_view_set_scrollbar(self, 0, 1, 1, offset, lib->collection_count, max_rows * iir);
 
-  /* let's reset and reuse the main_query statement */
-  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->statements.main_query);
-  DT_DEBUG_SQLITE3_RESET(lib->statements.main_query);
-
-  /* setup offset and row for the main query */
-  DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 1, offset);
-  DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 2, max_rows * iir);
-
   if(mouse_over_id != -1)
   {
     const dt_image_t *mouse_over_image = dt_image_cache_get(darktable.image_cache, mouse_over_id, 'r');
@@ -583,18 +740,22 @@ static int expose_filemanager(dt_view_t *self, cairo_t *cr, int32_t width, int32
   // group.
   int *query_ids = (int *)calloc(max_rows * max_cols, sizeof(int));
   if(!query_ids) goto after_drawing;
-  for(int row = 0; row < max_rows; row++)
+  if(lib->collected_ids)
   {
-    for(int col = 0; col < max_cols; col++)
-    {
-      if(sqlite3_step(lib->statements.main_query) == SQLITE_ROW)
-        query_ids[row * iir + col] = sqlite3_column_int(lib->statements.main_query, 0);
-      else
-        goto end_query_cache;
-    }
+    const int32_t visible = CLAMP((int32_t)lib->collected_ids_count - offset, 0, max_rows * max_cols);
+    memcpy(query_ids, lib->collected_ids + offset, sizeof(int) * visible);
   }
+  else
+  {
+    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->statements.main_query);
+    DT_DEBUG_SQLITE3_RESET(lib->statements.main_query);
+    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 1, offset);
+    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 2, max_rows * iir);
+    for(int k = 0; k < max_rows * max_cols && sqlite3_step(lib->statements.main_query) == SQLITE_ROW; k++)
+      query_ids[k] = sqlite3_column_int(lib->statements.main_query, 0);
+  }
+
 
-end_query_cache:
   mouse_over_id = -1;
   cairo_save(cr);
   int current_image = 0;
@@ -865,34 +1026,13 @@ escape_image_loop:
 escape_border_loop:
   cairo_restore(cr);
 after_drawing:
-  /* check if offset was changed and we need to prefetch thumbs */
-  if(offset_changed)
+  /* keep the thumbnails of the next pages coming */
+  if(lib->collected_ids)
   {
-    int32_t imgids_num = 0;
-    const int prefetchrows = .5 * max_rows + 1;
-    int32_t imgids[prefetchrows * iir];
-
-    /* clear and reset main query */
-    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->statements.main_query);
-    DT_DEBUG_SQLITE3_RESET(lib->statements.main_query);
-
-    /* setup offest and row for prefetch */
-    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 1, offset + max_rows * iir);
-    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 2, prefetchrows * iir);
-
-    // prefetch jobs in inverse order: supersede previous jobs: most important last
-    while(sqlite3_step(lib->statements.main_query) == SQLITE_ROW && imgids_num < prefetchrows * iir)
-      imgids[imgids_num++] = sqlite3_column_int(lib->statements.main_query, 0);
-
-    float imgwd = iir == 1 ? 0.97 : 0.8;
-    dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, imgwd * wd,
-                                                             imgwd * (iir == 1 ? height : ht));
-    while(imgids_num > 0)
-    {
-      imgids_num--;
-      dt_mipmap_buffer_t buf;
-      dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgids[imgids_num], mip, DT_MIPMAP_PREFETCH, 'r');
-    }
+    const float imgwd = iir == 1 ? 0.97 : 0.8;
+    const dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, imgwd * wd,
+                                                                   imgwd * (iir == 1 ? height : ht));
+    _prefetch_ahead(lib, offset, iir, max_rows, mip);
   }
 
   lib->offset_changed = FALSE;
@@ -1579,6 +1719,10 @@ void leave(dt_view_t *self)
   lib->button = 0;
   lib->pan = 0;
 
+  // nobody is going to look at these any time soon
+  dt_mipmap_cache_prefetch_cancel_ahead(darktable.mipmap_cache);
+  lib->prefetch.mip = DT_MIPMAP_NONE;
+
   // exit preview mode if non-sticky
   if(lib->full_preview_id != -1 && lib->full_preview_sticky == 0)
   {